@@ -5,6 +5,7 @@
 import argparse
 import re
 import random
+from typing import Optional
 
 from utils.find_optimal_moves import find_optimal_moves
 from utils.game_info import GameInfo
@@ -93,11 +94,11 @@ def undo_move(manager: GameManager) -> None:
         manager.undo_move()
 
 
-def run_cli_loop(filename: str) -> None:
+def run_cli_loop(filename: str, book_filename: Optional[str]) -> None:
 
     int_regexp = re.compile("0|[1-9][0-9]*")
 
-    with GameInfo(filename) as info:
+    with GameInfo(filename, book_filename) as info:
 
         manager = GameManager(info)
         quit_flag = False
@@ -159,11 +160,12 @@ def main() -> None:
     default_database_filename = "connect4_7x6.dat"
     parser = argparse.ArgumentParser(description="Command-line interface for Connect-4.")
     parser.add_argument("-f", "--filename", default=default_database_filename, help="database filename (default: {!r})".format(default_database_filename))
+    parser.add_argument("-b", "--book", help="opening book filename, as made by the '--extract-book' mode of the solver")
 
     args = parser.parse_args()
 
     try:
-        run_cli_loop(args.filename)
+        run_cli_loop(args.filename, args.book)
     except:
         # Swallow all exceptions.
         pass
@@ -338,10 +338,11 @@ def main():
     default_database_filename = "connect4_7x6.dat"
     parser = argparse.ArgumentParser(description="GUI for Connect-4.")
     parser.add_argument("-f", "--filename", default=default_database_filename, help="database filename (default: {!r})".format(default_database_filename))
+    parser.add_argument("-b", "--book", help="opening book filename, as made by the '--extract-book' mode of the solver")
 
     args = parser.parse_args()
 
-    with GameInfo(args.filename) as info:
+    with GameInfo(args.filename, args.book) as info:
         manager = GameManager(info)
         app = MyApplication(manager, sys.argv)
         exitcode = app.exec_()
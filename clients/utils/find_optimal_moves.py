@@ -11,6 +11,17 @@ def find_optimal_moves(board: Board) -> List[int]:
 
     info = board.info
 
+    if info.opening_book is not None:
+        # Use the precomputed optimal moves, if the board is in the opening book.
+        book_moves = info.opening_book.optimal_moves(board)
+        if book_moves is not None:
+            return book_moves
+
+    # Use the native module, if available.
+    native_moves = info.lookup_table.optimal_moves(board)
+    if native_moves is not None:
+        return native_moves
+
     mover = board.mover()
 
     optimal_score = None
@@ -2,11 +2,12 @@
 
 import os
 import re
-from typing import List, Tuple, Dict
+from typing import List, Tuple, Dict, Optional
 
 from .simple_types import Player, Score
 from .board import Board
 from .lookup_table import LookupTable
+from .opening_book import OpeningBook
 
 
 def _number_of_digits_required(base, count):
@@ -54,16 +55,20 @@ class GameInfo:
 
     The game board size and the 'q' parameter ('connect-q') are determined based on the filename of the
     lookup table.
+
+    If an opening book is given, it is consulted before the lookup table.
     """
 
-    def __init__(self, filename: str):
+    def __init__(self, filename: str, book_filename: Optional[str] = None):
         self._filename = filename
+        self._book_filename = book_filename
         self.basename = os.path.basename(self._filename)
         self.connect_q = None
         self.h_size = None
         self.v_size = None
         self.column_ternary_to_column_encoded = None
         self.lookup_table = None
+        self.opening_book = None
         self._is_open = False
 
     def __enter__(self):
@@ -93,14 +98,23 @@ class GameInfo:
 
         octets_per_lut_entry = lookup_table_key_octets + 1
 
-        lookup_table = LookupTable(self._filename, octets_per_lut_entry)
+        lookup_table = LookupTable(self._filename, octets_per_lut_entry, (connect_q, h_size, v_size))
         lookup_table.open()
 
+        if self._book_filename is None:
+            opening_book = None
+        else:
+            opening_book = OpeningBook(self._book_filename)
+            opening_book.open()
+            if (opening_book.connect_q, opening_book.h_size, opening_book.v_size) != (connect_q, h_size, v_size):
+                raise ValueError("Opening book does not match the lookup table.")
+
         self.connect_q = connect_q
         self.h_size = h_size
         self.v_size = v_size
         self.column_ternary_to_column_encoded = column_ternary_to_column_encoded
         self.lookup_table = lookup_table
+        self.opening_book = opening_book
 
         self._is_open = True
 
@@ -111,7 +125,14 @@ class GameInfo:
 
         self.lookup_table.close()
 
+        if self.opening_book is not None:
+            self.opening_book.close()
+
         self._is_open = False
 
     def lookup(self, board: Board) -> Score:
+        if self.opening_book is not None:
+            score = self.opening_book.lookup(board)
+            if score is not None:
+                return score
         return self.lookup_table.lookup(board)
@@ -1,23 +1,55 @@
 """Query the connect-4 lookup table."""
 
 import os
-from typing import Sequence
+from typing import Sequence, Tuple, List, Optional
 
 from .board import Board
 from .simple_types import Outcome, Score
 
+try:
+    # The native extension module, built from the solver sources (see solver/python), is optional.
+    import connect4_native
+except ImportError:
+    connect4_native = None
+
 
 def _from_digits(digits: Sequence[int], base: int):
     """Return the value of a number, given its 'base' digits, least to most significant."""
     return 0 if len(digits) == 0 else _from_digits(digits[1:], base) * base + digits[0]
 
 
+def score_from_octet(score_octet: int) -> Score:
+    """Unpack score octet to 'Score' value."""
+
+    score_octet_outcome_bits = score_octet & 0xc0
+    ply = score_octet & 0x3f
+
+    if score_octet_outcome_bits == 0x40:
+        outcome = Outcome.A_WINS
+    elif score_octet_outcome_bits == 0x80:
+        outcome = Outcome.B_WINS
+    elif score_octet_outcome_bits == 0x00:
+        outcome = Outcome.DRAW
+    else:
+        # outcome == Outcome.INDETERMINATE -- this should never happen.
+        raise RuntimeError("Unexpected outcome: INDETERMINATE.")
+
+    return Score(outcome, ply)
+
+
 class LookupTable:
+    """The LookupTable class provides lookups in a binary nodes file.
+
+    If the native extension module is available, and it was built for the board geometry given as
+    (connect_q, h_size, v_size), lookups are delegated to it.
+    """
 
-    def __init__(self, filename: str, number_of_octets_per_entry: int):
+    def __init__(self, filename: str, number_of_octets_per_entry: int, geometry: Optional[Tuple[int, int, int]] = None):
         self.filename = filename
         self.number_of_octets_per_entry = number_of_octets_per_entry
+        self.geometry = geometry
         self.lookup_table_file = None
+        self.native_table = None
         self.size = None
 
     def open(self) -> None:
@@ -30,10 +62,14 @@ class LookupTable:
 
         self.lookup_table_file = open(self.filename, "rb")
 
+        if connect4_native is not None and self.geometry == (connect4_native.CONNECT_Q, connect4_native.H_SIZE, connect4_native.V_SIZE):
+            self.native_table = connect4_native.Table(self.filename)
+
     def close(self) -> None:
         """Close the lookup table file."""
         self.lookup_table_file.close()
         self.lookup_table_file = None
+        self.native_table = None
         self.size = None
 
     def num_entries(self) -> int:
@@ -81,7 +117,11 @@ class LookupTable:
         return info.column_ternary_to_column_encoded[column_ternary]
 
     @staticmethod
-    def _board_key(board: Board) -> int:
+    def _board_values(board: Board) -> Tuple[int, int]:
+        """Return the values of the mirror image of the board and of the board itself; the smaller one is the board key.
+
+        The second value numbers the columns as the solver does, with column 0 as the most significant digit.
+        """
 
         info = board.info
 
@@ -91,30 +131,44 @@ class LookupTable:
         v1 = _from_digits(columns, base)
         v2 = _from_digits(columns[::-1], base)
 
-        key = min(v1, v2)
+        return (v1, v2)
 
-        return key
+    @staticmethod
+    def _board_key(board: Board) -> int:
+        return min(LookupTable._board_values(board))
+
+    @staticmethod
+    def _native_entries(board: Board) -> List[int]:
+        return [entry.value for entry in board.entries]
 
     def lookup(self, board: Board) -> Score:
         """Look up the Score of a Board."""
 
-        key = LookupTable._board_key(board)
+        if self.native_table is not None:
+            score_octet = self.native_table.lookup(LookupTable._native_entries(board))
+        else:
+            key = LookupTable._board_key(board)
+            score_octet = self._lookup_score_octet(key)
+
+        return score_from_octet(score_octet)
 
-        score_octet = self._lookup_score_octet(key)
+    def lookup_many(self, boards: Sequence[Board]) -> List[Score]:
+        """Look up the Scores of a sequence of Boards; the native module looks them up as a single batch."""
 
-        # Unpack score octet to 'Score' value.
+        if self.native_table is None:
+            return [self.lookup(board) for board in boards]
 
-        score_octet_outcome_bits = score_octet & 0xc0
-        ply = score_octet & 0x3f
+        score_octets = self.native_table.lookup_many([LookupTable._native_entries(board) for board in boards])
 
-        if score_octet_outcome_bits == 0x40:
-            outcome = Outcome.A_WINS
-        elif score_octet_outcome_bits == 0x80:
-            outcome = Outcome.B_WINS
-        elif score_octet_outcome_bits == 0x00:
-            outcome = Outcome.DRAW
-        else:
-            # outcome == Outcome.INDETERMINATE -- this should never happen.
-            raise RuntimeError("Unexpected outcome: INDETERMINATE.")
+        if None in score_octets:
+            raise KeyError("Key not found in lookup table.")
+
+        return [score_from_octet(score_octet) for score_octet in score_octets]
+
+    def optimal_moves(self, board: Board) -> Optional[List[int]]:
+        """Return the optimal moves of a Board, or None if the native module is not available."""
+
+        if self.native_table is None:
+            return None
 
-        return Score(outcome, ply)
+        return self.native_table.optimal_moves(LookupTable._native_entries(board))
@@ -0,0 +1,93 @@
+"""Query a connect-4 opening book, as made by the '--extract-book' mode of the solver."""
+
+import struct
+from typing import List, Optional
+
+from .board import Board
+from .simple_types import Score
+from .lookup_table import LookupTable, score_from_octet
+
+
+OPENING_BOOK_MAGIC = b"#C4OBK\n\0"
+OPENING_BOOK_VERSION = 1
+OPENING_BOOK_HEADER_SIZE = 64
+
+
+class OpeningBook:
+    """The OpeningBook class holds an opening book entirely in memory.
+
+    The book holds the scores of the boards in the first moves of a game, and the optimal moves of most of them.
+    See "opening_book.h" in the solver for a description of the file format.
+    """
+
+    def __init__(self, filename: str):
+        self.filename = filename
+        self.connect_q = None
+        self.h_size = None
+        self.v_size = None
+        self.max_moves = None
+        self.entries = None
+
+    def open(self) -> None:
+        """Read the opening book file."""
+
+        with open(self.filename, "rb") as fi:
+            data = fi.read()
+
+        header = data[:OPENING_BOOK_HEADER_SIZE]
+        if len(header) != OPENING_BOOK_HEADER_SIZE or header[:8] != OPENING_BOOK_MAGIC:
+            raise ValueError("Bad opening book header.")
+
+        (version, h_size, v_size, connect_q, key_size, record_size, max_moves, policy, num_records) = struct.unpack_from("<8IQ", header, 8)
+
+        # The optimal moves are stored in as many octets as needed for one bit per column.
+        moves_size = (h_size + 7) // 8
+
+        if version != OPENING_BOOK_VERSION or record_size != key_size + 1 + moves_size:
+            raise ValueError("Unsupported opening book.")
+
+        if len(data) != OPENING_BOOK_HEADER_SIZE + num_records * record_size:
+            raise ValueError("Bad size for opening book.")
+
+        entries = {}
+        for offset in range(OPENING_BOOK_HEADER_SIZE, len(data), record_size):
+            key = int.from_bytes(data[offset:offset + key_size], 'big')
+            moves = int.from_bytes(data[offset + key_size + 1:offset + record_size], 'little')
+            entries[key] = (data[offset + key_size], moves)
+
+        self.connect_q = connect_q
+        self.h_size = h_size
+        self.v_size = v_size
+        self.max_moves = max_moves
+        self.entries = entries
+
+    def close(self) -> None:
+        """Release the opening book."""
+        self.entries = None
+
+    def lookup(self, board: Board) -> Optional[Score]:
+        """Look up the Score of a Board, or return None if it is not in the book."""
+
+        entry = self.entries.get(LookupTable._board_key(board))
+
+        return None if entry is None else score_from_octet(entry[0])
+
+    def optimal_moves(self, board: Board) -> Optional[List[int]]:
+        """Return the optimal moves of a Board, or None if they are not in the book."""
+
+        (v1, v2) = LookupTable._board_values(board)
+
+        entry = self.entries.get(min(v1, v2))
+
+        if entry is None or entry[1] == 0:
+            return None
+
+        # The moves are given for the normalized board; mirror them if the board is the mirror image of it,
+        # i.e., if the key is the value of the mirror image.
+
+        moves = [col for col in range(self.h_size) if entry[1] & (1 << col)]
+
+        if v1 < v2:
+            moves = sorted(self.h_size - 1 - col for col in moves)
+
+        return moves
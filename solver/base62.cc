@@ -43,7 +43,7 @@ static unsigned from_base62_digit(char c)
     throw runtime_error("from_base62_digit: bad base-62 digit");
 }
 
-string uint64_to_base62_string(uint64_t n, unsigned num_digits)
+string key_to_base62_string(BoardKey n, unsigned num_digits)
 {
     // Encode 'n' as a base-62 number.
     // Digit order is big-endian (i.e., the most significant digit comes first).
@@ -60,17 +60,17 @@ string uint64_to_base62_string(uint64_t n, unsigned num_digits)
 
     if (n != 0)
     {
-        throw runtime_error("uint64_to_base62_string: number too large");
+        throw runtime_error("key_to_base62_string: number too large");
     }
 
     return string(encoded_number);
 }
 
-uint64_t base62_string_to_uint64(const string & s)
+BoardKey base62_string_to_key(const string & s)
 {
-    // Parse a big-endian base-62 string to an uint64_t.
+    // Parse a big-endian base-62 string to a BoardKey.
     // Note: this function does not guard against overflow.
-    uint64_t n = 0;
+    BoardKey n = 0;
     for (int i = 0; s[i] != '\0'; ++i)
     {
         n = (62 * n) + from_base62_digit(s[i]);
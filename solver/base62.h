@@ -9,11 +9,13 @@
 #include <cstdint>
 #include <string>
 
-// Encode and decode 64-bit unsigned integers as big-endian base-62 strings.
+#include "derived_constants.h"
+
+// Encode and decode unsigned integers of up to the size of a BoardKey as big-endian base-62 strings.
 // Base-62 strings use the characters 0..9, A..Z, and a..z to represent digits.
 
-std::string uint64_to_base62_string(uint64_t n, unsigned num_digits);
+std::string key_to_base62_string(BoardKey n, unsigned num_digits);
 
-uint64_t base62_string_to_uint64(const std::string & s);
+BoardKey base62_string_to_key(const std::string & s);
 
 #endif // BASE62_H
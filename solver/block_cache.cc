@@ -0,0 +1,268 @@
+
+////////////////////
+// block_cache.cc //
+////////////////////
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "block_cache.h"
+
+using namespace std;
+
+BlockCache::BlockCache(int fd, uint64_t file_size, uint64_t capacity) :
+    fd(fd),
+    file_size(file_size),
+    frames_per_shard(max(uint64_t(1), capacity / BLOCK_CACHE_BLOCK_SIZE / BLOCK_CACHE_NUM_SHARDS)),
+    shards(BLOCK_CACHE_NUM_SHARDS),
+    hits(0),
+    misses(0),
+    evictions(0),
+    pinned_blocks(0)
+{
+    for (Shard & shard: shards)
+    {
+        shard.frames.assign(frames_per_shard, Frame{0, false, false, false, false});
+        shard.data.resize(static_cast<size_t>(frames_per_shard) * BLOCK_CACHE_BLOCK_SIZE);
+        shard.hand = 0;
+        shard.num_pinned = 0;
+    }
+}
+
+void BlockCache::read_block(uint64_t block, uint8_t * buffer) const
+{
+    const uint64_t offset = block * BLOCK_CACHE_BLOCK_SIZE;
+
+    size_t done = 0;
+
+    while (done < BLOCK_CACHE_BLOCK_SIZE && offset + done < file_size)
+    {
+        const ssize_t result = pread(fd, buffer + done, BLOCK_CACHE_BLOCK_SIZE - done, offset + done);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw runtime_error("BlockCache: read error.");
+        }
+
+        if (result == 0)
+        {
+            break;
+        }
+
+        done += result;
+    }
+
+    // The last block of the file may be incomplete.
+
+    fill(buffer + done, buffer + BLOCK_CACHE_BLOCK_SIZE, 0);
+}
+
+unsigned BlockCache::get_frame(Shard & shard, unique_lock<mutex> & lock, uint64_t block, bool count)
+{
+    for (;;)
+    {
+        const auto found = shard.frame_of_block.find(block);
+
+        if (found != shard.frame_of_block.end())
+        {
+            Frame & frame = shard.frames[found->second];
+
+            if (frame.loading)
+            {
+                // Another thread is reading the block. Look again once it is done, since the read may fail.
+                shard.loaded.wait(lock);
+                continue;
+            }
+
+            if (count)
+            {
+                ++hits;
+            }
+            frame.referenced = true;
+            return found->second;
+        }
+
+        // Find a frame to (re)use, using the CLOCK algorithm. Frames that are pinned or being loaded are
+        // skipped. Since at least one frame is not pinned (see pin()), two sweeps find a frame, unless all
+        // other frames are being loaded; in that case, wait until one of them is done, and look again.
+
+        unsigned index = frames_per_shard;
+
+        for (unsigned step = 0; step < 2 * frames_per_shard; ++step)
+        {
+            const unsigned hand = shard.hand;
+            Frame & frame = shard.frames[hand];
+
+            shard.hand = (shard.hand + 1) % frames_per_shard;
+
+            if (frame.pinned || frame.loading)
+            {
+                continue;
+            }
+
+            if (frame.valid && frame.referenced)
+            {
+                frame.referenced = false;
+                continue;
+            }
+
+            index = hand;
+            break;
+        }
+
+        if (index == frames_per_shard)
+        {
+            shard.loaded.wait(lock);
+            continue;
+        }
+
+        if (count)
+        {
+            ++misses;
+        }
+
+        Frame & frame = shard.frames[index];
+
+        if (frame.valid)
+        {
+            ++evictions;
+            shard.frame_of_block.erase(frame.block);
+        }
+
+        // Claim the frame, and read the block without holding the lock. Nobody else reads the data of
+        // a frame that is being loaded.
+
+        frame = Frame{block, false, true, false, true};
+        shard.frame_of_block[block] = index;
+
+        lock.unlock();
+
+        try
+        {
+            read_block(block, &shard.data[static_cast<size_t>(index) * BLOCK_CACHE_BLOCK_SIZE]);
+        }
+        catch (...)
+        {
+            lock.lock();
+            shard.frame_of_block.erase(block);
+            shard.frames[index] = Frame{0, false, false, false, false};
+            shard.loaded.notify_all();
+            throw;
+        }
+
+        lock.lock();
+
+        shard.frames[index].valid   = true;
+        shard.frames[index].loading = false;
+        shard.loaded.notify_all();
+
+        return index;
+    }
+}
+
+void BlockCache::read(uint64_t offset, unsigned size, uint8_t * buffer)
+{
+    while (size != 0)
+    {
+        const uint64_t block  = offset / BLOCK_CACHE_BLOCK_SIZE;
+        const unsigned within = offset % BLOCK_CACHE_BLOCK_SIZE;
+        const unsigned count  = min(size, BLOCK_CACHE_BLOCK_SIZE - within);
+
+        Shard & shard = shards[block % BLOCK_CACHE_NUM_SHARDS];
+
+        {
+            unique_lock<mutex> lock(shard.mutex);
+
+            const unsigned frame_index = get_frame(shard, lock, block, true);
+
+            memcpy(buffer, &shard.data[static_cast<size_t>(frame_index) * BLOCK_CACHE_BLOCK_SIZE + within], count);
+        }
+
+        offset += count;
+        buffer += count;
+        size   -= count;
+    }
+}
+
+void BlockCache::prefetch(const vector<uint64_t> & offsets, unsigned size)
+{
+    for (const uint64_t offset: offsets)
+    {
+        const uint64_t first_block = offset / BLOCK_CACHE_BLOCK_SIZE;
+        const uint64_t last_block  = (offset + size - 1) / BLOCK_CACHE_BLOCK_SIZE;
+
+        for (uint64_t block = first_block; block <= last_block; ++block)
+        {
+            Shard & shard = shards[block % BLOCK_CACHE_NUM_SHARDS];
+
+            bool cached;
+            {
+                lock_guard<mutex> lock(shard.mutex);
+                cached = (shard.frame_of_block.count(block) != 0);
+            }
+
+            if (!cached)
+            {
+                posix_fadvise(fd, block * BLOCK_CACHE_BLOCK_SIZE, BLOCK_CACHE_BLOCK_SIZE, POSIX_FADV_WILLNEED);
+            }
+        }
+    }
+}
+
+void BlockCache::pin(uint64_t offset, uint64_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    const uint64_t first_block = offset / BLOCK_CACHE_BLOCK_SIZE;
+    const uint64_t last_block  = (offset + size - 1) / BLOCK_CACHE_BLOCK_SIZE;
+
+    for (uint64_t block = first_block; block <= last_block; ++block)
+    {
+        Shard & shard = shards[block % BLOCK_CACHE_NUM_SHARDS];
+
+        unique_lock<mutex> lock(shard.mutex);
+
+        // Keep at least one frame of each shard available for blocks that are not pinned.
+        // This guarantees that get_frame() can always find a frame to evict. Since the lock is
+        // released while a block is read, the limit is checked again before pinning.
+
+        if (shard.num_pinned + 1 >= frames_per_shard)
+        {
+            continue;
+        }
+
+        const unsigned frame_index = get_frame(shard, lock, block, false);
+
+        if (!shard.frames[frame_index].pinned && shard.num_pinned + 1 < frames_per_shard)
+        {
+            shard.frames[frame_index].pinned = true;
+            ++shard.num_pinned;
+            ++pinned_blocks;
+        }
+    }
+}
+
+BlockCache::Statistics BlockCache::statistics() const
+{
+    Statistics result;
+
+    result.hits            = hits;
+    result.misses          = misses;
+    result.evictions       = evictions;
+    result.pinned_blocks   = pinned_blocks;
+    result.capacity_blocks = static_cast<uint64_t>(frames_per_shard) * BLOCK_CACHE_NUM_SHARDS;
+
+    return result;
+}
@@ -0,0 +1,117 @@
+
+///////////////////
+// block_cache.h //
+///////////////////
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// The size of the blocks in which a BlockCache reads its file.
+constexpr unsigned BLOCK_CACHE_BLOCK_SIZE = 4096;
+
+// The number of independently locked shards of a BlockCache.
+constexpr unsigned BLOCK_CACHE_NUM_SHARDS = 64;
+
+class BlockCache
+{
+    // The BlockCache class caches fixed-size blocks of a read-only file in user space, as an alternative
+    // to memory-mapping the file and leaving caching to the kernel. Blocks are read using pread().
+    //
+    // The cache is divided into shards, each with its own lock, so it can be shared by multiple threads.
+    // Consecutive blocks go to different shards. Within a shard, blocks are evicted using the CLOCK
+    // algorithm: each block has a 'referenced' bit that is set when it is accessed; when a block must be
+    // evicted, the clock hand sweeps over the blocks, clearing set bits, until it finds a block whose
+    // bit is not set.
+    //
+    // A block is read without holding the lock of its shard, so a miss does not hold up the other readers of the
+    // shard. While it is read, its frame is marked as loading; threads that need the same block wait until it
+    // has been read, and the frame is not evicted.
+    //
+    // Blocks can be pinned, in which case they are never evicted. This is used to keep the data that
+    // is accessed by nearly every lookup resident.
+
+    public:
+
+        struct Statistics {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+            uint64_t pinned_blocks;
+            uint64_t capacity_blocks;
+        };
+
+        // Make a cache of (approximately) 'capacity' bytes for the file with the given descriptor and size.
+        // The file descriptor remains owned by the caller.
+        BlockCache(int fd, uint64_t file_size, uint64_t capacity);
+
+        BlockCache(const BlockCache &) = delete;
+        BlockCache & operator = (const BlockCache &) = delete;
+
+        // Copy 'size' bytes at the given file offset into 'buffer'. The range may span multiple blocks.
+        void read(uint64_t offset, unsigned size, uint8_t * buffer);
+
+        // Ask the kernel to start reading the blocks that overlap the ranges of 'size' bytes at the given
+        // offsets, for those blocks that are not yet cached. This allows the reads of many blocks that will
+        // be needed soon to proceed concurrently, rather than one after the other.
+        void prefetch(const std::vector<uint64_t> & offsets, unsigned size);
+
+        // Load and pin all blocks that overlap the given range of the file. At least one frame of each
+        // shard is kept available for blocks that are not pinned; blocks beyond that are not pinned.
+        // Loading the blocks does not count as hits or misses.
+        void pin(uint64_t offset, uint64_t size);
+
+        // Get the hit, miss, and eviction counts so far, and the number of pinned blocks.
+        Statistics statistics() const;
+
+    private: // Member types.
+
+        struct Frame {
+            uint64_t block;
+            bool     valid;
+            bool     referenced;
+            bool     pinned;
+            bool     loading;
+        };
+
+        struct Shard {
+            std::mutex                             mutex;
+            std::condition_variable                loaded;
+            std::vector<Frame>                     frames;
+            std::vector<uint8_t>                   data;
+            std::unordered_map<uint64_t, unsigned> frame_of_block;
+            unsigned                               hand;
+            unsigned                               num_pinned;
+        };
+
+    private: // Member functions.
+
+        // Find the frame holding a block, reading it in if necessary. Must be called with the shard locked by
+        // 'lock'; the lock is released while the block is read, and held again when the function returns.
+        // If 'count' is true, the access is counted as a hit or a miss.
+        unsigned get_frame(Shard & shard, std::unique_lock<std::mutex> & lock, uint64_t block, bool count);
+
+        // Read a block from the file into a buffer of BLOCK_CACHE_BLOCK_SIZE bytes.
+        void read_block(uint64_t block, uint8_t * buffer) const;
+
+    private: // Member variables.
+
+        int      fd;
+        uint64_t file_size;
+        unsigned frames_per_shard;
+
+        std::vector<Shard> shards;
+
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+        std::atomic<uint64_t> evictions;
+        std::atomic<uint64_t> pinned_blocks;
+};
+
+#endif // BLOCK_CACHE_H
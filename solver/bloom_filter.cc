@@ -0,0 +1,243 @@
+
+/////////////////////
+// bloom_filter.cc //
+/////////////////////
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "board.h"
+#include "board_size.h"
+#include "hash.h"
+#include "little_endian.h"
+#include "bloom_filter.h"
+
+using namespace std;
+
+// The number of 64-bit words in a block of 512 bits.
+constexpr unsigned WORDS_PER_BLOCK = 8;
+
+// The number of generations, and hence sections of the filter.
+constexpr unsigned NUM_GENERATIONS = H_SIZE * V_SIZE + 1;
+
+constexpr unsigned HEADER_SIZE = 32 + 16 * NUM_GENERATIONS + 8;
+
+BloomFilter::BloomFilter(const vector<uint64_t> & generation_counts, double false_positive_rate)
+{
+    if (generation_counts.size() > NUM_GENERATIONS)
+    {
+        throw runtime_error("BloomFilter: too many generations.");
+    }
+
+    if (!(false_positive_rate > 0.0 && false_positive_rate < 1.0))
+    {
+        throw runtime_error("BloomFilter: the false-positive rate must be between 0 and 1.");
+    }
+
+    // The optimal number of bits per key for a standard Bloom filter is -ln(p) / ln(2)^2,
+    // with ln(2) times that number of bits set per key.
+
+    const double bits_per_key = -log(false_positive_rate) / (log(2.0) * log(2.0));
+    const unsigned num_hashes = max(1, min(16, static_cast<int>(round(bits_per_key * log(2.0)))));
+
+    uint64_t num_words = 0;
+
+    for (unsigned generation = 0; generation < NUM_GENERATIONS; ++generation)
+    {
+        const uint64_t count = (generation < generation_counts.size()) ? generation_counts[generation] : 0;
+
+        Section section;
+
+        section.first_word = num_words;
+        section.num_blocks = (count == 0) ? 0 : static_cast<uint64_t>(ceil(count * bits_per_key / 512.0));
+        section.num_hashes = num_hashes;
+
+        sections.push_back(section);
+
+        num_words += section.num_blocks * WORDS_PER_BLOCK;
+    }
+
+    words.assign(num_words, 0);
+}
+
+BloomFilter::BloomFilter(const string & filename)
+{
+    ifstream in(filename, ios::binary);
+
+    if (!in)
+    {
+        throw runtime_error("BloomFilter: unable to open file.");
+    }
+
+    uint8_t header[HEADER_SIZE];
+
+    if (!in.read(reinterpret_cast<char *>(header), HEADER_SIZE))
+    {
+        throw runtime_error("BloomFilter: unable to read header.");
+    }
+
+    if (memcmp(header, BLOOM_FILTER_MAGIC, BLOOM_FILTER_MAGIC_SIZE) != 0)
+    {
+        throw runtime_error("BloomFilter: bad magic.");
+    }
+
+    if (load_le(header + HEADER_SIZE - 8, 8) != fnv1a_64(header, HEADER_SIZE - 8))
+    {
+        throw runtime_error("BloomFilter: bad header checksum.");
+    }
+
+    if (load_le(header + 8, 4) != BLOOM_FILTER_VERSION)
+    {
+        throw runtime_error("BloomFilter: unsupported version.");
+    }
+
+    if (load_le(header + 12, 4) != H_SIZE || load_le(header + 16, 4) != V_SIZE || load_le(header + 20, 4) != CONNECT_Q ||
+        load_le(header + 24, 4) != NUM_GENERATIONS)
+    {
+        throw runtime_error("BloomFilter: filter is for a different board geometry.");
+    }
+
+    uint64_t num_words = 0;
+
+    for (unsigned generation = 0; generation < NUM_GENERATIONS; ++generation)
+    {
+        Section section;
+
+        section.first_word = num_words;
+        section.num_blocks = load_le(header + 32 + 16 * generation, 8);
+        section.num_hashes = load_le(header + 32 + 16 * generation + 8, 4);
+
+        sections.push_back(section);
+
+        num_words += section.num_blocks * WORDS_PER_BLOCK;
+    }
+
+    words.resize(num_words);
+
+    vector<uint8_t> octets(num_words * sizeof(uint64_t));
+
+    if (!in.read(reinterpret_cast<char *>(octets.data()), octets.size()))
+    {
+        throw runtime_error("BloomFilter: file is truncated.");
+    }
+
+    for (uint64_t i = 0; i < num_words; ++i)
+    {
+        words[i] = load_le(&octets[i * sizeof(uint64_t)], sizeof(uint64_t));
+    }
+}
+
+void BloomFilter::probe(BoardKey key, const Section & section, uint64_t & block_word, uint32_t & a, uint32_t & b) const
+{
+    // The block is selected by the high bits of one hash, using multiplication rather than a modulo operation.
+    // The bit positions within the block are derived from a second hash by double hashing.
+
+    const uint64_t h1 = mix64(fold_key(key));
+    const uint64_t h2 = mix64(h1);
+
+    const uint64_t block = static_cast<uint64_t>((static_cast<unsigned __int128>(h1) * section.num_blocks) >> 64);
+
+    block_word = section.first_word + block * WORDS_PER_BLOCK;
+
+    a = static_cast<uint32_t>(h2);
+    b = static_cast<uint32_t>(h2 >> 32) | 1;
+}
+
+void BloomFilter::insert(BoardKey key, unsigned generation)
+{
+    const Section & section = sections.at(generation);
+
+    if (section.num_blocks == 0)
+    {
+        throw runtime_error("BloomFilter: no room for keys of this generation.");
+    }
+
+    uint64_t block_word;
+    uint32_t a;
+    uint32_t b;
+
+    probe(key, section, block_word, a, b);
+
+    for (unsigned i = 0; i < section.num_hashes; ++i)
+    {
+        const unsigned bit = (a + i * b) % 512;
+        words[block_word + bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+bool BloomFilter::may_contain(BoardKey key, unsigned generation) const
+{
+    if (generation >= sections.size() || sections[generation].num_blocks == 0)
+    {
+        return false;
+    }
+
+    const Section & section = sections[generation];
+
+    uint64_t block_word;
+    uint32_t a;
+    uint32_t b;
+
+    probe(key, section, block_word, a, b);
+
+    for (unsigned i = 0; i < section.num_hashes; ++i)
+    {
+        const unsigned bit = (a + i * b) % 512;
+        if ((words[block_word + bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool BloomFilter::may_contain(BoardKey key) const
+{
+    return may_contain(key, Board::from_key(key).count());
+}
+
+void BloomFilter::save(const string & filename) const
+{
+    ofstream out(filename, ios::binary);
+
+    if (!out)
+    {
+        throw runtime_error("BloomFilter: unable to create file.");
+    }
+
+    uint8_t header[HEADER_SIZE] = {};
+
+    memcpy(header, BLOOM_FILTER_MAGIC, BLOOM_FILTER_MAGIC_SIZE);
+
+    store_le(header +  8, BLOOM_FILTER_VERSION, 4);
+    store_le(header + 12, H_SIZE              , 4);
+    store_le(header + 16, V_SIZE              , 4);
+    store_le(header + 20, CONNECT_Q           , 4);
+    store_le(header + 24, NUM_GENERATIONS     , 4);
+
+    for (unsigned generation = 0; generation < NUM_GENERATIONS; ++generation)
+    {
+        store_le(header + 32 + 16 * generation,     sections[generation].num_blocks, 8);
+        store_le(header + 32 + 16 * generation + 8, sections[generation].num_hashes, 4);
+    }
+
+    store_le(header + HEADER_SIZE - 8, fnv1a_64(header, HEADER_SIZE - 8), 8);
+
+    out.write(reinterpret_cast<const char *>(header), HEADER_SIZE);
+
+    for (const uint64_t word: words)
+    {
+        uint8_t octets[sizeof(uint64_t)];
+        store_le(octets, word, sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(octets), sizeof(uint64_t));
+    }
+
+    if (!out)
+    {
+        throw runtime_error("BloomFilter: error while writing file.");
+    }
+}
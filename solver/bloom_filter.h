@@ -0,0 +1,94 @@
+
+////////////////////
+// bloom_filter.h //
+////////////////////
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "derived_constants.h"
+
+// A BloomFilter holds an approximate representation of the set of board keys in a table, that can be used to
+// reject boards that are not in the table without accessing the table itself. A key that is in the table is
+// always accepted; a key that is not in the table is accepted only with a small probability, the false-positive
+// rate, that is chosen when the filter is made.
+//
+// The filter consists of one Bloom filter per generation (number of chips on the board), each sized for the
+// number of keys of its generation. Each of these is a 'blocked' Bloom filter: a key selects a single 512-bit
+// block (a typical cache line), and all of its bits are set in that block. So a test costs one memory access.
+//
+// A filter file starts with a header. All numbers in the header are stored in little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   BLOOM_FILTER_MAGIC
+//          8      4   format version (BLOOM_FILTER_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   number of generations (H_SIZE * V_SIZE + 1)
+//         28      4   reserved (zero)
+//         32   16*N   for each generation: the number of blocks (64 bits), the number of bits set per key (32 bits),
+//                     and a reserved field (32 bits, zero)
+//    32+16*N      8   FNV-1a hash of the preceding header bytes
+//
+// The blocks of all generations follow the header, in order of generation, as little-endian 64-bit words.
+
+constexpr const char * BLOOM_FILTER_MAGIC = "#C4BLM\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned BLOOM_FILTER_MAGIC_SIZE = 8;
+constexpr unsigned BLOOM_FILTER_VERSION    = 1;
+
+class BloomFilter
+{
+    public:
+
+        // Make an empty filter, sized for the given number of keys per generation and the false-positive rate.
+        BloomFilter(const std::vector<uint64_t> & generation_counts, double false_positive_rate);
+
+        // Load a filter from a file.
+        explicit BloomFilter(const std::string & filename);
+
+        // Add a key of the given generation.
+        void insert(BoardKey key, unsigned generation);
+
+        // Check if a key of the given generation may be in the set. Returns false only if it is certainly not.
+        bool may_contain(BoardKey key, unsigned generation) const;
+
+        // Check if a key may be in the set; its generation is determined from the key.
+        bool may_contain(BoardKey key) const;
+
+        // Save the filter to a file.
+        void save(const std::string & filename) const;
+
+        // The size of the filter in bytes, excluding the header.
+        uint64_t size() const
+        {
+            return words.size() * sizeof(uint64_t);
+        }
+
+    private: // Member types.
+
+        struct Section {
+            uint64_t first_word;
+            uint64_t num_blocks;
+            unsigned num_hashes;
+        };
+
+    private: // Member functions.
+
+        // Determine which bits to set or test for a key: the index of the first word of its block, and
+        // the two values from which the bit positions within the block are derived.
+        void probe(BoardKey key, const Section & section, uint64_t & block_word, uint32_t & a, uint32_t & b) const;
+
+    private: // Member variables.
+
+        std::vector<Section>  sections;
+        std::vector<uint64_t> words;
+};
+
+#endif // BLOOM_FILTER_H
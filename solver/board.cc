@@ -31,9 +31,9 @@ Board Board::make_empty()
     return board;
 }
 
-uint64_t Board::to_uint64() const
+BoardKey Board::to_key() const
 {
-    uint64_t n = 0;
+    BoardKey n = 0;
     for (int x = 0; x < H_SIZE; ++x)
     {
         unsigned column = 0;
@@ -55,7 +55,7 @@ uint64_t Board::to_uint64() const
 }
 
 // static method
-Board Board::from_uint64(uint64_t n)
+Board Board::from_key(BoardKey n)
 {
     Board board;
 
@@ -76,13 +76,13 @@ Board Board::from_uint64(uint64_t n)
 
 string Board::to_base62_string() const
 {
-    return uint64_to_base62_string(to_uint64(), NUM_BASE62_BOARD_DIGITS);
+    return key_to_base62_string(to_key(), NUM_BASE62_BOARD_DIGITS);
 }
 
 // static method
 Board Board::from_base62_string(const string & s)
 {
-    return from_uint64(base62_string_to_uint64(s));
+    return from_key(base62_string_to_key(s));
 }
 
 Player Board::mover() const
@@ -215,7 +215,7 @@ bool Board::is_symmetric() const
     return true;
 }
 
-Board Board::normalize() const
+Board Board::mirror() const
 {
     Board horizontal_mirror;
 
@@ -228,7 +228,134 @@ Board Board::normalize() const
         }
     }
 
-    return min(*this, horizontal_mirror);
+    return horizontal_mirror;
+}
+
+Board Board::normalize() const
+{
+    return min(*this, mirror());
+}
+
+bool Board::can_play(int x) const
+{
+    return (0 <= x) && (x < H_SIZE) && (entries[0][x] == Player::NONE);
+}
+
+bool Board::is_winning_move(int x) const
+{
+    // Note: the caller should check that the move is valid by calling can_play(x).
+
+    int y = V_SIZE - 1;
+    while (entries[y][x] != Player::NONE)
+    {
+        --y;
+    }
+
+    const Player player = mover();
+
+    const int directions[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+
+    for (int d = 0; d < 4; ++d)
+    {
+        const int dx = directions[d][0];
+        const int dy = directions[d][1];
+
+        // Count the player's chips adjacent to (x, y) in both senses of the direction.
+
+        int connected = 1;
+
+        for (int sense = -1; sense <= 1; sense += 2)
+        {
+            int xx = x + sense * dx;
+            int yy = y + sense * dy;
+
+            while (is_valid_coordinate(xx, yy) && entries[yy][xx] == player)
+            {
+                ++connected;
+                xx += sense * dx;
+                yy += sense * dy;
+            }
+        }
+
+        if (connected >= CONNECT_Q)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Board Board::play(int x) const
+{
+    // Note: the caller should check that the move is valid by calling can_play(x).
+
+    Board next_board(*this);
+
+    for (int y = V_SIZE - 1; y >= 0; --y)
+    {
+        if (entries[y][x] == Player::NONE)
+        {
+            next_board.entries[y][x] = mover();
+            break;
+        }
+    }
+
+    return next_board;
+}
+
+Board Board::unplay(int x) const
+{
+    // Note: the caller should check that column x is not empty.
+
+    Board previous_board(*this);
+
+    for (int y = 0; y < V_SIZE; ++y)
+    {
+        if (entries[y][x] != Player::NONE)
+        {
+            previous_board.entries[y][x] = Player::NONE;
+            break;
+        }
+    }
+
+    return previous_board;
+}
+
+// static method
+Board Board::from_move_sequence(const string & moves)
+{
+    Board board = make_empty();
+
+    for (const char move: moves)
+    {
+        const int x = move - '1';
+
+        if (board.trivial_outcome() != Outcome::INDETERMINATE || !board.can_play(x))
+        {
+            throw runtime_error("Board::from_move_sequence: invalid move.");
+        }
+
+        board = board.play(x);
+    }
+
+    return board;
+}
+
+// static method
+Board Board::from_entries(const Player * bottom_up_entries)
+{
+    Board board;
+
+    for (int y = 0; y < V_SIZE; ++y)
+    {
+        for (int x = 0; x < H_SIZE; ++x)
+        {
+            board.entries[V_SIZE - 1 - y][x] = bottom_up_entries[x + y * H_SIZE];
+        }
+    }
+
+    return board;
 }
 
 set<Board> Board::generate_unique_normalized_boards() const
@@ -259,6 +386,43 @@ set<Board> Board::generate_unique_normalized_boards() const
     return next_boards;
 }
 
+set<Board> Board::generate_predecessors() const
+{
+    // Return a set of normalized boards from which the current
+    // board state can be reached by making a single move.
+
+    set<Board> previous_boards;
+
+    if (count() != 0)
+    {
+        // The player that made the last move is the player that does not have the move now.
+        const Player last_mover = (mover() == Player::A) ? Player::B : Player::A;
+
+        for (int x = 0; x < H_SIZE; ++x)
+        {
+            for (int y = 0; y < V_SIZE; ++y)
+            {
+                if (entries[y][x] != Player::NONE)
+                {
+                    // This is the top chip of the column; only the last mover's chips can be taken back.
+                    if (entries[y][x] == last_mover)
+                    {
+                        Board previous_board(*this);
+                        previous_board.entries[y][x] = Player::NONE;
+                        if (previous_board.trivial_outcome() == Outcome::INDETERMINATE)
+                        {
+                            previous_boards.insert(previous_board.normalize());
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    return previous_boards;
+}
+
 bool Board::is_full() const
 {
     for (int x = 0; x < H_SIZE; ++x)
@@ -273,8 +437,8 @@ bool Board::is_full() const
 
 bool operator < (const Board & lhs, const Board & rhs)
 {
-    // We compare boards according to their representation as uint64 values.
-    return lhs.to_uint64() < rhs.to_uint64();
+    // We compare boards according to their representation as BoardKey values.
+    return lhs.to_key() < rhs.to_key();
 }
 
 ostream & operator << (ostream & out, const Board & board)
@@ -16,6 +16,7 @@
 #include "player.h"
 #include "score.h"
 #include "board_size.h"
+#include "derived_constants.h"
 
 class Board
 {
@@ -41,17 +42,48 @@ class Board
         // Check if the board is horizontally symmetric.
         bool is_symmetric() const;
 
+        // Return the horizontal reflection of the board.
+        Board mirror() const;
+
         // Normalize the board (i.e., return the smallest board, identical up to horizontal reflection).
         Board normalize() const;
 
+        // Check if column x exists and is not full. Note that this does not check if the game is already over.
+        bool can_play(int x) const;
+
+        // Check if the mover completes a connect-Q by dropping a chip in column x.
+        // This only inspects the lines through the new chip, so it is much cheaper than trivial_outcome().
+        bool is_winning_move(int x) const;
+
+        // Return the Board that results from the mover dropping a chip in column x. The result is not normalized.
+        Board play(int x) const;
+
+        // Return the Board with the top chip of column x removed; this takes back a move in column x.
+        // Note: the caller should check that column x is not empty.
+        Board unplay(int x) const;
+
+        // Make a Board by playing a sequence of moves, starting from the empty Board.
+        // Moves are given as column numbers, starting at 1 for the leftmost column (e.g. "4453").
+        static Board from_move_sequence(const std::string & moves);
+
+        // Make a Board from its H_SIZE * V_SIZE entries, given row by row, starting at the bottom row, as the Python
+        // clients store them (i.e., entry x + y * H_SIZE is column x, height y). The Board is not validated.
+        static Board from_entries(const Player * bottom_up_entries);
+
         // Generate the set of normalized Boards that are reachable from this Board with a single move.
         std::set<Board> generate_unique_normalized_boards() const;
 
-        // Encode the Board as a 64-bit unsigned integer.
-        uint64_t to_uint64() const;
+        // Generate the set of normalized Boards from which this Board is reachable with a single move,
+        // i.e., by removing the top chip of the player that made the last move from one of the columns.
+        // Boards that already have a connect-Q are excluded, since no move can be made from them.
+        // Note that some of the predecessors may not be reachable from the initial Board.
+        std::set<Board> generate_predecessors() const;
+
+        // Encode the Board as a BoardKey (see derived_constants.h).
+        BoardKey to_key() const;
 
-        // Decode a Board from a 64-bit unsigned integer.
-        static Board from_uint64(uint64_t n);
+        // Decode a Board from a BoardKey.
+        static Board from_key(BoardKey n);
 
         // Encode the Board as a base-62 string.
         std::string to_base62_string() const;
@@ -101,3 +101,28 @@ ColumnEncoder::ColumnEncoder()
         column_ternary_to_column_encoded[column_encoded_to_column_ternary[i]] = i;
     }
 }
+
+ColumnChips::ColumnChips() :
+    column_height(NUMBER_OF_POSSIBLE_COLUMNS),
+    column_a_bits(NUMBER_OF_POSSIBLE_COLUMNS)
+{
+    // A column is a ternary number with the top entry as its most significant digit (see Board::to_key),
+    // so its least significant digit is the bottom entry. The chips are at the bottom of the column.
+
+    const ColumnEncoder column_encoder;
+
+    for (unsigned encoded = 0; encoded < NUMBER_OF_POSSIBLE_COLUMNS; ++encoded)
+    {
+        unsigned column = column_encoder.decode(encoded);
+
+        for (unsigned y = 0; column != 0; ++y)
+        {
+            if (column % 3 == 1)
+            {
+                column_a_bits[encoded] |= uint32_t(1) << y;
+            }
+            ++column_height[encoded];
+            column /= 3;
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #define COLUMN_ENCODER_H
 
 #include <vector>
+#include <cstdint>
 
 class ColumnEncoder
 {
@@ -56,4 +57,32 @@ class ColumnEncoder
         std::vector<unsigned> column_ternary_to_column_encoded;
 };
 
+class ColumnChips
+{
+    // For each encoded column, the number of chips in it, and a bitmask of the chips of player A (bit y for
+    // height y, numbered from 0 at the bottom). Board keys can be taken apart one encoded column at a time
+    // (see Board::to_key), so with these tables, the heights and chips of a board can be read from its key
+    // directly, without decoding the key into a Board.
+
+    public:
+
+        // Build the tables for all encoded columns.
+        ColumnChips();
+
+        unsigned height(unsigned column_encoded) const
+        {
+            return column_height[column_encoded];
+        }
+
+        uint32_t a_bits(unsigned column_encoded) const
+        {
+            return column_a_bits[column_encoded];
+        }
+
+    private: // Member variables.
+
+        std::vector<uint8_t>  column_height;
+        std::vector<uint32_t> column_a_bits;
+};
+
 #endif // COLUMN_ENCODER_H
@@ -0,0 +1,347 @@
+
+/////////////////////////
+// compressed_table.cc //
+/////////////////////////
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <lzma.h>
+
+#include "derived_constants.h"
+#include "little_endian.h"
+#include "hash.h"
+#include "compressed_table.h"
+
+using namespace std;
+
+constexpr unsigned KEY_SIZE    = NUM_BASE256_BOARD_DIGITS;
+constexpr unsigned RECORD_SIZE = BINARY_RECORD_SIZE;
+
+// Key differences are taken modulo 256 ** KEY_SIZE, so that they always fit in KEY_SIZE bytes.
+constexpr BoardKey KEY_MASK = (KEY_SIZE >= sizeof(BoardKey)) ? ~BoardKey(0) : (BoardKey(1) << (8 * KEY_SIZE)) - 1;
+
+static BoardKey load_key(const uint8_t * octets)
+{
+    BoardKey key = 0;
+    for (unsigned i = 0; i < KEY_SIZE; ++i)
+    {
+        key = (key << 8) | octets[i];
+    }
+    return key;
+}
+
+void encode_compressed_table_header(unsigned block_records, unsigned preset, uint8_t * header)
+{
+    fill(header, header + COMPRESSED_TABLE_HEADER_SIZE, 0);
+
+    memcpy(header, COMPRESSED_TABLE_MAGIC, COMPRESSED_TABLE_MAGIC_SIZE);
+
+    store_le(header +  8, COMPRESSED_TABLE_VERSION, 4);
+    store_le(header + 12, H_SIZE                  , 4);
+    store_le(header + 16, V_SIZE                  , 4);
+    store_le(header + 20, CONNECT_Q               , 4);
+    store_le(header + 24, KEY_SIZE                , 4);
+    store_le(header + 28, RECORD_SIZE             , 4);
+    store_le(header + 32, block_records           , 4);
+    store_le(header + 36, preset                  , 4);
+
+    store_le(header + 40, fnv1a_64(header, 40), 8);
+}
+
+vector<uint8_t> encode_compressed_table_index(const vector<CompressedBlock> & blocks, uint64_t index_offset)
+{
+    vector<uint8_t> index(blocks.size() * COMPRESSED_TABLE_INDEX_ENTRY_SIZE + COMPRESSED_TABLE_TRAILER_SIZE);
+
+    uint8_t * entry = index.data();
+
+    for (const CompressedBlock & block: blocks)
+    {
+        store_le(entry +  0, block.offset     , 8);
+        store_le(entry +  8, block.size       , 8);
+        store_le(entry + 16, block.num_records, 8);
+        store_key_le(entry + 24, block.first_key, sizeof(BoardKey));
+        store_le(entry + 24 + sizeof(BoardKey), block.checksum, 8);
+
+        entry += COMPRESSED_TABLE_INDEX_ENTRY_SIZE;
+    }
+
+    store_le(entry + 0, blocks.size(), 8);
+    store_le(entry + 8, index_offset , 8);
+
+    store_le(entry + 16, fnv1a_64(index.data(), index.size() - 8), 8);
+
+    return index;
+}
+
+CompressedBlock compress_block(const uint8_t * records, uint64_t num_records, unsigned preset, vector<uint8_t> & compressed)
+{
+    CompressedBlock block{0, 0, num_records, 0, fnv1a_64(records, num_records * RECORD_SIZE)};
+
+    // Transform the records into planes of key-difference bytes, followed by planes of score octets.
+
+    vector<uint8_t> planes(num_records * RECORD_SIZE);
+
+    BoardKey previous_key = (num_records == 0) ? 0 : load_key(records);
+
+    block.first_key = previous_key;
+
+    for (uint64_t i = 0; i < num_records; ++i)
+    {
+        const uint8_t * record = records + i * RECORD_SIZE;
+
+        const BoardKey key = load_key(record);
+
+        BoardKey difference = (key - previous_key) & KEY_MASK;
+
+        for (unsigned j = 0; j < KEY_SIZE; ++j)
+        {
+            planes[(KEY_SIZE - 1 - j) * num_records + i] = difference & 255;
+            difference >>= 8;
+        }
+
+        for (unsigned j = KEY_SIZE; j < RECORD_SIZE; ++j)
+        {
+            planes[j * num_records + i] = record[j];
+        }
+
+        previous_key = key;
+    }
+
+    // Compress the planes as an xz stream. The LZMA2 literal coder does not need to model byte positions
+    // within a record, since the planes have already separated them.
+
+    lzma_options_lzma options;
+
+    if (lzma_lzma_preset(&options, preset))
+    {
+        throw runtime_error("compress_block: unsupported preset.");
+    }
+
+    options.lc = 0;
+    options.lp = 0;
+    options.pb = 0;
+
+    const lzma_filter filters[] = {
+        {LZMA_FILTER_LZMA2, &options},
+        {LZMA_VLI_UNKNOWN , nullptr }
+    };
+
+    compressed.resize(lzma_stream_buffer_bound(planes.size()));
+
+    size_t compressed_size = 0;
+
+    if (lzma_stream_buffer_encode(const_cast<lzma_filter *>(filters), LZMA_CHECK_NONE, nullptr, planes.data(), planes.size(),
+                                  compressed.data(), &compressed_size, compressed.size()) != LZMA_OK)
+    {
+        throw runtime_error("compress_block: compression failed.");
+    }
+
+    compressed.resize(compressed_size);
+
+    return block;
+}
+
+void decompress_block(const CompressedBlock & block, const uint8_t * compressed, uint8_t * records)
+{
+    const uint64_t num_records = block.num_records;
+
+    vector<uint8_t> planes(num_records * RECORD_SIZE);
+
+    uint64_t memory_limit = UINT64_MAX;
+    size_t   in_position  = 0;
+    size_t   out_position = 0;
+
+    if (lzma_stream_buffer_decode(&memory_limit, 0, nullptr, compressed, &in_position, block.size,
+                                  planes.data(), &out_position, planes.size()) != LZMA_OK || out_position != planes.size())
+    {
+        throw runtime_error("decompress_block: decompression failed.");
+    }
+
+    // Undo the transformation.
+
+    BoardKey key = block.first_key;
+
+    for (uint64_t i = 0; i < num_records; ++i)
+    {
+        uint8_t * record = records + i * RECORD_SIZE;
+
+        BoardKey difference = 0;
+
+        for (unsigned j = 0; j < KEY_SIZE; ++j)
+        {
+            difference = (difference << 8) | planes[j * num_records + i];
+        }
+
+        key = (key + difference) & KEY_MASK;
+
+        BoardKey k = key;
+
+        for (unsigned j = 0; j < KEY_SIZE; ++j)
+        {
+            record[KEY_SIZE - 1 - j] = k & 255;
+            k >>= 8;
+        }
+
+        for (unsigned j = KEY_SIZE; j < RECORD_SIZE; ++j)
+        {
+            record[j] = planes[j * num_records + i];
+        }
+    }
+
+    if (fnv1a_64(records, num_records * RECORD_SIZE) != block.checksum)
+    {
+        throw runtime_error("decompress_block: bad block checksum.");
+    }
+}
+
+static void read_fully(int fd, uint8_t * data, uint64_t size, uint64_t offset)
+{
+    while (size != 0)
+    {
+        const ssize_t result = pread(fd, data, size, offset);
+
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (result <= 0)
+        {
+            throw runtime_error("CompressedTable: read error.");
+        }
+
+        data   += result;
+        size   -= result;
+        offset += result;
+    }
+}
+
+CompressedTable::CompressedTable(const string & filename) : fd(-1), block_records(0)
+{
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("CompressedTable: unable to open file.");
+    }
+
+    try
+    {
+        uint8_t header[COMPRESSED_TABLE_HEADER_SIZE];
+
+        read_fully(fd, header, COMPRESSED_TABLE_HEADER_SIZE, 0);
+
+        if (memcmp(header, COMPRESSED_TABLE_MAGIC, COMPRESSED_TABLE_MAGIC_SIZE) != 0)
+        {
+            throw runtime_error("CompressedTable: bad magic.");
+        }
+
+        if (load_le(header + 40, 8) != fnv1a_64(header, 40))
+        {
+            throw runtime_error("CompressedTable: bad header checksum.");
+        }
+
+        if (load_le(header + 8, 4) != COMPRESSED_TABLE_VERSION)
+        {
+            throw runtime_error("CompressedTable: unsupported version.");
+        }
+
+        if (load_le(header + 12, 4) != H_SIZE || load_le(header + 16, 4) != V_SIZE || load_le(header + 20, 4) != CONNECT_Q ||
+            load_le(header + 24, 4) != KEY_SIZE || load_le(header + 28, 4) != RECORD_SIZE)
+        {
+            throw runtime_error("CompressedTable: table is for a different board geometry.");
+        }
+
+        block_records = load_le(header + 32, 4);
+
+        // Read the trailer, which tells us where to find the block index.
+
+        const off_t file_size = lseek(fd, 0, SEEK_END);
+
+        if (file_size < static_cast<off_t>(COMPRESSED_TABLE_HEADER_SIZE + COMPRESSED_TABLE_TRAILER_SIZE))
+        {
+            throw runtime_error("CompressedTable: file is truncated.");
+        }
+
+        uint8_t trailer[COMPRESSED_TABLE_TRAILER_SIZE];
+
+        read_fully(fd, trailer, COMPRESSED_TABLE_TRAILER_SIZE, file_size - COMPRESSED_TABLE_TRAILER_SIZE);
+
+        const uint64_t num_blocks   = load_le(trailer + 0, 8);
+        const uint64_t index_offset = load_le(trailer + 8, 8);
+
+        if (index_offset < COMPRESSED_TABLE_HEADER_SIZE ||
+            index_offset + num_blocks * COMPRESSED_TABLE_INDEX_ENTRY_SIZE + COMPRESSED_TABLE_TRAILER_SIZE != static_cast<uint64_t>(file_size))
+        {
+            throw runtime_error("CompressedTable: bad trailer.");
+        }
+
+        vector<uint8_t> index(file_size - index_offset);
+
+        read_fully(fd, index.data(), index.size(), index_offset);
+
+        if (load_le(index.data() + index.size() - 8, 8) != fnv1a_64(index.data(), index.size() - 8))
+        {
+            throw runtime_error("CompressedTable: bad block index checksum.");
+        }
+
+        for (uint64_t i = 0; i < num_blocks; ++i)
+        {
+            const uint8_t * entry = index.data() + i * COMPRESSED_TABLE_INDEX_ENTRY_SIZE;
+
+            const CompressedBlock block{load_le(entry, 8), load_le(entry + 8, 8), load_le(entry + 16, 8),
+                                        load_key_le(entry + 24, sizeof(BoardKey)), load_le(entry + 24 + sizeof(BoardKey), 8)};
+
+            if (block.offset < COMPRESSED_TABLE_HEADER_SIZE || block.offset + block.size > index_offset || block.num_records > block_records)
+            {
+                throw runtime_error("CompressedTable: bad block index entry.");
+            }
+
+            blocks.push_back(block);
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+CompressedTable::~CompressedTable()
+{
+    close(fd);
+}
+
+uint64_t CompressedTable::num_records() const
+{
+    uint64_t count = 0;
+    for (const CompressedBlock & block: blocks)
+    {
+        count += block.num_records;
+    }
+    return count;
+}
+
+unsigned CompressedTable::find_block(BoardKey key) const
+{
+    const auto it = upper_bound(blocks.begin(), blocks.end(), key, [](BoardKey k, const CompressedBlock & block) { return k < block.first_key; });
+
+    return (it == blocks.begin()) ? 0 : (it - blocks.begin() - 1);
+}
+
+void CompressedTable::read_block(unsigned block_index, vector<uint8_t> & records) const
+{
+    const CompressedBlock & block = blocks.at(block_index);
+
+    vector<uint8_t> compressed(block.size);
+
+    read_fully(fd, compressed.data(), compressed.size(), block.offset);
+
+    records.resize(block.num_records * RECORD_SIZE);
+
+    decompress_block(block, compressed.data(), records.data());
+}
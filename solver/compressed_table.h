@@ -0,0 +1,131 @@
+
+////////////////////////
+// compressed_table.h //
+////////////////////////
+
+#ifndef COMPRESSED_TABLE_H
+#define COMPRESSED_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board_size.h"
+#include "derived_constants.h"
+
+// A compressed table holds the records of a binary nodes file (a big-endian board key followed by a score),
+// cut into independent blocks of a fixed number of records, each compressed separately. Blocks can
+// therefore be compressed and decompressed in parallel, and a part of the table can be decompressed without
+// decompressing the rest.
+//
+// Before compression, the records of a block are transformed to make them more compressible. Each key is
+// replaced by its difference with the previous key (modulo 256 ** NUM_BASE256_BOARD_DIGITS), and the bytes
+// are transposed into planes: first the most significant byte of all key differences, then the next byte of
+// all key differences, and so on, followed by the score octets, one plane per octet. Since the keys are sorted, the high planes
+// consist mostly of zeros, and each plane holds bytes with similar statistics. The planes are then compressed
+// as an xz stream, using the LZMA2 filter.
+//
+// The file starts with a header. All numbers in the header, the block index, and the trailer are stored in
+// little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   COMPRESSED_TABLE_MAGIC
+//          8      4   format version (COMPRESSED_TABLE_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   key size in bytes (NUM_BASE256_BOARD_DIGITS)
+//         28      4   record size in bytes (BINARY_RECORD_SIZE: key size + score size)
+//         32      4   number of records per block (the last block may hold fewer)
+//         36      4   xz preset used for compression
+//         40      8   FNV-1a hash of the preceding header bytes
+//
+// The compressed blocks follow the header. They are followed by the block index, which holds an entry per
+// block: its file offset, its compressed size, and its number of records (8 bytes each), its first key (the
+// size of a BoardKey), and the FNV-1a hash of its uncompressed records (8 bytes). The file ends with a 24-byte trailer: the number of blocks, the file offset of
+// the block index, and the FNV-1a hash of the block index and the preceding trailer bytes.
+//
+// Since the block index is written last, a compressed table can be written to a stream.
+
+constexpr const char * COMPRESSED_TABLE_MAGIC = "#C4CMP\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned COMPRESSED_TABLE_MAGIC_SIZE       = 8;
+constexpr unsigned COMPRESSED_TABLE_VERSION          = 1;
+constexpr unsigned COMPRESSED_TABLE_HEADER_SIZE      = 48;
+constexpr unsigned COMPRESSED_TABLE_INDEX_ENTRY_SIZE = 32 + sizeof(BoardKey);
+constexpr unsigned COMPRESSED_TABLE_TRAILER_SIZE     = 24;
+
+// The default number of records per block; with a record size of 5 to 8 bytes, a block is 5 to 8 MiB.
+constexpr unsigned COMPRESSED_TABLE_BLOCK_RECORDS = 1 << 20;
+
+// The default xz preset.
+constexpr unsigned COMPRESSED_TABLE_PRESET = 6;
+
+struct CompressedBlock {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t num_records;
+    BoardKey first_key;
+    uint64_t checksum;
+};
+
+// Encode a header into a buffer of COMPRESSED_TABLE_HEADER_SIZE bytes.
+void encode_compressed_table_header(unsigned block_records, unsigned preset, uint8_t * header);
+
+// Encode the block index and the trailer, given the file offset at which they will be written.
+std::vector<uint8_t> encode_compressed_table_index(const std::vector<CompressedBlock> & blocks, uint64_t index_offset);
+
+// Transform and compress the records of a block. The 'offset' and 'size' fields of the result are left zero.
+CompressedBlock compress_block(const uint8_t * records, uint64_t num_records, unsigned preset, std::vector<uint8_t> & compressed);
+
+// Decompress and untransform the records of a block, and verify them against the block index entry.
+// The 'records' buffer must have room for block.num_records records.
+void decompress_block(const CompressedBlock & block, const uint8_t * compressed, uint8_t * records);
+
+class CompressedTable
+{
+    // The CompressedTable class provides read access to the blocks of a compressed table file.
+    // Its member functions are safe to call from multiple threads.
+
+    public:
+
+        // Open the compressed table file, and read its header and block index. Throws an exception if either
+        // is damaged, or if the table is for a different board geometry than the one we are compiled for.
+        explicit CompressedTable(const std::string & filename);
+
+        // Close the compressed table file.
+        ~CompressedTable();
+
+        CompressedTable(const CompressedTable &) = delete;
+        CompressedTable & operator = (const CompressedTable &) = delete;
+
+        // The block index.
+        const std::vector<CompressedBlock> & get_blocks() const
+        {
+            return blocks;
+        }
+
+        // The number of records per block.
+        unsigned get_block_records() const
+        {
+            return block_records;
+        }
+
+        // The total number of records in the table.
+        uint64_t num_records() const;
+
+        // Find the block that holds a key, if present, i.e., the last block with a first key that is not greater.
+        unsigned find_block(BoardKey key) const;
+
+        // Read and decompress a block. The 'records' buffer is resized to hold its records.
+        void read_block(unsigned block_index, std::vector<uint8_t> & records) const;
+
+    private: // Member variables.
+
+        int                          fd;
+        unsigned                     block_records;
+        std::vector<CompressedBlock> blocks;
+};
+
+#endif // COMPRESSED_TABLE_H
@@ -9,6 +9,29 @@
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <deque>
+#include <map>
+#include <limits>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <exception>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/statvfs.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "base62.h"
 #include "player.h"
@@ -17,9 +40,64 @@
 #include "derived_constants.h"
 #include "board.h"
 #include "files.h"
+#include "node_file.h"
+#include "lookup_table.h"
+#include "search.h"
+#include "optimal_moves.h"
+#include "partitioned_db.h"
+#include "compressed_table.h"
+#include "opening_book.h"
+#include "hash.h"
+#include "little_endian.h"
+#include "loser_tree.h"
+#include "training_data.h"
+#include "height_profile.h"
+#include "wdl_file.h"
 
 using namespace std;
 
+// The standard library cannot convert 128-bit integers to or from strings; these do, for any BoardKey.
+
+static string key_to_decimal_string(BoardKey n)
+{
+    string s;
+    do
+    {
+        s.insert(s.begin(), static_cast<char>('0' + n % 10));
+        n /= 10;
+    }
+    while (n != 0);
+    return s;
+}
+
+static BoardKey decimal_string_to_key(const string & s)
+{
+    if (s.empty() || s.find_first_not_of("0123456789") != string::npos)
+    {
+        throw runtime_error("decimal_string_to_key: bad number.");
+    }
+
+    BoardKey n = 0;
+    for (const char c: s)
+    {
+        n = n * 10 + (c - '0');
+    }
+    return n;
+}
+
+static unsigned unsigned_argument(const string & s)
+{
+    // Convert a command line argument to an unsigned number. Unlike stoul, this rejects signs, leading spaces,
+    // trailing characters, and numbers that do not fit.
+
+    if (s.empty() || s.find_first_not_of("0123456789") != string::npos || s.size() > 19 || stoull(s) > numeric_limits<unsigned>::max())
+    {
+        throw runtime_error("unsigned_argument: bad number '" + s + "'.");
+    }
+
+    return stoull(s);
+}
+
 static void write_node_with_trivial_outcome(ostream & out_stream, const Board & board)
 {
     // During the inital and forward steps, we mark boards that we can determine by immediate
@@ -41,15 +119,67 @@ static void make_initial_node(const string & out_filename)
     write_node_with_trivial_outcome(out, initial_board);
 }
 
+template <typename Function>
+static void run_in_parallel(uint64_t num_items, Function function)
+{
+    // Split the items [0, num_items) into consecutive ranges, one per thread, and call
+    // function(thread_index, begin, end) for each range in its own thread. An exception
+    // thrown by any of the calls is rethrown once all threads have finished.
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+
+    mutex         failure_mutex;
+    exception_ptr failure;
+
+    vector<thread> threads;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+    {
+        const uint64_t begin = num_items * t / num_threads;
+        const uint64_t end   = num_items * (t + 1) / num_threads;
+
+        threads.emplace_back([&, t, begin, end]()
+        {
+            try
+            {
+                function(t, begin, end);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(failure_mutex);
+                failure = current_exception();
+            }
+        });
+    }
+
+    for (thread & t: threads)
+    {
+        t.join();
+    }
+
+    if (failure)
+    {
+        rethrow_exception(failure);
+    }
+}
+
+constexpr uint64_t DEFAULT_MAKE_NODES_BUFFER_SIZE = uint64_t(256) << 20;
+
 static void make_nodes(const string & in_nodes_filename,
-                       const string & out_nodes_filename)
+                       const string & out_nodes_filename,
+                       const string & out_run_index_filename,
+                       const uint64_t buffer_size)
 {
     // Given an input file of nodes, write a file with the possible nodes that
     // can be reached by starting at any of the nodes found in the input file,
     // and making a single move.
     //
-    // The output is unsorted and may contain duplicates;
-    // it should therefore be piped through 'sort -u'.
+    // The nodes are written as a sequence of sorted runs without duplicates. The input is read in batches
+    // of parents whose children fit in a buffer of 'buffer_size' bytes. The parents of a batch are expanded
+    // by multiple threads in parallel, each of which sorts and de-duplicates its own children; these are then
+    // merged into a single run. Since the same node may occur in more than one run, the output should either be
+    // piped through 'sort -u', or merged by 'merge_runs', given the run index: a text file holding the number
+    // of nodes in each run, one per line. If 'out_run_index_filename' is empty, no run index is written.
 
     const InputFile  in_nodes_file(in_nodes_filename);
     const OutputFile out_nodes_file(out_nodes_filename);
@@ -57,336 +187,4664 @@ static void make_nodes(const string & in_nodes_filename,
     istream & in_nodes  = in_nodes_file.get_istream_reference();
     ostream & out_nodes = out_nodes_file.get_ostream_reference();
 
-    Board board;
-    Score score;
+    unique_ptr<OutputFile> out_run_index_file;
 
-    while (in_nodes >> board >> score)
+    if (!out_run_index_filename.empty())
     {
-        const set<Board> unique_normalized_boards = board.generate_unique_normalized_boards();
+        out_run_index_file = make_unique<OutputFile>(out_run_index_filename);
+    }
 
-        for (const Board & unique_normalized_board: unique_normalized_boards)
+    NodeReader nodes_reader(in_nodes);
+
+    // Each parent has at most H_SIZE children.
+    const uint64_t max_batch_parents = max<uint64_t>(1, buffer_size / sizeof(BoardKey) / H_SIZE);
+
+    vector<vector<BoardKey>> thread_keys(max(1u, thread::hardware_concurrency()));
+
+    vector<BoardKey> parents;
+
+    BoardKey key;
+    Score    score;
+
+    bool done = false;
+
+    while (!done)
+    {
+        parents.clear();
+
+        while (parents.size() < max_batch_parents)
+        {
+            if (!nodes_reader.read(key, score))
+            {
+                done = true;
+                break;
+            }
+            parents.push_back(key);
+        }
+
+        if (parents.empty())
+        {
+            break;
+        }
+
+        run_in_parallel(parents.size(), [&](unsigned t, uint64_t begin, uint64_t end)
+        {
+            vector<BoardKey> & keys = thread_keys[t];
+
+            keys.clear();
+
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                for (const Board & board: Board::from_key(parents[i]).generate_unique_normalized_boards())
+                {
+                    keys.push_back(board.to_key());
+                }
+            }
+
+            sort(keys.begin(), keys.end());
+            keys.erase(unique(keys.begin(), keys.end()), keys.end());
+        });
+
+        // Merge the children found by the threads into a single run.
+
+        vector<BoardKey> first_keys(thread_keys.size());
+        vector<bool>     first_valid(thread_keys.size());
+        vector<uint64_t> next_index(thread_keys.size(), 0);
+
+        for (unsigned t = 0; t < thread_keys.size(); ++t)
+        {
+            first_valid[t] = !thread_keys[t].empty();
+            first_keys[t]  = first_valid[t] ? thread_keys[t][0] : 0;
+        }
+
+        LoserTree tree(first_keys, first_valid);
+
+        uint64_t run_size = 0;
+        bool     have_previous_key = false;
+        BoardKey previous_key = 0;
+
+        while (!tree.empty())
+        {
+            const unsigned t        = tree.winner();
+            const BoardKey next_key = tree.winner_key();
+
+            if (!have_previous_key || next_key != previous_key)
+            {
+                write_node_with_trivial_outcome(out_nodes, Board::from_key(next_key));
+                have_previous_key = true;
+                previous_key = next_key;
+                ++run_size;
+            }
+
+            const uint64_t index = ++next_index[t];
+            const bool next_valid = (index < thread_keys[t].size());
+            tree.replace_winner(next_valid, next_valid ? thread_keys[t][index] : 0);
+        }
+
+        if (out_run_index_file)
         {
-            write_node_with_trivial_outcome(out_nodes, unique_normalized_board);
+            out_run_index_file->get_ostream_reference() << run_size << '\n';
         }
     }
+
+    if (!out_nodes)
+    {
+        throw runtime_error("make_nodes: error while writing output.");
+    }
 }
 
-static void make_edges(const string & in_nodes_filename,
-                       const string & out_edges_filename)
+static uint64_t merge_run_group(const SortedNodeFile & runs_file,
+                                const vector<uint64_t> & run_ranks,
+                                const vector<uint64_t> & run_sizes,
+                                const size_t begin, const size_t end,
+                                ostream & out_nodes)
 {
-    // Given an input file of nodes, write a file with the possible edges that
-    // can be traversed by starting at any of the nodes node found in the input file,
-    // and making a single move.
-    //
-    // Each edge is written starting with the destination node followed
-    // by the source node. This is done so that a sorted version of the
-    // output can be used to determine the value of each edge, by combining
-    // the file that results from this step with a file containing node
-    // evaluations of the destination node.
-    //
-    // The output is unsorted but will not contain duplicates;
-    // it should therefore be piped through 'sort'.
+    // Merge runs [begin, end) of a text runs file, writing the unique nodes as a single run.
+    // Each run is read through its own file stream. Returns the number of nodes written.
 
-    const InputFile  in_nodes_file(in_nodes_filename);
-    const OutputFile out_edges_file(out_edges_filename);
+    vector<unique_ptr<NodeRangeReader>> readers;
+    vector<BoardKey> first_keys;
+    vector<bool>     first_valid;
+    vector<Score>    scores;
 
-    istream & in_nodes  = in_nodes_file.get_istream_reference();
-    ostream & out_edges = out_edges_file.get_ostream_reference();
+    for (size_t run = begin; run < end; ++run)
+    {
+        readers.push_back(make_unique<NodeRangeReader>(runs_file, SortedNodeFile::Position{run_ranks[run] * TEXT_NODE_FILE_LINE_SIZE, 0, run_ranks[run]}, run_sizes[run]));
+
+        BoardKey first_key = 0;
+        Score    first_score;
+
+        first_valid.push_back(readers.back()->read(first_key, first_score));
+        first_keys.push_back(first_key);
+        scores.push_back(first_score);
+    }
+
+    if (readers.empty())
+    {
+        return 0;
+    }
 
-    Board board;
-    Score score;
+    LoserTree tree(first_keys, first_valid);
 
-    while (in_nodes >> board >> score)
+    uint64_t num_written = 0;
+    bool     have_previous_key = false;
+    BoardKey previous_key = 0;
+
+    while (!tree.empty())
     {
-        const set<Board> unique_normalized_boards = board.generate_unique_normalized_boards();
+        const unsigned run = tree.winner();
+        const BoardKey key = tree.winner_key();
 
-        for (const Board & unique_normalized_board: unique_normalized_boards)
+        if (!have_previous_key || key != previous_key)
         {
-            // Write destination, followed by source.
-            out_edges << unique_normalized_board << board << '\n';
+            out_nodes << key_to_base62_string(key, NUM_BASE62_BOARD_DIGITS) << scores[run] << '\n';
+            have_previous_key = true;
+            previous_key = key;
+            ++num_written;
         }
+
+        BoardKey next_key = 0;
+        const bool next_valid = readers[run]->read(next_key, scores[run]);
+        tree.replace_winner(next_valid, next_key);
     }
+
+    return num_written;
 }
 
-static void make_edges_with_score(const string & in_edges_filename,
-                                  const string & in_nodes_with_score_filename,
-                                  const string & out_edges_with_score_filename)
+static string merge_pass_filename(const string & directory, unsigned pass)
 {
-    // We iterate over sorted (destination, source) edges. For each edge, we find
-    // the matching destination node and its evaluation in the provided
-    // 'nodes_with_score' file.
-    //
-    // We output the edge's source node and the evaluation of its outgoing edge.
+    // Construct a unique name for a temporary file that holds the runs written by an intermediate merge pass.
+
+    ostringstream filename;
+    filename << directory << "/connect4_merge_" << getpid() << "_" << setfill('0') << setw(6) << pass << ".tmp";
+    return filename.str();
+}
+
+static void merge_runs(const string & in_runs_filename,
+                       const string & in_run_index_filename,
+                       const string & out_nodes_filename)
+{
+    // Merge the sorted runs written by 'make_nodes' into a sorted file of unique nodes, given the run index.
+    // This replaces the external sort of the output of 'make_nodes': since the runs are already sorted,
+    // only the final merge phase remains. The runs file must be a text node file on disk, since each run
+    // is read from its own position in the file.
     //
-    // The output is unsorted and may contain duplicates;
-    // it should therefore be piped through 'sort -u'.
+    // Each run that is merged is read through its own file stream, so the number of runs merged at once is
+    // limited by the number of files that can be open. If there are more runs than that, groups of runs are
+    // first merged into fewer, longer runs, in intermediate passes that write a temporary runs file to the
+    // directory specified by the TMPDIR environment variable.
 
-    const InputFile  in_edges_file(in_edges_filename);
-    const InputFile  in_nodes_with_score_file(in_nodes_with_score_filename);
-    const OutputFile out_edges_with_score_file(out_edges_with_score_filename);
+    const char * tmpdir = getenv("TMPDIR");
+    const string merge_directory = (tmpdir != nullptr) ? tmpdir : "/tmp";
 
-    istream & in_edges             = in_edges_file.get_istream_reference();
-    istream & in_nodes_with_score  = in_nodes_with_score_file.get_istream_reference();
-    ostream & out_edges_with_score = out_edges_with_score_file.get_ostream_reference();
+    // Leave some files for the standard streams, the run index, and the input and output of a pass.
 
-    string edge_src_string, edge_dst_string;
+    struct rlimit open_files_limit;
 
-    string board_string;
-    Score score;
+    uint64_t fan_in = 1000000;
 
-    while (in_edges >> setw(NUM_BASE62_BOARD_DIGITS) >> edge_dst_string >> setw(NUM_BASE62_BOARD_DIGITS) >> edge_src_string)
+    if (getrlimit(RLIMIT_NOFILE, &open_files_limit) == 0 && open_files_limit.rlim_cur != RLIM_INFINITY)
     {
-        if (edge_dst_string != board_string)
+        fan_in = min<uint64_t>(fan_in, max<uint64_t>(2, open_files_limit.rlim_cur - 8));
+    }
+
+    vector<uint64_t> run_sizes;
+
+    {
+        const InputFile in_run_index_file(in_run_index_filename);
+
+        istream & in_run_index = in_run_index_file.get_istream_reference();
+
+        uint64_t run_size;
+        while (in_run_index >> run_size)
+        {
+            run_sizes.push_back(run_size);
+        }
+    }
+
+    unique_ptr<SortedNodeFile> runs_file = make_unique<SortedNodeFile>(in_runs_filename);
+
+    if (runs_file->is_packed())
+    {
+        throw runtime_error("merge_runs: the runs file must be a text node file.");
+    }
+
+    // The temporary runs file of the previous pass is removed once it has been merged, or if anything fails.
+
+    string pass_filename;
+
+    try
+    {
+        unsigned pass = 0;
+
+        while (true)
         {
-            in_nodes_with_score >> setw(NUM_BASE62_BOARD_DIGITS) >> board_string >> score;
-            if (!in_nodes_with_score)
+            vector<uint64_t> run_ranks;
+
+            uint64_t rank = 0;
+
+            for (const uint64_t run_size: run_sizes)
             {
-                throw runtime_error("make_edges_with_score: bad read.");
+                run_ranks.push_back(rank);
+                rank += run_size;
             }
 
-            if (edge_dst_string != board_string)
+            if (rank != runs_file->num_records())
             {
-                throw runtime_error("make_edges_with_score: didn't find the node we expected.");
+                throw runtime_error("merge_runs: the run index does not match the runs file.");
             }
-        }
-        out_edges_with_score << edge_src_string << score << '\n';
-    }
-}
 
-static void make_nodes_with_score(const string & in_nodes_filename,
-                                  const string & in_edges_with_score_filename,
-                                  const string & out_nodes_with_score_filename)
-{
-    // We read 'unscored' nodes (i.e., nodes for which an evaluation is not yet available),
-    // and will annotate them with evaluations, based on the 'edges_with_score' input.
+            if (run_sizes.size() <= fan_in)
+            {
+                const OutputFile out_nodes_file(out_nodes_filename);
 
-    const InputFile  in_nodes_file(in_nodes_filename);
-    const InputFile  in_edges_with_score_file(in_edges_with_score_filename);
-    const OutputFile out_nodes_with_score_file(out_nodes_with_score_filename);
+                ostream & out_nodes = out_nodes_file.get_ostream_reference();
 
-    istream & in_nodes             = in_nodes_file.get_istream_reference();
-    istream & in_edges_with_score  = in_edges_with_score_file.get_istream_reference();
-    ostream & out_nodes_with_score = out_nodes_with_score_file.get_ostream_reference();
+                merge_run_group(*runs_file, run_ranks, run_sizes, 0, run_sizes.size(), out_nodes);
 
-    string node_board_string;
-    Score  node_score;
+                if (!out_nodes)
+                {
+                    throw runtime_error("merge_runs: error while writing output.");
+                }
 
-    bool   edge_score_valid = false; // Are the values below valid (i.e., read from the input, but yet unused)?
-    string edge_score_board_string;
-    Score  edge_score;
+                break;
+            }
 
-    while (in_nodes >> setw(NUM_BASE62_BOARD_DIGITS) >> node_board_string >> node_score)
-    {
-        if (node_score.outcome != Outcome::INDETERMINATE)
-        {
-            // The node has a determined result. No outgoing edges need to be checked, we can just write the result.
-            out_nodes_with_score << node_board_string << node_score << '\n';
-        }
-        else
-        {
-            // The current node does not have a result yet; we need to determine its result evaluation by examining
-            // its outgoing edges and their results as available in the 'in_edges_with_score' input stream.
-            // For each indeterminate-result node, at least one such entry will be available.
+            const string next_pass_filename = merge_pass_filename(merge_directory, pass++);
 
-            const Board board = Board::from_base62_string(node_board_string);
-            const Player node_mover = board.mover();
+            vector<uint64_t> next_run_sizes;
 
-            bool node_mover_has_draw = false;
-            bool node_mover_has_win  = false;
-            bool node_mover_has_loss = false;
+            {
+                ofstream out_pass(next_pass_filename, ios::binary);
 
-            unsigned node_mover_min_win  = 0;
-            unsigned node_mover_max_loss = 0;
-            unsigned node_mover_any_draw = 0;
+                if (!out_pass)
+                {
+                    throw runtime_error("merge_runs: unable to open temporary file.");
+                }
 
-            while (true)
-            {
-                if (!edge_score_valid)
+                for (size_t begin = 0; begin < run_sizes.size(); begin += fan_in)
                 {
-                    if (in_edges_with_score >> setw(NUM_BASE62_BOARD_DIGITS) >> edge_score_board_string >> edge_score)
+                    const size_t end = min<size_t>(run_sizes.size(), begin + fan_in);
+
+                    try
                     {
-                        edge_score_valid = true;
+                        next_run_sizes.push_back(merge_run_group(*runs_file, run_ranks, run_sizes, begin, end, out_pass));
+                    }
+                    catch (...)
+                    {
+                        out_pass.close();
+                        remove(next_pass_filename.c_str());
+                        throw;
                     }
                 }
 
-                // If 'edge_score_valid' is false here, we have reached the end of the 'in_edges_with_score' input stream.
+                out_pass.close();
 
-                if (edge_score_valid && edge_score_board_string == node_board_string)
+                if (!out_pass)
                 {
-                    // We have a valid edge score, and it does contain information relevant to the current board (node).
-                    // Update the 'node_mover_*' variables with the new information provided by this edge.
+                    remove(next_pass_filename.c_str());
+                    throw runtime_error("merge_runs: error while writing temporary file.");
+                }
+            }
 
-                    if (edge_score.outcome == Outcome::DRAW)
-                    {
-                        const unsigned draw_ply = edge_score.ply + 1;
+            if (!pass_filename.empty())
+            {
+                remove(pass_filename.c_str());
+            }
 
-                        if (node_mover_has_draw)
-                        {
-                            if (draw_ply != node_mover_any_draw)
-                            {
-                                throw runtime_error("multiple draw-in-n ply values encountered");
-                            }
-                        }
-                        else
-                        {
-                            node_mover_has_draw = true;
-                            node_mover_any_draw = draw_ply;
-                        }
-                    }
-                    else if ((node_mover == Player::A && edge_score.outcome == Outcome::A_WINS) || (node_mover == Player::B && edge_score.outcome == Outcome::B_WINS))
-                    {
-                        const unsigned win_ply = edge_score.ply + 1;
+            pass_filename = next_pass_filename;
+            run_sizes = move(next_run_sizes);
+            runs_file = make_unique<SortedNodeFile>(pass_filename);
+        }
+    }
+    catch (...)
+    {
+        if (!pass_filename.empty())
+        {
+            remove(pass_filename.c_str());
+        }
+        throw;
+    }
+
+    if (!pass_filename.empty())
+    {
+        remove(pass_filename.c_str());
+    }
+}
+
+static string spill_filename(const string & directory, unsigned partition)
+{
+    // Construct a unique name for a temporary file that holds the keys of a single partition.
+
+    ostringstream filename;
+    filename << directory << "/connect4_spill_" << getpid() << "_" << setfill('0') << setw(6) << partition << ".tmp";
+    return filename.str();
+}
+
+static void make_nodes_partitioned(const string & in_nodes_filename,
+                                   const string & out_nodes_filename,
+                                   const unsigned num_partitions,
+                                   const uint64_t memory_limit)
+{
+    // Given an input file of nodes, write a sorted file of the unique nodes that can be reached by
+    // starting at any of the nodes found in the input file, and making a single move.
+    //
+    // This is an alternative to piping the output of 'make_nodes' through 'sort -u', that only performs
+    // duplicate detection rather than a full external merge-sort. It proceeds in two sequential passes:
+    //
+    // (1) All generated boards are distributed over 'num_partitions' spill files, according to the
+    //     high-order part of their key (i.e., each partition holds a contiguous range of keys).
+    //
+    // (2) Each partition is read back, sorted, and de-duplicated in memory. Since the partitions hold
+    //     contiguous key ranges, concatenating the results in partition order yields a sorted file.
+    //     Partitions are processed by multiple threads in parallel; the results are written in order.
+    //
+    // Spill files are written to the directory specified by the TMPDIR environment variable.
+    // The largest partition should fit in memory; for big generations, use many partitions.
+    //
+    // If 'memory_limit' is non-zero, it bounds the memory (in bytes) used by the partitions in progress:
+    // a partition is only claimed when its estimated memory fits in what remains of the limit. A partition
+    // that exceeds the limit by itself is processed on its own, with a warning.
+
+    if (num_partitions == 0)
+    {
+        throw runtime_error("make_nodes_partitioned: the number of partitions must be positive.");
+    }
+
+    const char * tmpdir = getenv("TMPDIR");
+    const string spill_directory = (tmpdir != nullptr) ? tmpdir : "/tmp";
+
+    // Each partition covers a contiguous range of 'partition_width' keys.
+    const BoardKey partition_width = (NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION + num_partitions - 1) / num_partitions;
+
+    // The spill files are removed if anything fails, in either pass.
+
+    auto remove_spill_files = [&]()
+    {
+        for (unsigned partition = 0; partition < num_partitions; ++partition)
+        {
+            remove(spill_filename(spill_directory, partition).c_str());
+        }
+    };
+
+    try
+    {
+        // Pass 1: expand the nodes, and distribute the keys of the generated boards over the spill files.
+        //
+        // As in 'make_nodes', the input is read in batches of parents whose children fit in a buffer. The parents
+        // of a batch are expanded by multiple threads in parallel, each of which collects the keys of the children
+        // per partition. The keys of each partition are then appended to its spill file, again in parallel.
+
+        {
+            const InputFile in_nodes_file(in_nodes_filename);
+
+            istream & in_nodes = in_nodes_file.get_istream_reference();
+
+            vector<unique_ptr<ofstream>> spill_files;
+
+            for (unsigned partition = 0; partition < num_partitions; ++partition)
+            {
+                spill_files.push_back(make_unique<ofstream>(spill_filename(spill_directory, partition), ios::binary));
+                if (!*spill_files.back())
+                {
+                    throw runtime_error("make_nodes_partitioned: unable to create spill file.");
+                }
+            }
+
+            NodeReader nodes_reader(in_nodes);
+
+            const uint64_t buffer_size = (memory_limit != 0) ? min(memory_limit, DEFAULT_MAKE_NODES_BUFFER_SIZE) : DEFAULT_MAKE_NODES_BUFFER_SIZE;
+
+            // Each parent has at most H_SIZE children.
+            const uint64_t max_batch_parents = max<uint64_t>(1, buffer_size / sizeof(BoardKey) / H_SIZE);
+
+            // Indexed by thread, then by partition.
+            vector<vector<vector<BoardKey>>> thread_keys(max(1u, thread::hardware_concurrency()), vector<vector<BoardKey>>(num_partitions));
+
+            vector<BoardKey> parents;
+
+            BoardKey key;
+            Score    score;
+
+            bool done = false;
+
+            while (!done)
+            {
+                parents.clear();
+
+                while (parents.size() < max_batch_parents)
+                {
+                    if (!nodes_reader.read(key, score))
+                    {
+                        done = true;
+                        break;
+                    }
+                    parents.push_back(key);
+                }
+
+                if (parents.empty())
+                {
+                    break;
+                }
+
+                run_in_parallel(parents.size(), [&](unsigned t, uint64_t begin, uint64_t end)
+                {
+                    vector<vector<BoardKey>> & partition_keys = thread_keys[t];
+
+                    for (vector<BoardKey> & keys: partition_keys)
+                    {
+                        keys.clear();
+                    }
+
+                    for (uint64_t i = begin; i < end; ++i)
+                    {
+                        for (const Board & board: Board::from_key(parents[i]).generate_unique_normalized_boards())
+                        {
+                            const BoardKey next_key = board.to_key();
+                            partition_keys[next_key / partition_width].push_back(next_key);
+                        }
+                    }
+                });
+
+                run_in_parallel(num_partitions, [&](unsigned, uint64_t begin, uint64_t end)
+                {
+                    for (uint64_t partition = begin; partition < end; ++partition)
+                    {
+                        for (const vector<vector<BoardKey>> & partition_keys: thread_keys)
+                        {
+                            const vector<BoardKey> & keys = partition_keys[partition];
+                            spill_files[partition]->write(reinterpret_cast<const char *>(keys.data()), keys.size() * sizeof(BoardKey));
+                        }
+                    }
+                });
+            }
+
+            for (const unique_ptr<ofstream> & spill_file: spill_files)
+            {
+                spill_file->close();
+                if (!*spill_file)
+                {
+                    throw runtime_error("make_nodes_partitioned: error while writing spill file.");
+                }
+            }
+        }
+
+        // Pass 2: sort and de-duplicate the partitions in parallel, and write them in partition order.
+        //
+        // Worker threads claim partitions in order. To bound memory usage, a worker will not claim a new
+        // partition while there are already 'max_pending' partitions processed or being processed that
+        // have not yet been written, or while the memory limit would be exceeded.
+        //
+        // The memory of a partition is estimated from the size of its spill file: the keys, plus the text
+        // output if all of them were unique. It is released when the partition has been written.
+
+        vector<uint64_t> partition_memory(num_partitions);
+
+        for (unsigned partition = 0; partition < num_partitions; ++partition)
+        {
+            ifstream spill_file(spill_filename(spill_directory, partition), ios::binary | ios::ate);
+            const uint64_t spill_file_size = spill_file.tellg();
+            partition_memory[partition] = spill_file_size + spill_file_size / sizeof(BoardKey) * TEXT_NODE_FILE_LINE_SIZE;
+        }
+
+        const OutputFile out_nodes_file(out_nodes_filename);
+
+        ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+        const unsigned num_threads = max(1u, thread::hardware_concurrency());
+        const unsigned max_pending = 2 * num_threads;
+
+        vector<string> partition_output(num_partitions);
+        vector<bool>   partition_done(num_partitions, false);
+
+        unsigned next_partition    = 0; // The next partition to be claimed by a worker thread.
+        unsigned written_partition = 0; // The next partition to be written to the output.
+        uint64_t memory_in_use     = 0; // The memory of the claimed partitions that have not yet been written.
+        bool     worker_failed     = false;
+
+        // Check if the next partition can be claimed without exceeding the memory limit.
+        auto memory_available = [&]()
+        {
+            return memory_limit == 0 || memory_in_use == 0 || memory_in_use + partition_memory[next_partition] <= memory_limit;
+        };
+
+        mutex              state_mutex;
+        condition_variable state_changed;
+
+        auto worker = [&]()
+        {
+            while (true)
+            {
+                unsigned partition;
+
+                {
+                    unique_lock<mutex> lock(state_mutex);
+                    state_changed.wait(lock, [&]{ return worker_failed || next_partition == num_partitions || (next_partition < written_partition + max_pending && memory_available()); });
+                    if (worker_failed || next_partition == num_partitions)
+                    {
+                        return;
+                    }
+                    partition = next_partition++;
+                    memory_in_use += partition_memory[partition];
+                    if (memory_limit != 0 && partition_memory[partition] > memory_limit)
+                    {
+                        cerr << "make_nodes_partitioned: warning: partition " << partition << " exceeds the memory limit; use more partitions." << endl;
+                    }
+                }
+
+                try
+                {
+                    const string filename = spill_filename(spill_directory, partition);
+
+                    vector<BoardKey> keys;
+
+                    {
+                        ifstream spill_file(filename, ios::binary | ios::ate);
+                        const streamoff spill_file_size = spill_file.tellg();
+                        keys.resize(spill_file_size / sizeof(BoardKey));
+                        spill_file.seekg(0);
+                        if (!spill_file.read(reinterpret_cast<char *>(keys.data()), keys.size() * sizeof(BoardKey)))
+                        {
+                            throw runtime_error("make_nodes_partitioned: error while reading spill file.");
+                        }
+                    }
+
+                    remove(filename.c_str());
+
+                    sort(keys.begin(), keys.end());
+                    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+                    ostringstream partition_stream;
+
+                    for (const BoardKey key: keys)
+                    {
+                        write_node_with_trivial_outcome(partition_stream, Board::from_key(key));
+                    }
+
+                    lock_guard<mutex> lock(state_mutex);
+                    partition_output[partition] = partition_stream.str();
+                    partition_done[partition] = true;
+                    state_changed.notify_all();
+                }
+                catch (...)
+                {
+                    lock_guard<mutex> lock(state_mutex);
+                    worker_failed = true;
+                    state_changed.notify_all();
+                    return;
+                }
+            }
+        };
+
+        vector<thread> workers;
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+
+        {
+            unique_lock<mutex> lock(state_mutex);
+            while (written_partition < num_partitions)
+            {
+                state_changed.wait(lock, [&]{ return worker_failed || partition_done[written_partition]; });
+                if (worker_failed)
+                {
+                    break;
+                }
+
+                // Write the partition without holding the lock, so workers can continue.
+                string output;
+                output.swap(partition_output[written_partition]);
+                lock.unlock();
+                out_nodes << output;
+                lock.lock();
+
+                memory_in_use -= partition_memory[written_partition];
+                ++written_partition;
+                state_changed.notify_all();
+            }
+        }
+
+        for (thread & t: workers)
+        {
+            t.join();
+        }
+
+        if (worker_failed)
+        {
+            throw runtime_error("make_nodes_partitioned: failed to process a partition.");
+        }
+    }
+    catch (...)
+    {
+        remove_spill_files();
+        throw;
+    }
+}
+
+static uint64_t free_disk_space(const char * directory_variable)
+{
+    // Determine the free space, in bytes, of the directory given by an environment variable.
+    // Returns 0 if the variable is not set or the directory cannot be examined.
+
+    const char * directory = getenv(directory_variable);
+
+    struct statvfs info;
+
+    if (directory == nullptr || statvfs(directory, &info) != 0)
+    {
+        return 0;
+    }
+
+    return static_cast<uint64_t>(info.f_bavail) * info.f_frsize;
+}
+
+static string sort_arguments(unsigned num_threads, uint64_t buffer_size)
+{
+    // Make the arguments for the 'sort' tool, given the number of threads and the buffer size in bytes.
+    // The number of files merged at once is limited by the number of files that 'sort' can open.
+
+    struct rlimit open_files_limit;
+
+    uint64_t batch_size = 1000000;
+
+    if (getrlimit(RLIMIT_NOFILE, &open_files_limit) == 0 && open_files_limit.rlim_cur != RLIM_INFINITY)
+    {
+        batch_size = min<uint64_t>(batch_size, max<uint64_t>(2, open_files_limit.rlim_cur - 3));
+    }
+
+    const uint64_t buffer_size_mib = max<uint64_t>(1, (buffer_size + (1 << 20) - 1) >> 20);
+
+    ostringstream arguments;
+    arguments << "--parallel=" << num_threads << " --batch-size=" << batch_size << " --buffer-size=" << buffer_size_mib << "M";
+    return arguments.str();
+}
+
+static void plan(const string & in_log_filename, const unsigned generation, uint64_t memory_limit)
+{
+    // Plan the processing of a generation, given the log file of the connect4-script that holds the number of
+    // boards per generation found so far, and the resources of this machine.
+    //
+    // The size of the next generation is predicted from the current generation and the branching ratio of the
+    // previous one. Given the memory limit (by default, three quarters of the physical memory), the number of
+    // threads, and the free space in TMPDIR and DATADIR, the plan chooses between the partitioned, in-memory
+    // de-duplication of the forward stage and an external sort, and sizes the partitions and the sort buffers.
+    //
+    // The plan is written to stdout as bash variable assignments, preceded by comments that explain the decisions.
+
+    vector<uint64_t> counts;
+
+    {
+        ifstream in_log(in_log_filename);
+        if (!in_log)
+        {
+            throw runtime_error("plan: unable to open log file.");
+        }
+
+        uint64_t count;
+        while (in_log >> count)
+        {
+            counts.push_back(count);
+        }
+    }
+
+    if (generation >= counts.size())
+    {
+        throw runtime_error("plan: the log file does not hold the number of boards of the generation.");
+    }
+
+    // Determine the available resources.
+
+    const uint64_t physical_memory = static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+
+    if (memory_limit == 0)
+    {
+        memory_limit = physical_memory / 4 * 3;
+    }
+
+    const unsigned num_threads   = max(1u, thread::hardware_concurrency());
+    const uint64_t free_tmpdir   = free_disk_space("TMPDIR");
+    const uint64_t free_datadir  = free_disk_space("DATADIR");
+
+    // Predict the size of the next generation. The branching ratio cannot exceed the number of columns.
+
+    const uint64_t count = counts[generation];
+
+    const double branching_ratio = (generation == 0 || counts[generation - 1] == 0) ? H_SIZE :
+                                   min<double>(H_SIZE, static_cast<double>(count) / counts[generation - 1]);
+
+    const uint64_t predicted_count = (generation + 1 < counts.size()) ? counts[generation + 1] : static_cast<uint64_t>(count * branching_ratio + 0.5);
+
+    cout << "# generation " << generation << ": " << count << " boards; branching ratio " << fixed << setprecision(3) << branching_ratio
+         << "; predicted " << predicted_count << " boards in generation " << generation + 1 << "." << endl;
+
+    cout << "# resources: memory limit " << (memory_limit >> 20) << " MiB (physical " << (physical_memory >> 20) << " MiB), "
+         << num_threads << " threads, " << (free_tmpdir >> 20) << " MiB free in TMPDIR, " << (free_datadir >> 20) << " MiB free in DATADIR." << endl;
+
+    // Forward stage: the spill files hold the keys of all generated boards, duplicates included.
+    // Each partition in progress needs memory for its keys, and for its text output.
+
+    const uint64_t spill_size         = count * H_SIZE * sizeof(BoardKey);
+    const uint64_t partitioned_memory = spill_size + count * H_SIZE * TEXT_NODE_FILE_LINE_SIZE;
+    const uint64_t unsorted_size      = count * H_SIZE * TEXT_NODE_FILE_LINE_SIZE;
+    const uint64_t next_size          = predicted_count * TEXT_NODE_FILE_LINE_SIZE;
+
+    unsigned forward_partitions = 0;
+
+    if (spill_size <= free_tmpdir)
+    {
+        // Choose the partitions such that each of the threads can work on a partition within the memory limit.
+
+        const uint64_t partitions = (partitioned_memory * num_threads + memory_limit - 1) / memory_limit;
+
+        forward_partitions = static_cast<unsigned>(min<uint64_t>(max<uint64_t>(partitions, num_threads), 4096));
+
+        cout << "# forward: spill files of " << (spill_size >> 20) << " MiB fit in TMPDIR; de-duplicating in memory using "
+             << forward_partitions << " partitions." << endl;
+    }
+    else
+    {
+        cout << "# forward: spill files of " << (spill_size >> 20) << " MiB do not fit in TMPDIR; using an external sort." << endl;
+    }
+
+    const string sort_arguments_forward = sort_arguments(num_threads, min(memory_limit, unsorted_size));
+
+    // Backward stage: the edges with score that are sorted hold at most one line per move into the next generation.
+
+    const uint64_t edges_size = predicted_count * H_SIZE * TEXT_NODE_FILE_LINE_SIZE;
+
+    const string sort_arguments_backward = sort_arguments(num_threads, min(memory_limit, edges_size));
+
+    if (next_size > free_datadir)
+    {
+        cout << "# warning: the predicted nodes file of " << (next_size >> 20) << " MiB may not fit in DATADIR." << endl;
+    }
+
+    cout << "PLAN_PREDICTED_NODES="    << predicted_count                << endl;
+    cout << "PLAN_FORWARD_PARTITIONS=" << forward_partitions             << endl;
+    cout << "PLAN_SORTARGS_FORWARD=\""  << sort_arguments_forward  << "\"" << endl;
+    cout << "PLAN_SORTARGS_BACKWARD=\"" << sort_arguments_backward << "\"" << endl;
+    cout << "PLAN_MEMORY_LIMIT_MIB="   << (memory_limit >> 20)           << endl;
+}
+
+static string route_filename(const string & directory, unsigned task, unsigned shard)
+{
+    // Construct the name of the file that holds the keys routed from an expand task to a shard.
+
+    ostringstream filename;
+    filename << directory << "/route_" << setfill('0') << setw(6) << task << "_" << setw(6) << shard << ".bin";
+    return filename.str();
+}
+
+static string shard_filename(const string & directory, unsigned shard)
+{
+    // Construct the name of the file that holds the unique nodes of a shard.
+
+    ostringstream filename;
+    filename << directory << "/shard_" << setfill('0') << setw(6) << shard << ".dat";
+    return filename.str();
+}
+
+static void worker_expand(const string & in_nodes_filename, BoardKey first_key, BoardKey end_key,
+                          const string & shard_directory, unsigned task, unsigned num_shards)
+{
+    // Expand the nodes of a sorted node file with keys in [first_key, end_key), and route the keys of the
+    // generated boards to the shards, according to the high-order part of their key. The keys routed to each
+    // shard are written to a file in the shard directory, which is only given its final name when complete.
+
+    const SortedNodeFile in_nodes_file(in_nodes_filename);
+
+    const SortedNodeFile::Position first = in_nodes_file.lower_bound(first_key);
+    const SortedNodeFile::Position end   = in_nodes_file.lower_bound(end_key);
+
+    NodeRangeReader nodes_reader(in_nodes_file, first, end.rank - first.rank);
+
+    const BoardKey shard_width = (NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION + num_shards - 1) / num_shards;
+
+    vector<unique_ptr<ofstream>> route_files;
+
+    for (unsigned shard = 0; shard < num_shards; ++shard)
+    {
+        route_files.push_back(make_unique<ofstream>(route_filename(shard_directory, task, shard) + ".tmp", ios::binary));
+        if (!*route_files.back())
+        {
+            throw runtime_error("worker: unable to create route file.");
+        }
+    }
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        const Board board = Board::from_key(key);
+
+        const set<Board> unique_normalized_boards = board.generate_unique_normalized_boards();
+
+        for (const Board & unique_normalized_board: unique_normalized_boards)
+        {
+            const BoardKey next_key = unique_normalized_board.to_key();
+            route_files[next_key / shard_width]->write(reinterpret_cast<const char *>(&next_key), sizeof(next_key));
+        }
+    }
+
+    for (unsigned shard = 0; shard < num_shards; ++shard)
+    {
+        route_files[shard]->close();
+        if (!*route_files[shard])
+        {
+            throw runtime_error("worker: error while writing route file.");
+        }
+
+        const string filename = route_filename(shard_directory, task, shard);
+
+        if (rename((filename + ".tmp").c_str(), filename.c_str()) != 0)
+        {
+            throw runtime_error("worker: unable to rename route file.");
+        }
+    }
+}
+
+static void worker_dedup(const string & shard_directory, unsigned shard, unsigned num_tasks)
+{
+    // Gather the keys routed to a shard by all expand tasks, and write the unique nodes of the shard, sorted,
+    // to a file in the shard directory, which is only given its final name when complete.
+
+    vector<BoardKey> keys;
+
+    for (unsigned task = 0; task < num_tasks; ++task)
+    {
+        ifstream route_file(route_filename(shard_directory, task, shard), ios::binary | ios::ate);
+        if (!route_file)
+        {
+            throw runtime_error("worker: unable to open route file.");
+        }
+
+        const streamoff route_file_size = route_file.tellg();
+        const size_t previous_size = keys.size();
+        keys.resize(previous_size + route_file_size / sizeof(BoardKey));
+        route_file.seekg(0);
+        if (!route_file.read(reinterpret_cast<char *>(keys.data() + previous_size), (keys.size() - previous_size) * sizeof(BoardKey)))
+        {
+            throw runtime_error("worker: error while reading route file.");
+        }
+    }
+
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+    const string filename = shard_filename(shard_directory, shard);
+
+    {
+        ofstream out_nodes(filename + ".tmp");
+
+        for (const BoardKey key: keys)
+        {
+            write_node_with_trivial_outcome(out_nodes, Board::from_key(key));
+        }
+
+        out_nodes.close();
+        if (!out_nodes)
+        {
+            throw runtime_error("worker: error while writing shard file.");
+        }
+    }
+
+    if (rename((filename + ".tmp").c_str(), filename.c_str()) != 0)
+    {
+        throw runtime_error("worker: unable to rename shard file.");
+    }
+}
+
+static pid_t start_worker(const vector<string> & worker_args)
+{
+    // Start a worker process that runs this program with the given arguments. Returns its process ID.
+
+    const pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        throw runtime_error("coordinator: unable to start worker process.");
+    }
+
+    if (pid == 0)
+    {
+        vector<char *> argv;
+
+        argv.push_back(const_cast<char *>("connect4"));
+        for (const string & arg: worker_args)
+        {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        execv("/proc/self/exe", argv.data());
+        _exit(127);
+    }
+
+    return pid;
+}
+
+static void coordinator(const string & in_nodes_filename,
+                        const string & out_nodes_filename,
+                        const unsigned num_shards,
+                        const unsigned num_workers)
+{
+    // Given an input file of nodes, write a sorted file of the unique nodes that can be reached by
+    // starting at any of the nodes found in the input file, and making a single move, using a number
+    // of worker processes. The output is the same as that of --make-nodes followed by 'sort -u'.
+    //
+    // The work is divided into tasks, that are run in two phases:
+    //
+    // (1) Expand: the input file is split into 'num_shards' key ranges that hold about the same number of
+    //     nodes. A worker expands the nodes of a range, and routes the keys of the generated boards to the
+    //     shards, each of which covers a contiguous range of keys, through route files.
+    //
+    // (2) Dedup: a worker gathers the keys routed to a shard, and writes its unique nodes to a shard file.
+    //
+    // The coordinator then concatenates the shard files, in order. The files are exchanged through a shard
+    // directory, which is made in the directory specified by the TMPDIR environment variable. Workers only
+    // give their output files their final names when these are complete, so a task that fails (i.e., its
+    // worker does not exit successfully) can simply be run again. A task is tried at most 'max_attempts' times.
+
+    const unsigned max_attempts = 3;
+
+    const char * tmpdir = getenv("TMPDIR");
+
+    ostringstream shard_directory_stream;
+    shard_directory_stream << ((tmpdir != nullptr) ? tmpdir : "/tmp") << "/connect4_shards_" << getpid();
+    const string shard_directory = shard_directory_stream.str();
+
+    if (mkdir(shard_directory.c_str(), 0777) != 0)
+    {
+        throw runtime_error("coordinator: unable to create shard directory.");
+    }
+
+    // Choose the key ranges of the expand tasks, from about 64 samples per task.
+
+    vector<BoardKey> task_keys{0};
+
+    {
+        const SortedNodeFile in_nodes_file(in_nodes_filename);
+
+        const vector<BoardKey> samples = in_nodes_file.sample_keys(max(uint64_t(1), in_nodes_file.num_records() / (num_shards * 64)));
+
+        for (unsigned i = 1; i < num_shards && !samples.empty(); ++i)
+        {
+            const BoardKey key = samples[static_cast<uint64_t>(i) * samples.size() / num_shards];
+
+            if (key > task_keys.back())
+            {
+                task_keys.push_back(key);
+            }
+        }
+
+        task_keys.push_back(NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION);
+    }
+
+    const unsigned num_tasks = task_keys.size() - 1;
+
+    // Run the tasks of a phase on at most 'num_workers' worker processes at a time, and track their completion.
+
+    auto run_phase = [&](const string & phase, unsigned num_phase_tasks, function<vector<string>(unsigned)> task_args)
+    {
+        vector<unsigned> attempts(num_phase_tasks, 0);
+        vector<bool>     completed(num_phase_tasks, false);
+
+        deque<unsigned>           pending_tasks;
+        map<pid_t, unsigned>      running_tasks;
+        bool                      phase_failed = false;
+
+        for (unsigned task = 0; task < num_phase_tasks; ++task)
+        {
+            pending_tasks.push_back(task);
+        }
+
+        while (!running_tasks.empty() || (!pending_tasks.empty() && !phase_failed))
+        {
+            while (!pending_tasks.empty() && !phase_failed && running_tasks.size() < num_workers)
+            {
+                const unsigned task = pending_tasks.front();
+                pending_tasks.pop_front();
+                ++attempts[task];
+                running_tasks[start_worker(task_args(task))] = task;
+            }
+
+            int status;
+            const pid_t pid = wait(&status);
+
+            if (pid < 0)
+            {
+                throw runtime_error("coordinator: error while waiting for worker processes.");
+            }
+
+            const auto running_task = running_tasks.find(pid);
+
+            if (running_task == running_tasks.end())
+            {
+                continue;
+            }
+
+            const unsigned task = running_task->second;
+            running_tasks.erase(running_task);
+
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            {
+                completed[task] = true;
+            }
+            else if (attempts[task] < max_attempts)
+            {
+                cerr << "coordinator: " << phase << " task " << task << " failed (attempt " << attempts[task] << "); retrying." << endl;
+                pending_tasks.push_back(task);
+            }
+            else
+            {
+                cerr << "coordinator: " << phase << " task " << task << " failed (attempt " << attempts[task] << "); giving up." << endl;
+                phase_failed = true;
+            }
+        }
+
+        return !phase_failed;
+    };
+
+    auto remove_shard_directory = [&]()
+    {
+        for (unsigned shard = 0; shard < num_shards; ++shard)
+        {
+            for (unsigned task = 0; task < num_tasks; ++task)
+            {
+                remove(route_filename(shard_directory, task, shard).c_str());
+                remove((route_filename(shard_directory, task, shard) + ".tmp").c_str());
+            }
+            remove(shard_filename(shard_directory, shard).c_str());
+            remove((shard_filename(shard_directory, shard) + ".tmp").c_str());
+        }
+        rmdir(shard_directory.c_str());
+    };
+
+    const bool success =
+        run_phase("expand", num_tasks, [&](unsigned task) {
+            return vector<string>{"--worker", "expand", in_nodes_filename, key_to_decimal_string(task_keys[task]), key_to_decimal_string(task_keys[task + 1]),
+                                  shard_directory, to_string(task), to_string(num_shards)};
+        }) &&
+        run_phase("dedup", num_shards, [&](unsigned shard) {
+            return vector<string>{"--worker", "dedup", shard_directory, to_string(shard), to_string(num_tasks)};
+        });
+
+    if (!success)
+    {
+        remove_shard_directory();
+        throw runtime_error("coordinator: a task failed.");
+    }
+
+    // Concatenate the shard files, in order.
+
+    {
+        const OutputFile out_nodes_file(out_nodes_filename);
+
+        ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+        for (unsigned shard = 0; shard < num_shards; ++shard)
+        {
+            ifstream shard_file(shard_filename(shard_directory, shard), ios::binary);
+
+            if (!shard_file)
+            {
+                remove_shard_directory();
+                throw runtime_error("coordinator: unable to open shard file.");
+            }
+
+            // Inserting an empty stream buffer would set the failbit of the output stream.
+
+            if (shard_file.peek() != ifstream::traits_type::eof())
+            {
+                out_nodes << shard_file.rdbuf();
+            }
+
+            remove(shard_filename(shard_directory, shard).c_str());
+        }
+    }
+
+    remove_shard_directory();
+}
+
+static void make_edges(const string & in_nodes_filename,
+                       const string & out_edges_filename)
+{
+    // Given an input file of nodes, write a file with the possible edges that
+    // can be traversed by starting at any of the nodes node found in the input file,
+    // and making a single move.
+    //
+    // Each edge is written starting with the destination node followed
+    // by the source node. This is done so that a sorted version of the
+    // output can be used to determine the value of each edge, by combining
+    // the file that results from this step with a file containing node
+    // evaluations of the destination node.
+    //
+    // The output is unsorted but will not contain duplicates;
+    // it should therefore be piped through 'sort'.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_edges_file(out_edges_filename);
+
+    istream & in_nodes  = in_nodes_file.get_istream_reference();
+    ostream & out_edges = out_edges_file.get_ostream_reference();
+
+    NodeReader nodes_reader(in_nodes);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        const Board board = Board::from_key(key);
+
+        const set<Board> unique_normalized_boards = board.generate_unique_normalized_boards();
+
+        for (const Board & unique_normalized_board: unique_normalized_boards)
+        {
+            // Write destination, followed by source.
+            out_edges << unique_normalized_board << board << '\n';
+        }
+    }
+}
+
+// A compact edge is written as the destination node, followed by a single base-62 digit that holds the move
+// (2 * x + m) that leads to it: the source node made a move in column x, and m is 1 if the resulting board was
+// mirrored when it was normalized. The source node is recovered by mirroring the destination if m is 1, and then
+// taking back the move in column x. This is about half the size of an edge that holds both nodes.
+
+static_assert(2 * H_SIZE <= 62, "The move of a compact edge must fit in a single base-62 digit.");
+
+static void make_compact_edges(const string & in_nodes_filename,
+                               const string & out_edges_filename)
+{
+    // As make_edges, but the edges are written in the compact form.
+    //
+    // The output is unsorted but will not contain duplicates;
+    // it should therefore be piped through 'sort'.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_edges_file(out_edges_filename);
+
+    istream & in_nodes  = in_nodes_file.get_istream_reference();
+    ostream & out_edges = out_edges_file.get_ostream_reference();
+
+    NodeReader nodes_reader(in_nodes);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        const Board board = Board::from_key(key);
+
+        if (board.trivial_outcome() != Outcome::INDETERMINATE)
+        {
+            continue;
+        }
+
+        // Moves that lead to the same normalized board are the same edge; only the first is written.
+
+        set<Board> destinations;
+
+        for (int x = 0; x < H_SIZE; ++x)
+        {
+            if (board.can_play(x))
+            {
+                const Board next_board = board.play(x);
+                const Board destination = next_board.normalize();
+
+                if (destinations.insert(destination).second)
+                {
+                    const unsigned move = 2 * x + (destination.to_key() != next_board.to_key() ? 1 : 0);
+                    out_edges << destination << key_to_base62_string(move, 1) << '\n';
+                }
+            }
+        }
+    }
+}
+
+static void make_edges_with_score(const string & in_edges_filename,
+                                  const string & in_nodes_with_score_filename,
+                                  const string & out_edges_with_score_filename)
+{
+    // We iterate over sorted (destination, source) edges. For each edge, we find
+    // the matching destination node and its evaluation in the provided
+    // 'nodes_with_score' file.
+    //
+    // We output the edge's source node and the evaluation of its outgoing edge.
+    // The edges can be in either form: with both nodes, or compact (see make_compact_edges).
+    //
+    // The output is unsorted and may contain duplicates;
+    // it should therefore be piped through 'sort -u'.
+
+    const InputFile  in_edges_file(in_edges_filename);
+    const InputFile  in_nodes_with_score_file(in_nodes_with_score_filename);
+    const OutputFile out_edges_with_score_file(out_edges_with_score_filename);
+
+    istream & in_edges             = in_edges_file.get_istream_reference();
+    istream & in_nodes_with_score  = in_nodes_with_score_file.get_istream_reference();
+    ostream & out_edges_with_score = out_edges_with_score_file.get_ostream_reference();
+
+    NodeReader nodes_with_score_reader(in_nodes_with_score);
+
+    string edge_string, edge_src_string, edge_dst_string;
+
+    string   board_string;
+    BoardKey board_key;
+    Score    score;
+
+    while (in_edges >> edge_string)
+    {
+        edge_dst_string = edge_string.substr(0, NUM_BASE62_BOARD_DIGITS);
+
+        if (edge_string.size() == 2 * NUM_BASE62_BOARD_DIGITS)
+        {
+            edge_src_string = edge_string.substr(NUM_BASE62_BOARD_DIGITS);
+        }
+        else if (edge_string.size() == NUM_BASE62_BOARD_DIGITS + 1)
+        {
+            const unsigned move = base62_string_to_key(edge_string.substr(NUM_BASE62_BOARD_DIGITS));
+            const Board destination = Board::from_base62_string(edge_dst_string);
+            const Board next_board = (move % 2 != 0) ? destination.mirror() : destination;
+
+            edge_src_string = next_board.unplay(move / 2).to_base62_string();
+        }
+        else
+        {
+            throw runtime_error("make_edges_with_score: bad edge.");
+        }
+
+        if (edge_dst_string != board_string)
+        {
+            if (!nodes_with_score_reader.read(board_key, score))
+            {
+                throw runtime_error("make_edges_with_score: bad read.");
+            }
+
+            board_string = key_to_base62_string(board_key, NUM_BASE62_BOARD_DIGITS);
+
+            if (edge_dst_string != board_string)
+            {
+                throw runtime_error("make_edges_with_score: didn't find the node we expected.");
+            }
+        }
+        out_edges_with_score << edge_src_string << score << '\n';
+    }
+}
+
+static void make_parent_edges_with_score(const string & in_nodes_with_score_filename,
+                                         const string & out_edges_with_score_filename)
+{
+    // This is an alternative to the 'make_edges', 'sort', 'make_edges_with_score' sequence that
+    // determines edges with score by working backward from the nodes with score, rather than forward
+    // from the nodes without score.
+    //
+    // For each node in the 'nodes_with_score' file of generation (n+1), we generate its predecessors
+    // in generation n by taking back a move, and output each predecessor together with the node's score.
+    //
+    // Some predecessors may not be reachable; 'make_nodes_with_score' will skip those.
+    //
+    // The output is unsorted and may contain duplicates;
+    // it should therefore be piped through 'sort -u'.
+
+    const InputFile  in_nodes_with_score_file(in_nodes_with_score_filename);
+    const OutputFile out_edges_with_score_file(out_edges_with_score_filename);
+
+    istream & in_nodes_with_score  = in_nodes_with_score_file.get_istream_reference();
+    ostream & out_edges_with_score = out_edges_with_score_file.get_ostream_reference();
+
+    NodeReader nodes_with_score_reader(in_nodes_with_score);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_with_score_reader.read(key, score))
+    {
+        const Board board = Board::from_key(key);
+
+        const set<Board> predecessors = board.generate_predecessors();
+
+        for (const Board & predecessor: predecessors)
+        {
+            out_edges_with_score << predecessor << score << '\n';
+        }
+    }
+}
+
+static void make_nodes_with_score(const string & in_nodes_filename,
+                                  const string & in_edges_with_score_filename,
+                                  const string & out_nodes_with_score_filename,
+                                  const bool     wdl_only)
+{
+    // We read 'unscored' nodes (i.e., nodes for which an evaluation is not yet available),
+    // and will annotate them with evaluations, based on the 'edges_with_score' input.
+    //
+    // If 'wdl_only' is true, only the outcome (win/draw/loss) is tracked; the ply of all
+    // scores is set to zero.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const InputFile  in_edges_with_score_file(in_edges_with_score_filename);
+    const OutputFile out_nodes_with_score_file(out_nodes_with_score_filename);
+
+    istream & in_nodes             = in_nodes_file.get_istream_reference();
+    istream & in_edges_with_score  = in_edges_with_score_file.get_istream_reference();
+    ostream & out_nodes_with_score = out_nodes_with_score_file.get_ostream_reference();
+
+    NodeReader nodes_reader(in_nodes);
+
+    BoardKey node_key;
+    string   node_board_string;
+    Score    node_score;
+
+    bool   edge_score_valid = false; // Are the values below valid (i.e., read from the input, but yet unused)?
+    string edge_score_board_string;
+    Score  edge_score;
+
+    while (nodes_reader.read(node_key, node_score))
+    {
+        node_board_string = key_to_base62_string(node_key, NUM_BASE62_BOARD_DIGITS);
+
+        if (node_score.outcome != Outcome::INDETERMINATE)
+        {
+            // The node has a determined result. No outgoing edges need to be checked, we can just write the result.
+            out_nodes_with_score << node_board_string << node_score << '\n';
+        }
+        else
+        {
+            // The current node does not have a result yet; we need to determine its result evaluation by examining
+            // its outgoing edges and their results as available in the 'in_edges_with_score' input stream.
+            // For each indeterminate-result node, at least one such entry will be available.
+
+            const Board board = Board::from_key(node_key);
+            const Player node_mover = board.mover();
+
+            bool node_mover_has_draw = false;
+            bool node_mover_has_win  = false;
+            bool node_mover_has_loss = false;
+
+            unsigned node_mover_min_win  = 0;
+            unsigned node_mover_max_loss = 0;
+            unsigned node_mover_any_draw = 0;
+
+            while (true)
+            {
+                if (!edge_score_valid)
+                {
+                    if (in_edges_with_score >> setw(NUM_BASE62_BOARD_DIGITS) >> edge_score_board_string >> edge_score)
+                    {
+                        edge_score_valid = true;
+                    }
+                }
+
+                // If 'edge_score_valid' is false here, we have reached the end of the 'in_edges_with_score' input stream.
+
+                if (edge_score_valid && edge_score_board_string < node_board_string)
+                {
+                    // The edge score refers to a board that is not in the nodes file. This happens when the edges
+                    // with score were derived from predecessors (see make_parent_edges_with_score), which can include
+                    // boards that are not reachable. Skip it.
+                    edge_score_valid = false;
+                    continue;
+                }
+
+                if (edge_score_valid && edge_score_board_string == node_board_string)
+                {
+                    // We have a valid edge score, and it does contain information relevant to the current board (node).
+                    // Update the 'node_mover_*' variables with the new information provided by this edge.
+
+                    if (edge_score.outcome == Outcome::DRAW)
+                    {
+                        const unsigned draw_ply = wdl_only ? 0 : edge_score.ply + 1;
+
+                        if (node_mover_has_draw)
+                        {
+                            if (draw_ply != node_mover_any_draw)
+                            {
+                                throw runtime_error("multiple draw-in-n ply values encountered");
+                            }
+                        }
+                        else
+                        {
+                            node_mover_has_draw = true;
+                            node_mover_any_draw = draw_ply;
+                        }
+                    }
+                    else if ((node_mover == Player::A && edge_score.outcome == Outcome::A_WINS) || (node_mover == Player::B && edge_score.outcome == Outcome::B_WINS))
+                    {
+                        const unsigned win_ply = wdl_only ? 0 : edge_score.ply + 1;
+
+                        if (node_mover_has_win)
+                        {
+                            if (win_ply < node_mover_min_win)
+                            {
+                                node_mover_min_win = win_ply;
+                            }
+                        }
+                        else
+                        {
+                            node_mover_has_win = true;
+                            node_mover_min_win = win_ply;
+                        }
+                    }
+                    else // The mover loses
+                    {
+                        const unsigned loss_ply = wdl_only ? 0 : edge_score.ply + 1;
+
+                        if (node_mover_has_loss)
+                        {
+                            if (loss_ply > node_mover_max_loss)
+                            {
+                                node_mover_max_loss = loss_ply;
+                            }
+                        }
+                        else
+                        {
+                            node_mover_has_loss = true;
+                            node_mover_max_loss = loss_ply;
+                        }
+                    }
+                    edge_score_valid = false; // Invalidate current score; we used it.
+                }
+                else
+                {
+                    // Either we reached the end of the 'in_edges_with_score' stream, or the edge just read from it is not
+                    // relevant to the currently processed node (board). In either case, we can now calculate the evaluation
+                    // for the current node.
+
+                    if (node_mover_has_win)
+                    {
+                        // The mover's best move is a win.
+                        const Score score = Score(node_mover == Player::A ? Outcome::A_WINS : Outcome::B_WINS, node_mover_min_win);
+                        out_nodes_with_score << node_board_string << score << '\n';
+                    }
+                    else if (node_mover_has_draw)
+                    {
+                        // The mover's best move is a draw.
+                        const Score score = Score(Outcome::DRAW, node_mover_any_draw);
+                        out_nodes_with_score << node_board_string << score << '\n';
+                    }
+                    else if (node_mover_has_loss)
+                    {
+                        // The mover's best move is a loss.
+                        const Score score = Score(node_mover == Player::A ? Outcome::B_WINS : Outcome::A_WINS, node_mover_max_loss);
+                        out_nodes_with_score << node_board_string << score << '\n';
+                    }
+                    else
+                    {
+                        throw runtime_error("we should have a win, draw, or loss.");
+                    }
+
+                    break; // Proceed to the next board.
+                }
+            } // While loop for reading edges for the current node (board).
+        } // Visiting a node that has no trivial winner. Determine win/lose/draw state for the node.
+    } // Walk the nodes.
+}
+
+static void make_binary_record(BoardKey key, const Score & score, uint8_t * octets)
+{
+    // Insert the Board's unsigned int value in big-endian order.
+    // We write using big-endian rather than little-endian order because it results in a
+    // file that can be compressed to a significantly smaller size.
+
+    for (unsigned i = 0; i < NUM_BASE256_BOARD_DIGITS; ++i)
+    {
+         octets[NUM_BASE256_BOARD_DIGITS - 1 - i] = key & 255;
+         key >>= 8;
+    }
+
+    if (key != 0)
+    {
+        throw runtime_error("make_binary_record: unable to write board in NUM_BASE256_BOARD_DIGITS bytes.");
+    }
+
+    if (score.outcome == Outcome::INDETERMINATE)
+    {
+        throw runtime_error("make_binary_record: unexpected indeterminate score.");
+    }
+
+    score.store(octets + NUM_BASE256_BOARD_DIGITS);
+}
+
+static void make_binary_file(const string & in_nodes_filename,
+                             const string & out_nodes_filename)
+{
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_nodes_file(out_nodes_filename);
+
+    istream & in_nodes  = in_nodes_file.get_istream_reference();
+    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+    NodeReader nodes_reader(in_nodes);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        uint8_t octets[BINARY_RECORD_SIZE];
+
+        make_binary_record(key, score, octets);
+
+        out_nodes.write(reinterpret_cast<char *>(octets), BINARY_RECORD_SIZE);
+    }
+}
+
+// The occurrences in the summary histogram of a table are indexed by the number of moves, whether the board
+// is symmetric, and the score: its outcome bits times HISTOGRAM_PLIES, plus its ply. For one-octet scores,
+// the score index is simply the score octet, and the index is (moves * 512 + symmetric * 256 + octet).
+constexpr unsigned HISTOGRAM_PLIES  = (NUM_SCORE_OCTETS == 1) ? 64 : MAX_PLY + 1;
+constexpr unsigned HISTOGRAM_SCORES = 4 * HISTOGRAM_PLIES;
+constexpr unsigned HISTOGRAM_SIZE   = (MAX_PLY + 1) * 2 * HISTOGRAM_SCORES;
+
+static unsigned histogram_index(unsigned moves, bool is_symmetric, const Score & score)
+{
+    return (2 * moves + (is_symmetric ? 1 : 0)) * HISTOGRAM_SCORES + (score.to_code() >> SCORE_OUTCOME_SHIFT) * HISTOGRAM_PLIES + score.ply;
+}
+
+static void print_histogram(const vector<uint64_t> & occurrences, ostream & out)
+{
+    // Print the summary histogram of a table, with occurrences indexed by histogram_index().
+
+    for (unsigned index = 0; index < occurrences.size(); ++index)
+    {
+        if (occurrences[index] != 0)
+        {
+            const unsigned score_index = index % HISTOGRAM_SCORES;
+            const Score score = Score::from_code((score_index / HISTOGRAM_PLIES) << SCORE_OUTCOME_SHIFT | (score_index % HISTOGRAM_PLIES));
+            const bool is_symmetric = (index / HISTOGRAM_SCORES) % 2 != 0;
+            out << "moves " << setw(2) << (index / (2 * HISTOGRAM_SCORES)) << " symmetric " << is_symmetric << " outcome " << score.outcome << " ply " << setw(2) << score.ply << " count " << setw(12) << occurrences[index] << endl;
+        }
+    }
+}
+
+static void write_fully(int fd, const uint8_t * data, uint64_t size, uint64_t offset)
+{
+    while (size != 0)
+    {
+        const ssize_t result = pwrite(fd, data, size, offset);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw runtime_error("write_fully: write error.");
+        }
+
+        data   += result;
+        size   -= result;
+        offset += result;
+    }
+}
+
+static void combine(const string & out_nodes_filename,
+                    const string & out_summary_filename,
+                    const vector<string> & in_nodes_filenames)
+{
+    // Merge sorted nodes-with-score files (normally, one per generation) into a binary nodes file,
+    // and write its summary histogram (as produced by --print-info), in a single pass.
+    //
+    // The key space is split into ranges, such that each range holds about the same number of records.
+    // The split keys are chosen from samples of the input files. Since the number of records in each
+    // range is then known exactly, the offset of each range in the output file is known in advance, and
+    // the ranges can be merged by multiple threads independently. Each thread merges the records of a
+    // range from all input files using a loser tree, and writes them to their place in the output file.
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+    const unsigned num_ranges_wanted = 16 * num_threads;
+
+    // Open the input files.
+
+    vector<unique_ptr<SortedNodeFile>> files;
+    uint64_t total_records = 0;
+
+    for (const string & filename: in_nodes_filenames)
+    {
+        files.push_back(make_unique<SortedNodeFile>(filename));
+        total_records += files.back()->num_records();
+    }
+
+    const unsigned num_files = files.size();
+
+    // Choose the split keys, from about 64 samples per range.
+
+    const uint64_t spacing = max(uint64_t(1), total_records / (num_ranges_wanted * 64));
+
+    vector<BoardKey> samples;
+
+    for (const auto & file: files)
+    {
+        const vector<BoardKey> file_samples = file->sample_keys(spacing);
+        samples.insert(samples.end(), file_samples.begin(), file_samples.end());
+    }
+
+    sort(samples.begin(), samples.end());
+
+    vector<BoardKey> split_keys;
+
+    for (unsigned i = 1; i < num_ranges_wanted && !samples.empty(); ++i)
+    {
+        const BoardKey key = samples[static_cast<uint64_t>(i) * samples.size() / num_ranges_wanted];
+
+        if (key != 0 && (split_keys.empty() || key > split_keys.back()))
+        {
+            split_keys.push_back(key);
+        }
+    }
+
+    // Range r holds the keys in [split_keys[r - 1], split_keys[r]), where the first range starts at key 0
+    // and the last range is unbounded. Determine where each range starts in each of the input files.
+
+    const unsigned num_ranges = split_keys.size() + 1;
+
+    vector<vector<SortedNodeFile::Position>> positions(num_files, vector<SortedNodeFile::Position>(num_ranges + 1));
+
+    for (unsigned f = 0; f < num_files; ++f)
+    {
+        positions[f][0] = files[f]->lower_bound(0);
+
+        for (unsigned r = 1; r < num_ranges; ++r)
+        {
+            positions[f][r] = files[f]->lower_bound(split_keys[r - 1]);
+        }
+
+        positions[f][num_ranges] = SortedNodeFile::Position{0, 0, files[f]->num_records()};
+    }
+
+    vector<uint64_t> range_offsets(num_ranges + 1, 0);
+
+    for (unsigned r = 0; r < num_ranges; ++r)
+    {
+        uint64_t range_records = 0;
+
+        for (unsigned f = 0; f < num_files; ++f)
+        {
+            range_records += positions[f][r + 1].rank - positions[f][r].rank;
+        }
+
+        range_offsets[r + 1] = range_offsets[r] + range_records;
+    }
+
+    // Make the output file, at its final size.
+
+    const unsigned record_size = BINARY_RECORD_SIZE;
+
+    const int fd = open(out_nodes_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+    {
+        throw runtime_error("combine: unable to create output file.");
+    }
+
+    if (ftruncate(fd, total_records * record_size) != 0)
+    {
+        close(fd);
+        throw runtime_error("combine: unable to size output file.");
+    }
+
+    // Merge the ranges in parallel. Each thread collects its own histogram.
+
+    const unsigned histogram_size = HISTOGRAM_SIZE;
+
+    vector<vector<uint64_t>> histograms(num_threads, vector<uint64_t>(histogram_size, 0));
+
+    atomic<unsigned> next_range(0);
+
+    mutex         error_mutex;
+    exception_ptr error;
+
+    auto worker = [&](unsigned thread_index)
+    {
+        vector<uint64_t> & occurrences = histograms[thread_index];
+
+        vector<uint8_t> buffer;
+        buffer.reserve(1 << 20);
+
+        try
+        {
+            unsigned r;
+            while ((r = next_range++) < num_ranges)
+            {
+                vector<unique_ptr<NodeRangeReader>> readers;
+                vector<BoardKey> first_keys;
+                vector<bool>     first_valid;
+                vector<Score>    scores;
+
+                for (unsigned f = 0; f < num_files; ++f)
+                {
+                    readers.push_back(make_unique<NodeRangeReader>(*files[f], positions[f][r], positions[f][r + 1].rank - positions[f][r].rank));
+
+                    BoardKey key = 0;
+                    Score    score;
+                    const bool valid = readers[f]->read(key, score);
+
+                    first_keys.push_back(key);
+                    first_valid.push_back(valid);
+                    scores.push_back(score);
+                }
+
+                LoserTree tree(first_keys, first_valid);
+
+                uint64_t offset = range_offsets[r] * record_size;
+
+                bool     have_previous_key = false;
+                BoardKey previous_key = 0;
+
+                while (!tree.empty())
+                {
+                    const unsigned f   = tree.winner();
+                    const BoardKey key = tree.winner_key();
+
+                    if (have_previous_key && key <= previous_key)
+                    {
+                        throw runtime_error("combine: input files are not sorted, or hold duplicate boards.");
+                    }
+
+                    have_previous_key = true;
+                    previous_key = key;
+
+                    uint8_t octets[BINARY_RECORD_SIZE];
+
+                    make_binary_record(key, scores[f], octets);
+
+                    buffer.insert(buffer.end(), octets, octets + record_size);
+
+                    const Board board = Board::from_key(key);
+                    ++occurrences[histogram_index(board.count(), board.is_symmetric(), scores[f])];
+
+                    if (buffer.size() + record_size > buffer.capacity())
+                    {
+                        write_fully(fd, buffer.data(), buffer.size(), offset);
+                        offset += buffer.size();
+                        buffer.clear();
+                    }
+
+                    BoardKey next_key = 0;
+                    const bool next_valid = readers[f]->read(next_key, scores[f]);
+
+                    tree.replace_winner(next_valid, next_key);
+                }
+
+                write_fully(fd, buffer.data(), buffer.size(), offset);
+                buffer.clear();
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(error_mutex);
+            error = current_exception();
+            next_range = num_ranges;
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker, i);
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    if (close(fd) != 0 && !error)
+    {
+        throw runtime_error("combine: error while closing output file.");
+    }
+
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+
+    // Combine the histograms of the threads, and write the summary.
+
+    vector<uint64_t> occurrences(histogram_size, 0);
+
+    for (const vector<uint64_t> & histogram: histograms)
+    {
+        for (unsigned index = 0; index < histogram_size; ++index)
+        {
+            occurrences[index] += histogram[index];
+        }
+    }
+
+    const OutputFile out_summary_file(out_summary_filename);
+
+    print_histogram(occurrences, out_summary_file.get_ostream_reference());
+}
+
+static void solve_in_memory(const string & out_nodes_filename,
+                            const string & out_summary_filename,
+                            const bool     wdl_only)
+{
+    // Solve the game entirely in memory, and write the binary nodes file and its summary histogram
+    // (as produced by --print-info). The number of boards of each generation is written to stdout,
+    // in the same format as the log file made by connect4-script.
+    //
+    // Each generation is held as a sorted array of normalized board keys, so the rank of a board in
+    // its generation (found by binary search) is a dense index into an array of one ScoreCode per
+    // board. The forward pass expands each generation into the next; the backward (retrograde) pass
+    // scores each generation from the scores of the next. Both passes split each generation over
+    // multiple threads. Finally, the generations are merged by key into the binary nodes file.
+    //
+    // This is only feasible for boards for which all keys and scores fit in memory.
+
+    constexpr unsigned NUM_GENERATIONS = H_SIZE * V_SIZE + 1;
+
+    vector<vector<BoardKey>> keys(NUM_GENERATIONS);
+    vector<vector<ScoreCode>> scores(NUM_GENERATIONS);
+
+    // Forward pass.
+
+    keys[0].push_back(Board::make_empty().normalize().to_key());
+
+    for (unsigned generation = 0; generation + 1 < NUM_GENERATIONS; ++generation)
+    {
+        const vector<BoardKey> & current = keys[generation];
+
+        vector<vector<BoardKey>> thread_keys(max(1u, thread::hardware_concurrency()));
+
+        run_in_parallel(current.size(), [&](unsigned t, uint64_t begin, uint64_t end)
+        {
+            vector<BoardKey> & next = thread_keys[t];
+
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                for (const Board & board: Board::from_key(current[i]).generate_unique_normalized_boards())
+                {
+                    next.push_back(board.to_key());
+                }
+            }
+
+            sort(next.begin(), next.end());
+            next.erase(unique(next.begin(), next.end()), next.end());
+        });
+
+        vector<BoardKey> & next = keys[generation + 1];
+
+        for (vector<BoardKey> & part: thread_keys)
+        {
+            next.insert(next.end(), part.begin(), part.end());
+            vector<BoardKey>().swap(part);
+        }
+
+        sort(next.begin(), next.end());
+        next.erase(unique(next.begin(), next.end()), next.end());
+    }
+
+    for (const vector<BoardKey> & generation_keys: keys)
+    {
+        cout << generation_keys.size() << endl;
+    }
+
+    // Backward pass.
+
+    for (unsigned generation = NUM_GENERATIONS; generation-- > 0;)
+    {
+        const vector<BoardKey> & current = keys[generation];
+
+        scores[generation].resize(current.size());
+
+        run_in_parallel(current.size(), [&](unsigned, uint64_t begin, uint64_t end)
+        {
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                const Board board = Board::from_key(current[i]);
+
+                Score score(board.trivial_outcome(), 0);
+
+                if (score.outcome == Outcome::INDETERMINATE)
+                {
+                    const vector<BoardKey> & next        = keys[generation + 1];
+                    const vector<ScoreCode> & next_scores = scores[generation + 1];
+
+                    vector<MoveScore> moves;
+
+                    for (int x = 0; x < H_SIZE; ++x)
+                    {
+                        if (board.can_play(x))
+                        {
+                            const BoardKey child_key = board.play(x).normalize().to_key();
+                            const uint64_t rank = lower_bound(next.begin(), next.end(), child_key) - next.begin();
+
+                            if (rank == next.size() || next[rank] != child_key)
+                            {
+                                throw runtime_error("solve_in_memory: child board not found.");
+                            }
+
+                            moves.push_back(MoveScore{x, Score::from_code(next_scores[rank])});
+                        }
+                    }
+
+                    select_optimal_moves(board.mover(), moves, score);
+
+                    if (wdl_only)
+                    {
+                        score.ply = 0;
+                    }
+                }
+
+                scores[generation][i] = score.to_code();
+            }
+        });
+    }
+
+    // Merge the generations by key into the binary nodes file, and gather the summary histogram.
+
+    const OutputFile out_nodes_file(out_nodes_filename);
+    const OutputFile out_summary_file(out_summary_filename);
+
+    ostream & out_nodes   = out_nodes_file.get_ostream_reference();
+    ostream & out_summary = out_summary_file.get_ostream_reference();
+
+    vector<BoardKey> first_keys(NUM_GENERATIONS);
+    vector<bool>     first_valid(NUM_GENERATIONS);
+    vector<uint64_t> next_index(NUM_GENERATIONS, 0);
+
+    for (unsigned generation = 0; generation < NUM_GENERATIONS; ++generation)
+    {
+        first_valid[generation] = !keys[generation].empty();
+        first_keys[generation]  = first_valid[generation] ? keys[generation][0] : 0;
+    }
+
+    LoserTree tree(first_keys, first_valid);
+
+    vector<uint64_t> occurrences(HISTOGRAM_SIZE);
+
+    vector<uint8_t> buffer;
+
+    while (!tree.empty())
+    {
+        const unsigned generation = tree.winner();
+        const BoardKey key        = tree.winner_key();
+        const uint64_t index      = next_index[generation]++;
+        const Score    score      = Score::from_code(scores[generation][index]);
+
+        uint8_t octets[BINARY_RECORD_SIZE];
+        make_binary_record(key, score, octets);
+        buffer.insert(buffer.end(), octets, octets + BINARY_RECORD_SIZE);
+
+        if (buffer.size() >= (1 << 20))
+        {
+            out_nodes.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+            buffer.clear();
+        }
+
+        ++occurrences[histogram_index(generation, Board::from_key(key).is_symmetric(), score)];
+
+        const bool next_valid = (index + 1 < keys[generation].size());
+        tree.replace_winner(next_valid, next_valid ? keys[generation][index + 1] : 0);
+    }
+
+    out_nodes.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+    if (!out_nodes)
+    {
+        throw runtime_error("solve_in_memory: error while writing binary nodes file.");
+    }
+
+    print_histogram(occurrences, out_summary);
+}
+
+static void make_partitioned_db(const string & out_db_filename,
+                                const vector<string> & in_nodes_filenames)
+{
+    // Make a partitioned database (see partitioned_db.h) from the nodes-with-score files of consecutive
+    // generations, starting at generation 0. Each input file becomes a section; since the files are
+    // already sorted, this is a simple concatenation. Sections of generations beyond the last input
+    // file are left empty.
+
+    if (in_nodes_filenames.size() > PARTITIONED_DB_NUM_SECTIONS)
+    {
+        throw runtime_error("make_partitioned_db: too many input files.");
+    }
+
+    const OutputFile out_db_file(out_db_filename);
+
+    ostream & out_db = out_db_file.get_ostream_reference();
+
+    // Write a provisional header; the section table is filled in at the end.
+
+    vector<uint8_t> header(PARTITIONED_DB_HEADER_SIZE);
+    out_db.write(reinterpret_cast<const char *>(header.data()), header.size());
+
+    vector<PartitionedDbSection> sections(PARTITIONED_DB_NUM_SECTIONS);
+
+    uint64_t offset = PARTITIONED_DB_HEADER_SIZE;
+
+    for (unsigned generation = 0; generation < PARTITIONED_DB_NUM_SECTIONS; ++generation)
+    {
+        PartitionedDbSection & section = sections[generation];
+
+        section.offset   = offset;
+        section.count    = 0;
+        section.checksum = FNV1A_64_INITIAL_STATE;
+
+        if (generation < in_nodes_filenames.size())
+        {
+            const InputFile in_nodes_file(in_nodes_filenames[generation]);
+
+            istream & in_nodes = in_nodes_file.get_istream_reference();
+
+            NodeReader nodes_reader(in_nodes);
+
+            BoardKey key;
+            Score    score;
+            BoardKey previous_key = 0;
+
+            while (nodes_reader.read(key, score))
+            {
+                if (section.count != 0 && key <= previous_key)
+                {
+                    throw runtime_error("make_partitioned_db: input file is not sorted.");
+                }
+
+                if (section.count == 0 && Board::from_key(key).count() != generation)
+                {
+                    throw runtime_error("make_partitioned_db: input file holds boards of the wrong generation.");
+                }
+
+                uint8_t octets[BINARY_RECORD_SIZE];
+
+                make_binary_record(key, score, octets);
+
+                out_db.write(reinterpret_cast<char *>(octets), BINARY_RECORD_SIZE);
+
+                section.checksum = fnv1a_64(octets, BINARY_RECORD_SIZE, section.checksum);
+                ++section.count;
+                previous_key = key;
+            }
+        }
+
+        offset += section.count * (BINARY_RECORD_SIZE);
+    }
+
+    encode_partitioned_db_header(sections, header.data());
+
+    if (out_db.seekp(0))
+    {
+        out_db.write(reinterpret_cast<const char *>(header.data()), header.size());
+    }
+    else
+    {
+        throw runtime_error("make_partitioned_db: the output file must be seekable.");
+    }
+}
+
+static void make_even_db(const string & in_table_filename,
+                         const string & out_db_filename,
+                         const string & parity_name)
+{
+    // Make a partitioned database that holds only the generations of one parity (see partitioned_db.h), from a
+    // full table: a binary nodes file or a partitioned database. The boards of the other generations are
+    // resolved from their children when looked up, so the database takes about half the space of the table.
+    //
+    // The records are first counted per generation, in parallel, to lay out the sections. Since the records of
+    // each generation are in key order in the table, a single pass then writes them to their sections.
+
+    PartitionedDbGenerations generations;
+
+    if (parity_name == "even")
+    {
+        generations = PARTITIONED_DB_EVEN_GENERATIONS;
+    }
+    else if (parity_name == "odd")
+    {
+        generations = PARTITIONED_DB_ODD_GENERATIONS;
+    }
+    else
+    {
+        throw runtime_error("make_even_db: unknown parity.");
+    }
+
+    const LookupTable table(in_table_filename);
+
+    if (table.held_generations() != PARTITIONED_DB_ALL_GENERATIONS)
+    {
+        throw runtime_error("make_even_db: the input table does not hold all generations.");
+    }
+
+    const uint64_t num_records = table.num_records();
+
+    vector<vector<uint64_t>> thread_counts(max(1u, thread::hardware_concurrency()), vector<uint64_t>(PARTITIONED_DB_NUM_SECTIONS, 0));
+
+    run_in_parallel(num_records, [&](unsigned t, uint64_t begin, uint64_t end)
+    {
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            ++thread_counts[t][Board::from_key(table.key_at(i)).count()];
+        }
+    });
+
+    vector<PartitionedDbSection> sections(PARTITIONED_DB_NUM_SECTIONS);
+
+    uint64_t offset = PARTITIONED_DB_HEADER_SIZE;
+
+    for (unsigned generation = 0; generation < PARTITIONED_DB_NUM_SECTIONS; ++generation)
+    {
+        PartitionedDbSection & section = sections[generation];
+
+        section.offset   = offset;
+        section.count    = 0;
+        section.checksum = FNV1A_64_INITIAL_STATE;
+
+        if (partitioned_db_holds_generation(generations, generation))
+        {
+            for (const vector<uint64_t> & counts: thread_counts)
+            {
+                section.count += counts[generation];
+            }
+        }
+
+        offset += section.count * BINARY_RECORD_SIZE;
+    }
+
+    const int fd = open(out_db_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+    {
+        throw runtime_error("make_even_db: unable to create output file.");
+    }
+
+    try
+    {
+        if (ftruncate(fd, offset) != 0)
+        {
+            throw runtime_error("make_even_db: unable to size output file.");
+        }
+
+        // Each section is written through its own buffer.
+
+        vector<vector<uint8_t>> buffers(PARTITIONED_DB_NUM_SECTIONS);
+        vector<uint64_t>        write_offsets(PARTITIONED_DB_NUM_SECTIONS);
+
+        for (unsigned generation = 0; generation < PARTITIONED_DB_NUM_SECTIONS; ++generation)
+        {
+            write_offsets[generation] = sections[generation].offset;
+        }
+
+        auto flush = [&](unsigned generation)
+        {
+            vector<uint8_t> & buffer = buffers[generation];
+            sections[generation].checksum = fnv1a_64(buffer.data(), buffer.size(), sections[generation].checksum);
+            write_fully(fd, buffer.data(), buffer.size(), write_offsets[generation]);
+            write_offsets[generation] += buffer.size();
+            buffer.clear();
+        };
+
+        for (uint64_t i = 0; i < num_records; ++i)
+        {
+            const BoardKey key = table.key_at(i);
+            const unsigned generation = Board::from_key(key).count();
+
+            if (partitioned_db_holds_generation(generations, generation))
+            {
+                uint8_t octets[BINARY_RECORD_SIZE];
+
+                make_binary_record(key, table.score_at(i), octets);
+
+                vector<uint8_t> & buffer = buffers[generation];
+
+                buffer.insert(buffer.end(), octets, octets + BINARY_RECORD_SIZE);
+
+                if (buffer.size() >= (1 << 16))
+                {
+                    flush(generation);
+                }
+            }
+        }
+
+        for (unsigned generation = 0; generation < PARTITIONED_DB_NUM_SECTIONS; ++generation)
+        {
+            flush(generation);
+        }
+
+        vector<uint8_t> header(PARTITIONED_DB_HEADER_SIZE);
+
+        encode_partitioned_db_header(sections, header.data(), generations);
+
+        write_fully(fd, header.data(), header.size(), 0);
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    if (close(fd) != 0)
+    {
+        throw runtime_error("make_even_db: error while closing output file.");
+    }
+
+    cout << "records " << num_records << " kept " << (offset - PARTITIONED_DB_HEADER_SIZE) / BINARY_RECORD_SIZE << " bytes " << offset << endl;
+}
+
+static void make_profile_nodes(const string & in_nodes_filename,
+                               const string & out_profile_nodes_filename)
+{
+    // Convert a node file holding the boards of a single generation (in any order, possibly with duplicates) into
+    // a height-profile file (see height_profile.h). All boards are held in memory; this is meant for generations
+    // that are small, such as the initial one.
+
+    const HeightProfiler profiler;
+
+    struct Record {
+        uint64_t  profile;
+        BoardKey  key;
+        ScoreCode score;
+    };
+
+    vector<Record> records;
+
+    {
+        const InputFile in_nodes_file(in_nodes_filename);
+
+        NodeReader nodes_reader(in_nodes_file.get_istream_reference());
+
+        BoardKey key;
+        Score    score;
+
+        while (nodes_reader.read(key, score))
+        {
+            records.push_back(Record{profiler.normalized_profile(key), key, score.to_code()});
+        }
+    }
+
+    sort(records.begin(), records.end(), [](const Record & r1, const Record & r2) { return r1.profile < r2.profile || (r1.profile == r2.profile && r1.key < r2.key); });
+    records.erase(unique(records.begin(), records.end(), [](const Record & r1, const Record & r2) { return r1.key == r2.key; }), records.end());
+
+    const unsigned generation = records.empty() ? 0 : Board::from_key(records[0].key).count();
+
+    vector<HeightProfileBucket> buckets;
+
+    for (const Record & record: records)
+    {
+        if (Board::from_key(record.key).count() != generation)
+        {
+            throw runtime_error("make_profile_nodes: the boards are not all of the same generation.");
+        }
+
+        if (buckets.empty() || buckets.back().profile != record.profile)
+        {
+            buckets.push_back(HeightProfileBucket{record.profile, 0, 0, 0});
+        }
+
+        ++buckets.back().count;
+    }
+
+    vector<uint8_t> data;
+
+    uint64_t offset = height_profile_file_header_size(buckets.size());
+    uint64_t first  = 0;
+
+    for (HeightProfileBucket & bucket: buckets)
+    {
+        vector<BoardKey>  keys;
+        vector<ScoreCode> scores;
+
+        for (uint64_t i = first; i < first + bucket.count; ++i)
+        {
+            keys.push_back(records[i].key);
+            scores.push_back(records[i].score);
+        }
+
+        vector<uint8_t> bucket_data;
+
+        bucket.offset   = offset;
+        bucket.checksum = encode_height_profile_records(keys, scores, bucket_data);
+
+        data.insert(data.end(), bucket_data.begin(), bucket_data.end());
+
+        offset += bucket.count * BINARY_RECORD_SIZE;
+        first  += bucket.count;
+    }
+
+    ofstream out_file(out_profile_nodes_filename, ios::binary);
+
+    const vector<uint8_t> header = encode_height_profile_file_header(generation, buckets);
+
+    out_file.write(reinterpret_cast<const char *>(header.data()), header.size());
+    out_file.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+    if (!out_file)
+    {
+        throw runtime_error("make_profile_nodes: error while writing output file.");
+    }
+}
+
+static void make_nodes_by_profile(const string & in_profile_nodes_filename,
+                                  const string & out_profile_nodes_filename)
+{
+    // Given a height-profile file of the boards of a generation (see height_profile.h), write the height-profile file
+    // of the next generation: the unique boards that can be reached by making a single move. The number of boards is
+    // written to stdout, in the same format as the log file made by connect4-script.
+    //
+    // Rather than sorting all generated boards, the next generation is made one bucket at a time. The boards of a
+    // bucket can only be reached from the boards in the at most H_SIZE parent buckets; these are read, the moves that
+    // lead to the bucket's profile are played, and the results are sorted and de-duplicated in memory. Buckets are
+    // processed by multiple threads in parallel, and written in order of profile.
+
+    const HeightProfileFile in_file(in_profile_nodes_filename);
+
+    const unsigned generation = in_file.get_generation();
+
+    if (generation >= H_SIZE * V_SIZE)
+    {
+        throw runtime_error("make_nodes_by_profile: the input is the last generation.");
+    }
+
+    set<uint64_t> profile_set;
+
+    for (const HeightProfileBucket & bucket: in_file.get_buckets())
+    {
+        for (const uint64_t profile: child_height_profiles(bucket.profile))
+        {
+            profile_set.insert(profile);
+        }
+    }
+
+    const vector<uint64_t> profiles(profile_set.begin(), profile_set.end());
+
+    const unsigned num_buckets = profiles.size();
+
+    const HeightProfiler profiler;
+
+    const int fd = open(out_profile_nodes_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+    {
+        throw runtime_error("make_nodes_by_profile: unable to create output file.");
+    }
+
+    // Worker threads claim buckets in order. To bound memory usage, a worker will not claim a new bucket while there
+    // are already 'max_pending' buckets processed or being processed that have not yet been written.
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+    const unsigned max_pending = 2 * num_threads;
+
+    vector<HeightProfileBucket> buckets(num_buckets);
+    vector<vector<uint8_t>>     bucket_data(num_buckets);
+    vector<bool>                bucket_done(num_buckets, false);
+
+    unsigned next_bucket    = 0; // The next bucket to be claimed by a worker thread.
+    unsigned written_bucket = 0; // The next bucket to be written to the output.
+    bool     worker_failed  = false;
+
+    mutex              state_mutex;
+    condition_variable state_changed;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            unsigned b;
+
+            {
+                unique_lock<mutex> lock(state_mutex);
+                state_changed.wait(lock, [&]{ return worker_failed || next_bucket == num_buckets || next_bucket < written_bucket + max_pending; });
+                if (worker_failed || next_bucket == num_buckets)
+                {
+                    return;
+                }
+                b = next_bucket++;
+            }
+
+            try
+            {
+                const uint64_t profile = profiles[b];
+
+                vector<pair<BoardKey, ScoreCode>> children;
+
+                vector<BoardKey>  parent_keys;
+                vector<ScoreCode> parent_scores;
+
+                for (const uint64_t parent_profile: parent_height_profiles(profile))
+                {
+                    const HeightProfileBucket * parent_bucket = in_file.find(parent_profile);
+
+                    if (parent_bucket == nullptr)
+                    {
+                        continue;
+                    }
+
+                    in_file.read_bucket(*parent_bucket, parent_keys, parent_scores);
+
+                    for (const BoardKey parent_key: parent_keys)
+                    {
+                        const Board board = Board::from_key(parent_key);
+
+                        if (board.trivial_outcome() != Outcome::INDETERMINATE)
+                        {
+                            continue;
+                        }
+
+                        unsigned heights[H_SIZE];
+                        profiler.heights(parent_key, heights);
+
+                        for (int x = 0; x < H_SIZE; ++x)
+                        {
+                            if (heights[x] < V_SIZE)
+                            {
+                                ++heights[x];
+                                if (normalized_height_profile(heights) == profile)
+                                {
+                                    const Board child = board.play(x).normalize();
+                                    children.emplace_back(child.to_key(), Score(child.trivial_outcome(), 0).to_code());
+                                }
+                                --heights[x];
+                            }
+                        }
+                    }
+                }
+
+                sort(children.begin(), children.end());
+                children.erase(unique(children.begin(), children.end()), children.end());
+
+                vector<BoardKey>  keys(children.size());
+                vector<ScoreCode> scores(children.size());
+
+                for (size_t i = 0; i < children.size(); ++i)
+                {
+                    keys[i]   = children[i].first;
+                    scores[i] = children[i].second;
+                }
+
+                vector<uint8_t> data;
+
+                const uint64_t checksum = encode_height_profile_records(keys, scores, data);
+
+                lock_guard<mutex> lock(state_mutex);
+                buckets[b] = HeightProfileBucket{profile, 0, keys.size(), checksum};
+                bucket_data[b].swap(data);
+                bucket_done[b] = true;
+                state_changed.notify_all();
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(state_mutex);
+                worker_failed = true;
+                state_changed.notify_all();
+                return;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    // The header size is known in advance, so the buckets can be written in order directly after it.
+
+    uint64_t offset = height_profile_file_header_size(num_buckets);
+    uint64_t num_records = 0;
+    bool     write_failed = false;
+
+    {
+        unique_lock<mutex> lock(state_mutex);
+        while (written_bucket < num_buckets)
+        {
+            state_changed.wait(lock, [&]{ return worker_failed || bucket_done[written_bucket]; });
+            if (worker_failed)
+            {
+                break;
+            }
+
+            // Write the bucket without holding the lock, so workers can continue.
+            vector<uint8_t> data;
+            data.swap(bucket_data[written_bucket]);
+            buckets[written_bucket].offset = offset;
+            lock.unlock();
+
+            try
+            {
+                write_fully(fd, data.data(), data.size(), offset);
+            }
+            catch (...)
+            {
+                write_failed = true;
+            }
+
+            offset      += data.size();
+            num_records += buckets[written_bucket].count;
+
+            lock.lock();
+
+            if (write_failed)
+            {
+                worker_failed = true;
+                state_changed.notify_all();
+                break;
+            }
+
+            ++written_bucket;
+            state_changed.notify_all();
+        }
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    if (worker_failed)
+    {
+        close(fd);
+        throw runtime_error("make_nodes_by_profile: failed to process a bucket.");
+    }
+
+    // Buckets that turned out to be empty (e.g., because all boards in their parent buckets are terminal)
+    // are kept in the header, with no records.
+
+    const vector<uint8_t> header = encode_height_profile_file_header(generation + 1, buckets);
+
+    try
+    {
+        write_fully(fd, header.data(), header.size(), 0);
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    if (close(fd) != 0)
+    {
+        throw runtime_error("make_nodes_by_profile: error while closing output file.");
+    }
+
+    cout << num_records << endl;
+}
+
+static void make_nodes_with_score_by_profile(const string & in_profile_nodes_filename,
+                                             const string & in_next_profile_nodes_with_score_filename,
+                                             const string & out_profile_nodes_with_score_filename,
+                                             const bool     wdl_only)
+{
+    // Given the height-profile files of the boards of generation n, and of the scored boards of generation (n+1),
+    // write the height-profile file of the scored boards of generation n.
+    //
+    // Each bucket is scored on its own: the children of its boards are all in the at most H_SIZE child buckets of
+    // generation (n+1), which are read into memory, and each child is found by binary search, as in --solve-in-memory.
+    // The output has the same buckets as the input, so each bucket can be written to its place as soon as it is done;
+    // buckets are processed by multiple threads in parallel, without any global sort.
+
+    const HeightProfileFile in_file(in_profile_nodes_filename);
+    const HeightProfileFile next_file(in_next_profile_nodes_with_score_filename);
+
+    const unsigned generation = in_file.get_generation();
+
+    if (next_file.get_generation() != generation + 1)
+    {
+        throw runtime_error("make_nodes_with_score_by_profile: the scored boards are not of the next generation.");
+    }
+
+    vector<HeightProfileBucket> buckets = in_file.get_buckets();
+
+    const uint64_t file_size = height_profile_file_header_size(buckets.size()) + in_file.num_records() * BINARY_RECORD_SIZE;
+
+    const HeightProfiler profiler;
+
+    const int fd = open(out_profile_nodes_with_score_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+    {
+        throw runtime_error("make_nodes_with_score_by_profile: unable to create output file.");
+    }
+
+    try
+    {
+        if (ftruncate(fd, file_size) != 0)
+        {
+            throw runtime_error("make_nodes_with_score_by_profile: unable to size output file.");
+        }
+
+        atomic<uint64_t> next_bucket(0);
+
+        run_in_parallel(max(1u, thread::hardware_concurrency()), [&](unsigned, uint64_t, uint64_t)
+        {
+            struct ChildBucket {
+                uint64_t          profile;
+                vector<BoardKey>  keys;
+                vector<ScoreCode> scores;
+            };
+
+            uint64_t b;
+            while ((b = next_bucket++) < buckets.size())
+            {
+                HeightProfileBucket & bucket = buckets[b];
+
+                vector<BoardKey>  keys;
+                vector<ScoreCode> scores;
+
+                in_file.read_bucket(bucket, keys, scores);
+
+                vector<ChildBucket> child_buckets;
+
+                for (const uint64_t child_profile: child_height_profiles(bucket.profile))
+                {
+                    const HeightProfileBucket * next_bucket_entry = next_file.find(child_profile);
+
+                    if (next_bucket_entry != nullptr)
+                    {
+                        child_buckets.push_back(ChildBucket{child_profile, {}, {}});
+                        next_file.read_bucket(*next_bucket_entry, child_buckets.back().keys, child_buckets.back().scores);
+                    }
+                }
+
+                for (uint64_t i = 0; i < keys.size(); ++i)
+                {
+                    Score score = Score::from_code(scores[i]);
+
+                    if (score.outcome != Outcome::INDETERMINATE)
+                    {
+                        // The board has a trivial outcome; it has no children.
+                        continue;
+                    }
+
+                    const Board board = Board::from_key(keys[i]);
+
+                    unsigned heights[H_SIZE];
+                    profiler.heights(keys[i], heights);
+
+                    vector<MoveScore> moves;
+
+                    for (int x = 0; x < H_SIZE; ++x)
+                    {
+                        if (heights[x] < V_SIZE)
+                        {
+                            ++heights[x];
+                            const uint64_t child_profile = normalized_height_profile(heights);
+                            --heights[x];
+
+                            const BoardKey child_key = board.play(x).normalize().to_key();
+
+                            const auto child_bucket = find_if(child_buckets.begin(), child_buckets.end(), [&](const ChildBucket & c) { return c.profile == child_profile; });
+
+                            if (child_bucket == child_buckets.end())
+                            {
+                                throw runtime_error("make_nodes_with_score_by_profile: child bucket not found.");
+                            }
+
+                            const uint64_t rank = lower_bound(child_bucket->keys.begin(), child_bucket->keys.end(), child_key) - child_bucket->keys.begin();
+
+                            if (rank == child_bucket->keys.size() || child_bucket->keys[rank] != child_key)
+                            {
+                                throw runtime_error("make_nodes_with_score_by_profile: child board not found.");
+                            }
+
+                            moves.push_back(MoveScore{x, Score::from_code(child_bucket->scores[rank])});
+                        }
+                    }
+
+                    select_optimal_moves(board.mover(), moves, score);
+
+                    if (wdl_only)
+                    {
+                        score.ply = 0;
+                    }
+
+                    scores[i] = score.to_code();
+                }
+
+                vector<uint8_t> data;
+
+                bucket.checksum = encode_height_profile_records(keys, scores, data);
+
+                write_fully(fd, data.data(), data.size(), bucket.offset);
+            }
+        });
+
+        const vector<uint8_t> header = encode_height_profile_file_header(generation, buckets);
+
+        write_fully(fd, header.data(), header.size(), 0);
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    if (close(fd) != 0)
+    {
+        throw runtime_error("make_nodes_with_score_by_profile: error while closing output file.");
+    }
+}
+
+static void profile_nodes_to_nodes(const string & in_profile_nodes_filename,
+                                   const string & out_nodes_filename)
+{
+    // Convert a height-profile file into a text node file, sorted by key, as made by the other forward and backward
+    // modes. Since each bucket is sorted, this merges the buckets, reading each one in chunks.
+
+    const HeightProfileFile in_file(in_profile_nodes_filename);
+
+    const OutputFile out_nodes_file(out_nodes_filename);
+
+    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+    const vector<HeightProfileBucket> & buckets = in_file.get_buckets();
+
+    if (buckets.empty())
+    {
+        return;
+    }
+
+    // Read the buckets in chunks, such that all chunks together take about 16 MiB.
+    const uint64_t chunk_records = max<uint64_t>(64, (uint64_t(16) << 20) / BINARY_RECORD_SIZE / buckets.size());
+
+    vector<vector<BoardKey>>  chunk_keys(buckets.size());
+    vector<vector<ScoreCode>> chunk_scores(buckets.size());
+    vector<uint64_t>          chunk_first(buckets.size(), 0); // The index in the bucket of the first record of the chunk.
+    vector<uint64_t>          chunk_index(buckets.size(), 0); // The index in the chunk of the current record.
+
+    vector<BoardKey> first_keys(buckets.size());
+    vector<bool>     first_valid(buckets.size());
+
+    for (size_t b = 0; b < buckets.size(); ++b)
+    {
+        in_file.read_bucket(buckets[b], chunk_keys[b], chunk_scores[b], 0, chunk_records);
+        first_valid[b] = !chunk_keys[b].empty();
+        first_keys[b]  = first_valid[b] ? chunk_keys[b][0] : 0;
+    }
+
+    LoserTree tree(first_keys, first_valid);
+
+    while (!tree.empty())
+    {
+        const unsigned b = tree.winner();
+
+        out_nodes << key_to_base62_string(tree.winner_key(), NUM_BASE62_BOARD_DIGITS) << Score::from_code(chunk_scores[b][chunk_index[b]]) << '\n';
+
+        if (++chunk_index[b] == chunk_keys[b].size())
+        {
+            chunk_first[b] += chunk_keys[b].size();
+            chunk_index[b] = 0;
+            in_file.read_bucket(buckets[b], chunk_keys[b], chunk_scores[b], chunk_first[b], chunk_records);
+        }
+
+        const bool next_valid = (chunk_index[b] < chunk_keys[b].size());
+        tree.replace_winner(next_valid, next_valid ? chunk_keys[b][chunk_index[b]] : 0);
+    }
+
+    if (!out_nodes)
+    {
+        throw runtime_error("profile_nodes_to_nodes: error while writing output file.");
+    }
+}
+
+static void compress_table(const string & in_nodes_filename,
+                           const string & out_compressed_filename,
+                           const unsigned preset)
+{
+    // Compress a binary nodes file into a compressed table (see compressed_table.h).
+    //
+    // The main thread reads the input one block at a time, and writes the compressed blocks in order;
+    // the blocks are compressed by worker threads in between. At most 'max_pending' blocks are held
+    // in memory at any time.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_compressed_file(out_compressed_filename);
+
+    istream & in_nodes       = in_nodes_file.get_istream_reference();
+    ostream & out_compressed = out_compressed_file.get_ostream_reference();
+
+    constexpr unsigned RECORD_SIZE = BINARY_RECORD_SIZE;
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+    const unsigned max_pending = 2 * num_threads;
+
+    struct Slot {
+        vector<uint8_t> records;
+        vector<uint8_t> compressed;
+        CompressedBlock block;
+        bool            done;
+    };
+
+    vector<Slot> slots(max_pending);
+
+    mutex              state_mutex;
+    condition_variable state_changed;
+
+    uint64_t next_read       = 0; // The number of blocks read.
+    uint64_t next_compressed = 0; // The number of blocks taken up by a worker.
+    uint64_t written         = 0; // The number of blocks written.
+    bool     end_of_input    = false;
+    bool     worker_failed   = false;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            uint64_t block_number;
+            vector<uint8_t> records;
+
+            {
+                unique_lock<mutex> lock(state_mutex);
+                state_changed.wait(lock, [&]{ return worker_failed || end_of_input || next_compressed < next_read; });
+                if (worker_failed || next_compressed == next_read)
+                {
+                    return;
+                }
+                block_number = next_compressed++;
+                records.swap(slots[block_number % max_pending].records);
+            }
+
+            try
+            {
+                vector<uint8_t> compressed;
+
+                const CompressedBlock block = compress_block(records.data(), records.size() / RECORD_SIZE, preset, compressed);
+
+                lock_guard<mutex> lock(state_mutex);
+                Slot & slot = slots[block_number % max_pending];
+                slot.compressed.swap(compressed);
+                slot.block = block;
+                slot.done = true;
+                state_changed.notify_all();
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(state_mutex);
+                worker_failed = true;
+                state_changed.notify_all();
+                return;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    uint8_t header[COMPRESSED_TABLE_HEADER_SIZE];
+    encode_compressed_table_header(COMPRESSED_TABLE_BLOCK_RECORDS, preset, header);
+    out_compressed.write(reinterpret_cast<const char *>(header), COMPRESSED_TABLE_HEADER_SIZE);
+
+    uint64_t offset = COMPRESSED_TABLE_HEADER_SIZE;
+
+    vector<CompressedBlock> blocks;
+
+    bool bad_input = false;
+
+    {
+        unique_lock<mutex> lock(state_mutex);
+
+        while (!worker_failed)
+        {
+            if (!end_of_input && next_read < written + max_pending)
+            {
+                // Read the next block without holding the lock, so workers can continue.
+                lock.unlock();
+
+                vector<uint8_t> records(static_cast<uint64_t>(COMPRESSED_TABLE_BLOCK_RECORDS) * RECORD_SIZE);
+                in_nodes.read(reinterpret_cast<char *>(records.data()), records.size());
+                records.resize(in_nodes.gcount());
+
+                lock.lock();
+
+                if (records.size() % RECORD_SIZE != 0)
+                {
+                    bad_input = true;
+                    break;
+                }
+
+                if (records.empty())
+                {
+                    end_of_input = true;
+                }
+                else
+                {
+                    Slot & slot = slots[next_read % max_pending];
+                    slot.records.swap(records);
+                    slot.done = false;
+                    ++next_read;
+                }
+
+                state_changed.notify_all();
+                continue;
+            }
+
+            if (end_of_input && written == next_read)
+            {
+                break;
+            }
+
+            state_changed.wait(lock, [&]{ return worker_failed || slots[written % max_pending].done; });
+            if (worker_failed)
+            {
+                break;
+            }
+
+            // Write the block without holding the lock, so workers can continue.
+            Slot & slot = slots[written % max_pending];
+            vector<uint8_t> compressed;
+            compressed.swap(slot.compressed);
+            CompressedBlock block = slot.block;
+            slot.done = false;
+            lock.unlock();
+
+            block.offset = offset;
+            block.size   = compressed.size();
+            blocks.push_back(block);
+
+            out_compressed.write(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+            offset += compressed.size();
+
+            lock.lock();
+            ++written;
+            state_changed.notify_all();
+        }
+
+        // Make sure the workers stop.
+        end_of_input = true;
+        if (bad_input)
+        {
+            worker_failed = true;
+        }
+        state_changed.notify_all();
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    if (bad_input)
+    {
+        throw runtime_error("compress_table: input size is not a multiple of the record size.");
+    }
+
+    if (worker_failed)
+    {
+        throw runtime_error("compress_table: failed to compress a block.");
+    }
+
+    const vector<uint8_t> index = encode_compressed_table_index(blocks, offset);
+    out_compressed.write(reinterpret_cast<const char *>(index.data()), index.size());
+
+    if (!out_compressed)
+    {
+        throw runtime_error("compress_table: error while writing output.");
+    }
+}
+
+static void decompress_table(const string & in_compressed_filename,
+                             const string & out_nodes_filename,
+                             const uint64_t first_block,
+                             const uint64_t num_blocks_wanted)
+{
+    // Decompress the blocks [first_block, first_block + num_blocks_wanted) of a compressed table, or as many as are
+    // present, into a binary nodes file. The blocks are decompressed by worker threads, and written in order.
+
+    const CompressedTable table(in_compressed_filename);
+    const OutputFile      out_nodes_file(out_nodes_filename);
+
+    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+    const uint64_t num_blocks = table.get_blocks().size();
+    const uint64_t end_block  = first_block + min(num_blocks_wanted, num_blocks - min(first_block, num_blocks));
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+    const unsigned max_pending = 2 * num_threads;
+
+    vector<vector<uint8_t>> block_records(max_pending);
+    vector<bool>            block_done(max_pending);
+
+    mutex              state_mutex;
+    condition_variable state_changed;
+
+    uint64_t next_block    = first_block;
+    uint64_t written_block = first_block;
+    bool     worker_failed = false;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            uint64_t block_index;
+
+            {
+                unique_lock<mutex> lock(state_mutex);
+                state_changed.wait(lock, [&]{ return worker_failed || next_block >= end_block || next_block < written_block + max_pending; });
+                if (worker_failed || next_block >= end_block)
+                {
+                    return;
+                }
+                block_index = next_block++;
+            }
+
+            try
+            {
+                vector<uint8_t> records;
+
+                table.read_block(block_index, records);
+
+                lock_guard<mutex> lock(state_mutex);
+                block_records[block_index % max_pending].swap(records);
+                block_done[block_index % max_pending] = true;
+                state_changed.notify_all();
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(state_mutex);
+                worker_failed = true;
+                state_changed.notify_all();
+                return;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    {
+        unique_lock<mutex> lock(state_mutex);
+        while (written_block < end_block)
+        {
+            state_changed.wait(lock, [&]{ return worker_failed || block_done[written_block % max_pending]; });
+            if (worker_failed)
+            {
+                break;
+            }
+
+            // Write the block without holding the lock, so workers can continue.
+            vector<uint8_t> records;
+            records.swap(block_records[written_block % max_pending]);
+            block_done[written_block % max_pending] = false;
+            lock.unlock();
+            out_nodes.write(reinterpret_cast<const char *>(records.data()), records.size());
+            lock.lock();
+
+            ++written_block;
+            state_changed.notify_all();
+        }
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    if (worker_failed)
+    {
+        throw runtime_error("decompress_table: failed to decompress a block.");
+    }
+
+    if (!out_nodes)
+    {
+        throw runtime_error("decompress_table: error while writing output.");
+    }
+}
+
+static void print_blocks(const string & in_compressed_filename)
+{
+    // Print the block index of a compressed table, e.g. to select blocks for partial decompression.
+
+    const CompressedTable table(in_compressed_filename);
+
+    const vector<CompressedBlock> & blocks = table.get_blocks();
+
+    uint64_t total_compressed = 0;
+
+    for (unsigned i = 0; i < blocks.size(); ++i)
+    {
+        cout << "block "       << setw(6)  << i
+             << " first-key "  << key_to_base62_string(blocks[i].first_key, NUM_BASE62_BOARD_DIGITS)
+             << " records "    << setw(8)  << blocks[i].num_records
+             << " compressed " << setw(10) << blocks[i].size << endl;
+
+        total_compressed += blocks[i].size;
+    }
+
+    cout << "blocks " << blocks.size() << " records " << table.num_records() << " compressed " << total_compressed << endl;
+}
+
+static void pack_nodes(const string & in_nodes_filename,
+                       const string & out_nodes_filename)
+{
+    // Convert a sorted node file to the packed format (see node_file.h).
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_nodes_file(out_nodes_filename);
+
+    istream & in_nodes  = in_nodes_file.get_istream_reference();
+    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+    NodeReader       nodes_reader(in_nodes);
+    PackedNodeWriter nodes_writer(out_nodes);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        nodes_writer.write(key, score);
+    }
+}
+
+static void unpack_nodes(const string & in_nodes_filename,
+                         const string & out_nodes_filename)
+{
+    // Convert a node file to the text format, e.g. for processing by 'sort'.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_nodes_file(out_nodes_filename);
+
+    istream & in_nodes  = in_nodes_file.get_istream_reference();
+    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+
+    NodeReader nodes_reader(in_nodes);
+
+    BoardKey key;
+    Score    score;
+
+    while (nodes_reader.read(key, score))
+    {
+        out_nodes << key_to_base62_string(key, NUM_BASE62_BOARD_DIGITS) << score << '\n';
+    }
+}
+
+static void count_nodes(const string & in_nodes_filename)
+{
+    const InputFile in_nodes_file(in_nodes_filename);
+
+    istream & in_nodes = in_nodes_file.get_istream_reference();
+
+    cout << count_node_records(in_nodes) << endl;
+}
+
+static void make_wdl_file(const string & in_nodes_filename,
+                          const string & out_keys_filename,
+                          const string & out_wdl_filename)
+{
+    // Split a binary nodes file in two parts: a file with only the keys, in the same format as the
+    // binary nodes file, and a file with only the outcomes, packed as 2-bit values, four per octet
+    // (see wdl_file.h). The outcome of a record is found at the same index as its key in the keys file.
+    // The resulting table can be opened by LookupTable, given the name of the outcome file.
+
+    const InputFile  in_nodes_file(in_nodes_filename);
+    const OutputFile out_keys_file(out_keys_filename);
+    const OutputFile out_wdl_file(out_wdl_filename);
+
+    istream & in_nodes = in_nodes_file.get_istream_reference();
+    ostream & out_keys = out_keys_file.get_ostream_reference();
+    ostream & out_wdl  = out_wdl_file.get_ostream_reference();
+
+    // Write a provisional header; the record count is filled in at the end.
+
+    uint8_t header[WDL_FILE_HEADER_SIZE];
+    encode_wdl_file_header(0, header);
+    out_wdl.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    uint8_t  octets[BINARY_RECORD_SIZE];
+    uint64_t num_records = 0;
+    uint8_t  wdl_octet = 0;
+
+    while (in_nodes.read(reinterpret_cast<char *>(octets), BINARY_RECORD_SIZE))
+    {
+        const unsigned outcome_bits = wdl_outcome_code(Score::load(octets + NUM_BASE256_BOARD_DIGITS));
+
+        if (outcome_bits == 3)
+        {
+            throw runtime_error("make_wdl_file: unexpected indeterminate score.");
+        }
+
+        out_keys.write(reinterpret_cast<const char *>(octets), NUM_BASE256_BOARD_DIGITS);
+
+        wdl_octet |= outcome_bits << (2 * (num_records % 4));
+        ++num_records;
+
+        if (num_records % 4 == 0)
+        {
+            out_wdl.put(wdl_octet);
+            wdl_octet = 0;
+        }
+    }
+
+    if (in_nodes.gcount() != 0)
+    {
+        throw runtime_error("make_wdl_file: the input ends with a partial record.");
+    }
+
+    if (num_records % 4 != 0)
+    {
+        out_wdl.put(wdl_octet);
+    }
+
+    // Fill in the record count, if the output is seekable.
+
+    encode_wdl_file_header(num_records, header);
+
+    if (out_wdl.seekp(0))
+    {
+        out_wdl.write(reinterpret_cast<const char *>(header), sizeof(header));
+    }
+    else
+    {
+        throw runtime_error("make_wdl_file: the outcome file must be seekable.");
+    }
+}
+
+static void print_info(const string & in_nodes_filename)
+{
+    // Print a histogram of the records in a binary nodes file or a partitioned database.
+    // For a partitioned database, the checksum of each section is verified as well.
+
+    const InputFile in_nodes_file(in_nodes_filename);
+
+    istream & in_nodes = in_nodes_file.get_istream_reference();
+
+    vector<PartitionedDbSection> sections;
+
+    if (is_partitioned_db(in_nodes))
+    {
+        vector<uint8_t> header(PARTITIONED_DB_HEADER_SIZE);
+        if (!in_nodes.read(reinterpret_cast<char *>(header.data()), header.size()))
+        {
+            throw runtime_error("print_info: unable to read partitioned database header.");
+        }
+        sections = decode_partitioned_db_header(header.data());
+    }
+
+    vector<uint64_t> occurrences;
+
+    uint8_t octets[BINARY_RECORD_SIZE];
+
+    unsigned section_index    = 0;
+    uint64_t section_count    = 0;
+    uint64_t section_checksum = FNV1A_64_INITIAL_STATE;
+
+    while (in_nodes.read(reinterpret_cast<char *>(octets), BINARY_RECORD_SIZE))
+    {
+        if (!sections.empty())
+        {
+            while (section_index < sections.size() && section_count == sections[section_index].count)
+            {
+                if (section_checksum != sections[section_index].checksum)
+                {
+                    throw runtime_error("print_info: bad section checksum.");
+                }
+                ++section_index;
+                section_count = 0;
+                section_checksum = FNV1A_64_INITIAL_STATE;
+            }
+
+            if (section_index == sections.size())
+            {
+                throw runtime_error("print_info: unexpected data beyond the last section.");
+            }
+
+            section_checksum = fnv1a_64(octets, BINARY_RECORD_SIZE, section_checksum);
+            ++section_count;
+        }
+
+        BoardKey n = 0;
+        for (unsigned i = 0; i < NUM_BASE256_BOARD_DIGITS; ++i)
+        {
+            n *= 256;
+            n += octets[i];
+        }
+
+        const Board board = Board::from_key(n);
+
+        const bool is_symmetric = board.is_symmetric();
+
+        const unsigned index = histogram_index(board.count(), is_symmetric, Score::load(octets + NUM_BASE256_BOARD_DIGITS));
+        if (index >= occurrences.size())
+        {
+            occurrences.resize(index + 1);
+        }
+        ++occurrences[index];
+    }
+
+    // Check the remaining sections, which should all be complete.
+
+    while (section_index < sections.size())
+    {
+        if (section_count != sections[section_index].count || section_checksum != sections[section_index].checksum)
+        {
+            throw runtime_error("print_info: truncated or damaged section.");
+        }
+        ++section_index;
+        section_count = 0;
+        section_checksum = FNV1A_64_INITIAL_STATE;
+    }
+
+    print_histogram(occurrences, cout);
+}
+
+static Board parse_position(const string & position)
+{
+    // Positions are given as a sequence of moves, where each move is a column number starting at 1.
+    // The initial (empty) board is given as "-".
+
+    return Board::from_move_sequence(position == "-" ? "" : position);
+}
+
+// In the output of the modes that process batches of positions, a position that is not a legal sequence of moves
+// is followed by this marker instead of its results, so that a single bad position does not abort the batch.
+constexpr const char * INVALID_POSITION_MARKER = "invalid";
+
+static bool try_parse_position(const string & position, Board & board)
+{
+    // Parse a position, as parse_position does. Returns false if the position is not a legal sequence of moves.
+
+    try
+    {
+        board = parse_position(position);
+        return true;
+    }
+    catch (const runtime_error &)
+    {
+        return false;
+    }
+}
+
+static vector<string> read_positions(istream & in)
+{
+    vector<string> positions;
+    string position;
+
+    while (in >> position)
+    {
+        positions.push_back(position);
+    }
+
+    return positions;
+}
+
+static void build_filter(const string & in_table_filename,
+                         const string & out_filter_filename,
+                         const double   false_positive_rate)
+{
+    // Make a BloomFilter of the keys in a table (see bloom_filter.h), with the given false-positive rate.
+    // The first pass over the table counts the keys per generation, to size the filter; the second pass
+    // inserts them.
+
+    const LookupTable table(in_table_filename);
+
+    vector<uint64_t> generation_counts(H_SIZE * V_SIZE + 1);
+
+    for (uint64_t index = 0; index < table.num_records(); ++index)
+    {
+        ++generation_counts[Board::from_key(table.key_at(index)).count()];
+    }
+
+    BloomFilter filter(generation_counts, false_positive_rate);
+
+    for (uint64_t index = 0; index < table.num_records(); ++index)
+    {
+        const BoardKey key = table.key_at(index);
+        filter.insert(key, Board::from_key(key).count());
+    }
+
+    filter.save(out_filter_filename);
+
+    cout << "keys " << table.num_records() << " filter-bytes " << filter.size() << endl;
+}
+
+struct TableOptions {
+
+    // Options that determine how a lookup table is accessed; see print_usage().
+
+    uint64_t cache_size;      // Zero to memory-map the table, otherwise the size of the BlockCache in bytes.
+    unsigned pin_levels;      // Number of binary search levels to pin in the BlockCache.
+    int      pin_generations; // Highest generation to pin in the BlockCache, or -1 for none.
+    string   filter_filename; // Filename of a BloomFilter to consult before the table, or empty for none.
+};
+
+static unique_ptr<LookupTable> open_table(const string & in_table_filename, const TableOptions & table_options)
+{
+    unique_ptr<LookupTable> table = make_unique<LookupTable>(in_table_filename, table_options.cache_size);
+
+    table->pin_search_levels(table_options.pin_levels);
+
+    if (table_options.pin_generations >= 0)
+    {
+        table->pin_generations(table_options.pin_generations);
+    }
+
+    if (!table_options.filter_filename.empty())
+    {
+        table->set_filter(make_unique<BloomFilter>(table_options.filter_filename));
+    }
+
+    return table;
+}
+
+static void print_table_statistics(const LookupTable & table)
+{
+    // If the table is read through a BlockCache, report its effectiveness.
+
+    BlockCache::Statistics statistics;
+
+    if (table.cache_statistics(statistics))
+    {
+        const uint64_t accesses = statistics.hits + statistics.misses;
+
+        cerr << "table cache: hits " << statistics.hits << " misses " << statistics.misses << " evictions " << statistics.evictions
+             << " hit-rate " << fixed << setprecision(2) << (accesses == 0 ? 0.0 : 100.0 * statistics.hits / accesses) << "%"
+             << " pinned-blocks " << statistics.pinned_blocks << " capacity-blocks " << statistics.capacity_blocks << endl;
+    }
+}
+
+static void search(const string & in_positions_filename,
+                   const string & out_scores_filename,
+                   const string & in_table_filename,
+                   const unsigned table_max_generation,
+                   const TableOptions & table_options)
+{
+    // Determine the score of each of the positions in the input file by alpha-beta search,
+    // and write each position followed by its outcome and ply, or by INVALID_POSITION_MARKER.
+    //
+    // If a table filename is given, positions with up to 'table_max_generation' chips are looked
+    // up in that table (which may hold only the first generations) rather than searched.
+    //
+    // Positions are distributed over multiple threads, that share a single transposition table.
+
+    const InputFile  in_positions_file(in_positions_filename);
+    const OutputFile out_scores_file(out_scores_filename);
+
+    istream & in_positions = in_positions_file.get_istream_reference();
+    ostream & out_scores   = out_scores_file.get_ostream_reference();
+
+    const vector<string> positions = read_positions(in_positions);
+
+    vector<Board> boards(positions.size());
+    vector<bool>  valid(positions.size());
+
+    for (size_t index = 0; index < positions.size(); ++index)
+    {
+        valid[index] = try_parse_position(positions[index], boards[index]);
+    }
+
+    unique_ptr<LookupTable> table;
+    if (!in_table_filename.empty())
+    {
+        table = open_table(in_table_filename, table_options);
+    }
+
+    TranspositionTable transposition_table(DEFAULT_TRANSPOSITION_TABLE_LOG2_ENTRIES);
+
+    vector<Score> scores(boards.size());
+
+    atomic<size_t> next_index(0);
+
+    auto worker = [&]()
+    {
+        Searcher searcher(transposition_table, table.get(), table_max_generation);
+
+        size_t index;
+        while ((index = next_index++) < boards.size())
+        {
+            if (valid[index])
+            {
+                scores[index] = searcher.solve(boards[index]);
+            }
+        }
+    };
+
+    const unsigned num_threads = max(1u, min(thread::hardware_concurrency(), static_cast<unsigned>(boards.size())));
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    for (size_t index = 0; index < positions.size(); ++index)
+    {
+        if (!valid[index])
+        {
+            out_scores << positions[index] << ' ' << INVALID_POSITION_MARKER << '\n';
+            continue;
+        }
+
+        out_scores << positions[index] << ' ' << scores[index].outcome << ' ' << scores[index].ply << '\n';
+    }
+
+    if (table)
+    {
+        print_table_statistics(*table);
+    }
+}
+
+static void lookup(const string & in_table_filename,
+                   const string & in_positions_filename,
+                   const string & out_scores_filename,
+                   const TableOptions & table_options)
+{
+    // Look up the score of each of the positions in the input file, and write each position followed
+    // by its outcome and ply, in the same format as the --search mode. Positions that are not present
+    // in the table (which may hold only the first generations) get the indeterminate outcome; positions
+    // that are not a legal sequence of moves get INVALID_POSITION_MARKER.
+    //
+    // Positions are processed in batches; the binary searches of a batch proceed in lock-step
+    // (see LookupTable::lookup_batch).
+
+    // The number of positions per batch.
+    const size_t batch_size = 4096;
+
+    const unique_ptr<LookupTable> table = open_table(in_table_filename, table_options);
+
+    const InputFile  in_positions_file(in_positions_filename);
+    const OutputFile out_scores_file(out_scores_filename);
+
+    istream & in_positions = in_positions_file.get_istream_reference();
+    ostream & out_scores   = out_scores_file.get_ostream_reference();
+
+    vector<string>   positions;
+    vector<bool>     valid;
+    vector<BoardKey> keys;
+    vector<Score>    scores;
+    vector<bool>     found;
+
+    string position;
+    bool done = false;
+
+    while (!done)
+    {
+        positions.clear();
+        valid.clear();
+        keys.clear();
+
+        while (positions.size() < batch_size && (in_positions >> position))
+        {
+            // An invalid position is looked up as the empty board, and its result is discarded.
+
+            Board board = Board::make_empty();
+
+            positions.push_back(position);
+            valid.push_back(try_parse_position(position, board));
+            keys.push_back(board.normalize().to_key());
+        }
+
+        done = (positions.size() < batch_size);
+
+        table->lookup_batch(keys, scores, found);
+
+        for (size_t index = 0; index < positions.size(); ++index)
+        {
+            if (!valid[index])
+            {
+                out_scores << positions[index] << ' ' << INVALID_POSITION_MARKER << '\n';
+                continue;
+            }
+
+            const Score score = found[index] ? scores[index] : Score(Outcome::INDETERMINATE, 0);
+
+            out_scores << positions[index] << ' ' << score.outcome << ' ' << score.ply << '\n';
+        }
+    }
+
+    print_table_statistics(*table);
+}
+
+static void best_moves(const string & in_table_filename,
+                       const string & in_positions_filename,
+                       const string & out_moves_filename,
+                       const TableOptions & table_options)
+{
+    // Determine the optimal moves for each of the positions in the input file, by looking up the scores
+    // of their children in the table. Write each position followed by its outcome, its ply, and the
+    // comma-separated optimal columns (numbered from 1). For positions where the game has ended, the
+    // columns are given as '-'. Positions that are not a legal sequence of moves get INVALID_POSITION_MARKER.
+    //
+    // Positions are processed in batches. The child keys of a batch are sorted and deduplicated, and
+    // resolved in a single merged pass over the table, so the table is accessed nearly sequentially.
+
+    // The number of positions per batch. Larger batches make the table accesses more sequential.
+    const size_t batch_size = 1 << 20;
+
+    const unique_ptr<LookupTable> table = open_table(in_table_filename, table_options);
+
+    const InputFile  in_positions_file(in_positions_filename);
+    const OutputFile out_moves_file(out_moves_filename);
+
+    istream & in_positions = in_positions_file.get_istream_reference();
+    ostream & out_moves    = out_moves_file.get_ostream_reference();
+
+    struct Child {
+        int      column;
+        BoardKey key;
+    };
+
+    vector<string>        positions;
+    vector<bool>          valid;
+    vector<Board>         boards;
+    vector<vector<Child>> children;
+
+    vector<BoardKey> keys;
+    vector<Score>    key_scores;
+    vector<bool>     key_found;
+
+    string position;
+    bool done = false;
+
+    while (!done)
+    {
+        positions.clear();
+        valid.clear();
+        boards.clear();
+        children.clear();
+        keys.clear();
+
+        // Read a batch of positions, and collect the keys of their children.
+
+        while (positions.size() < batch_size && (in_positions >> position))
+        {
+            Board board = Board::make_empty();
+
+            const bool board_valid = try_parse_position(position, board);
+
+            vector<Child> board_children;
+
+            if (board_valid && board.trivial_outcome() == Outcome::INDETERMINATE)
+            {
+                for (int x = 0; x < H_SIZE; ++x)
+                {
+                    if (board.can_play(x))
+                    {
+                        const BoardKey key = board.play(x).normalize().to_key();
+                        board_children.push_back(Child{x, key});
+                        keys.push_back(key);
+                    }
+                }
+            }
+
+            positions.push_back(position);
+            valid.push_back(board_valid);
+            boards.push_back(board);
+            children.push_back(board_children);
+        }
+
+        done = (positions.size() < batch_size);
+
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        table->lookup_sorted_batch(keys, key_scores, key_found);
+
+        // Select the optimal moves for each position in the batch.
+
+        for (size_t index = 0; index < positions.size(); ++index)
+        {
+            out_moves << positions[index] << ' ';
+
+            if (!valid[index])
+            {
+                out_moves << INVALID_POSITION_MARKER << '\n';
+                continue;
+            }
+
+            if (children[index].empty())
+            {
+                out_moves << boards[index].trivial_outcome() << " 0 -\n";
+                continue;
+            }
+
+            vector<MoveScore> moves;
+
+            for (const Child & child: children[index])
+            {
+                const size_t key_index = lower_bound(keys.begin(), keys.end(), child.key) - keys.begin();
+
+                if (!key_found[key_index])
+                {
+                    throw runtime_error("best_moves: child board not found in table.");
+                }
+
+                moves.push_back(MoveScore{child.column, key_scores[key_index]});
+            }
+
+            Score board_score;
+            const vector<int> optimal_columns = select_optimal_moves(boards[index].mover(), moves, board_score);
+
+            out_moves << board_score.outcome << ' ' << board_score.ply << ' ';
+
+            for (size_t i = 0; i < optimal_columns.size(); ++i)
+            {
+                out_moves << (i == 0 ? "" : ",") << (optimal_columns[i] + 1);
+            }
+
+            out_moves << '\n';
+        }
+    }
+
+    print_table_statistics(*table);
+}
+
+static void principal_variations(const string & in_table_filename,
+                                 const string & in_positions_filename,
+                                 const string & out_pvs_filename,
+                                 const TableOptions & table_options)
+{
+    // Determine the principal variation of each of the positions in the input file: the line of optimal
+    // moves until the game ends, where the first of the optimal columns is played at each ply. Write each
+    // position followed by its outcome, its ply, the comma-separated columns of the line (numbered from 1;
+    // '-' if the game has ended), and the comma-separated scores (<outcome>:<ply>) of the boards along the
+    // line, starting with the position itself and ending with the board where the game ends. Positions that are
+    // not a legal sequence of moves get INVALID_POSITION_MARKER.
+    //
+    // Positions are processed in batches. The lines of a batch advance in lock-step, one ply at a time, so the
+    // child keys of all lines at a ply can be sorted, deduplicated, and resolved in a single merged pass over
+    // the table. Since many lines pass through the same boards, the scores found are kept in a cache that is
+    // shared by all batches; only the child keys that are not in the cache are looked up.
+
+    // The number of positions per batch.
+    const size_t batch_size = 1 << 16;
+
+    // The maximum number of scores in the cache. When it is full, no more scores are added; the boards of
+    // the first plies, that are shared by the most lines, are found first.
+    const size_t max_cache_entries = 1 << 22;
+
+    const unique_ptr<LookupTable> table = open_table(in_table_filename, table_options);
+
+    const InputFile  in_positions_file(in_positions_filename);
+    const OutputFile out_pvs_file(out_pvs_filename);
+
+    istream & in_positions = in_positions_file.get_istream_reference();
+    ostream & out_pvs      = out_pvs_file.get_ostream_reference();
+
+    struct Line {
+        string        position;
+        bool          valid;   // Whether the position is a legal sequence of moves.
+        Board         board;   // The board at the end of the line so far.
+        vector<int>   columns; // The columns played along the line.
+        vector<Score> scores;  // The scores of the boards along the line.
+    };
+
+    unordered_map<BoardKey, Score, BoardKeyHash> cache;
+    uint64_t cache_hits   = 0;
+    uint64_t cache_misses = 0;
+
+    vector<Line>   lines;
+    vector<size_t> active_lines;
+
+    vector<BoardKey> keys;
+    vector<Score>    key_scores;
+    vector<bool>     key_found;
+
+    string position;
+    bool done = false;
+
+    while (!done)
+    {
+        lines.clear();
+        active_lines.clear();
+
+        while (lines.size() < batch_size && (in_positions >> position))
+        {
+            Board board = Board::make_empty();
+
+            const bool valid = try_parse_position(position, board);
+
+            lines.push_back(Line{position, valid, board, {}, {}});
+
+            if (valid)
+            {
+                active_lines.push_back(lines.size() - 1);
+            }
+        }
+
+        done = (lines.size() < batch_size);
+
+        // Advance the lines that have not ended, one ply at a time.
+
+        while (!active_lines.empty())
+        {
+            // Collect the keys of the children of the boards at the end of the lines, that are not in the cache.
+
+            keys.clear();
+
+            for (const size_t index: active_lines)
+            {
+                const Board & board = lines[index].board;
+
+                if (board.trivial_outcome() != Outcome::INDETERMINATE)
+                {
+                    continue;
+                }
+
+                for (int x = 0; x < H_SIZE; ++x)
+                {
+                    if (board.can_play(x))
+                    {
+                        const BoardKey key = board.play(x).normalize().to_key();
+
+                        if (cache.find(key) == cache.end())
+                        {
+                            keys.push_back(key);
+                        }
+                    }
+                }
+            }
+
+            sort(keys.begin(), keys.end());
+            keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+            table->lookup_sorted_batch(keys, key_scores, key_found);
+
+            // The child scores are found in the cache or in the batch.
+
+            auto child_score = [&](BoardKey key)
+            {
+                const auto entry = cache.find(key);
+
+                if (entry != cache.end())
+                {
+                    ++cache_hits;
+                    return entry->second;
+                }
+
+                ++cache_misses;
+
+                const size_t key_index = lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+
+                if (!key_found[key_index])
+                {
+                    throw runtime_error("principal_variations: child board not found in table.");
+                }
+
+                return key_scores[key_index];
+            };
+
+            // Play the first optimal move of each line; lines where the game has ended are done.
+
+            size_t num_active_lines = 0;
+
+            for (const size_t index: active_lines)
+            {
+                Line & line = lines[index];
+
+                if (line.board.trivial_outcome() != Outcome::INDETERMINATE)
+                {
+                    line.scores.push_back(Score(line.board.trivial_outcome(), 0));
+                    continue;
+                }
+
+                vector<MoveScore> moves;
+
+                for (int x = 0; x < H_SIZE; ++x)
+                {
+                    if (line.board.can_play(x))
+                    {
+                        moves.push_back(MoveScore{x, child_score(line.board.play(x).normalize().to_key())});
+                    }
+                }
+
+                Score board_score;
+                const vector<int> optimal_columns = select_optimal_moves(line.board.mover(), moves, board_score);
+
+                line.columns.push_back(optimal_columns.front());
+                line.scores.push_back(board_score);
+                line.board = line.board.play(optimal_columns.front());
+
+                active_lines[num_active_lines++] = index;
+            }
+
+            active_lines.resize(num_active_lines);
+
+            for (size_t key_index = 0; key_index < keys.size() && cache.size() < max_cache_entries; ++key_index)
+            {
+                if (key_found[key_index])
+                {
+                    cache.emplace(keys[key_index], key_scores[key_index]);
+                }
+            }
+        }
+
+        for (const Line & line: lines)
+        {
+            if (!line.valid)
+            {
+                out_pvs << line.position << ' ' << INVALID_POSITION_MARKER << '\n';
+                continue;
+            }
+
+            out_pvs << line.position << ' ' << line.scores.front().outcome << ' ' << line.scores.front().ply << ' ';
+
+            if (line.columns.empty())
+            {
+                out_pvs << '-';
+            }
+
+            for (size_t i = 0; i < line.columns.size(); ++i)
+            {
+                out_pvs << (i == 0 ? "" : ",") << (line.columns[i] + 1);
+            }
+
+            out_pvs << ' ';
+
+            for (size_t i = 0; i < line.scores.size(); ++i)
+            {
+                out_pvs << (i == 0 ? "" : ",") << line.scores[i].outcome << ":" << line.scores[i].ply;
+            }
+
+            out_pvs << '\n';
+        }
+    }
+
+    cerr << "pv-cache entries " << cache.size() << " hits " << cache_hits << " misses " << cache_misses << endl;
+
+    print_table_statistics(*table);
+}
+
+static void extract_book(const string & in_table_filename,
+                         const string & out_book_filename,
+                         const unsigned max_moves,
+                         const string & policy_name,
+                         const TableOptions & table_options)
+{
+    // Extract an opening book (see opening_book.h) from a table, by walking the game tree from the empty board,
+    // one generation at a time, up to boards with 'max_moves' chips. The 'optimal' policy follows only the
+    // optimal moves of each board; the 'any' policy follows all moves.
+    //
+    // For each board that is walked, the book holds its score and its optimal moves. The book also holds the
+    // scores of all children of these boards, so that clients can show the score of every available move.
+
+    OpeningBookPolicy policy;
+
+    if (policy_name == "optimal")
+    {
+        policy = OPENING_BOOK_POLICY_OPTIMAL;
+    }
+    else if (policy_name == "any")
+    {
+        policy = OPENING_BOOK_POLICY_ANY;
+    }
+    else
+    {
+        throw runtime_error("extract_book: the policy must be 'optimal' or 'any'.");
+    }
+
+    const unique_ptr<LookupTable> table = open_table(in_table_filename, table_options);
+
+    struct BookRecord {
+        BoardKey key;
+        Score    score;
+        uint64_t moves;
+    };
+
+    vector<BookRecord> records;
+
+    // The normalized keys of the boards to walk in the current generation, sorted; and the children of the
+    // boards of the previous generation that were not walked, which only need their scores in the book.
+
+    vector<BoardKey> walk_keys{Board::make_empty().normalize().to_key()};
+    vector<BoardKey> leaf_keys;
+    vector<Score>    leaf_scores;
+
+    unsigned num_walked = 0;
+
+    for (unsigned moves = 0; moves <= max_moves && !walk_keys.empty(); ++moves)
+    {
+        // Collect the keys of the children of the boards to walk, and look them up in a single pass.
+
+        vector<BoardKey> child_keys;
+
+        for (const BoardKey key: walk_keys)
+        {
+            const Board board = Board::from_key(key);
+
+            if (board.trivial_outcome() == Outcome::INDETERMINATE)
+            {
+                for (int x = 0; x < H_SIZE; ++x)
+                {
+                    if (board.can_play(x))
+                    {
+                        child_keys.push_back(board.play(x).normalize().to_key());
+                    }
+                }
+            }
+        }
+
+        sort(child_keys.begin(), child_keys.end());
+        child_keys.erase(unique(child_keys.begin(), child_keys.end()), child_keys.end());
+
+        vector<Score> child_scores;
+        vector<bool>  child_found;
+
+        table->lookup_sorted_batch(child_keys, child_scores, child_found);
+
+        // Determine the score and the optimal moves of each board, and the boards to walk next.
+
+        vector<bool> walk_next(child_keys.size(), policy == OPENING_BOOK_POLICY_ANY && moves < max_moves);
+
+        for (const BoardKey key: walk_keys)
+        {
+            const Board board = Board::from_key(key);
+
+            BookRecord record{key, Score(board.trivial_outcome(), 0), 0};
+
+            if (record.score.outcome == Outcome::INDETERMINATE)
+            {
+                vector<MoveScore> move_scores;
+                size_t            child_index[H_SIZE];
+
+                for (int x = 0; x < H_SIZE; ++x)
+                {
+                    if (board.can_play(x))
+                    {
+                        const size_t index = lower_bound(child_keys.begin(), child_keys.end(), board.play(x).normalize().to_key()) - child_keys.begin();
+
+                        if (!child_found[index])
+                        {
+                            throw runtime_error("extract_book: child board not found in table.");
+                        }
+
+                        move_scores.push_back(MoveScore{x, child_scores[index]});
+                        child_index[x] = index;
+                    }
+                }
+
+                for (const int x: select_optimal_moves(board.mover(), move_scores, record.score))
+                {
+                    record.moves |= uint64_t(1) << x;
+
+                    if (policy == OPENING_BOOK_POLICY_OPTIMAL && moves < max_moves)
+                    {
+                        walk_next[child_index[x]] = true;
+                    }
+                }
+            }
+
+            records.push_back(record);
+        }
+
+        num_walked += walk_keys.size();
+
+        // Children that are walked get their record in the next generation; the others are leaves of the book.
+
+        walk_keys.clear();
+
+        for (size_t index = 0; index < child_keys.size(); ++index)
+        {
+            if (walk_next[index])
+            {
+                walk_keys.push_back(child_keys[index]);
+            }
+            else
+            {
+                records.push_back(BookRecord{child_keys[index], child_scores[index], 0});
+            }
+        }
+    }
+
+    sort(records.begin(), records.end(), [](const BookRecord & lhs, const BookRecord & rhs) { return lhs.key < rhs.key; });
+
+    // Write the book.
+
+    vector<uint8_t> octets(records.size() * OPENING_BOOK_RECORD_SIZE);
+
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        uint8_t * record = &octets[i * OPENING_BOOK_RECORD_SIZE];
+        make_binary_record(records[i].key, records[i].score, record);
+        store_le(record + BINARY_RECORD_SIZE, records[i].moves, OPENING_BOOK_MOVES_SIZE);
+    }
+
+    uint8_t header[OPENING_BOOK_HEADER_SIZE];
+    encode_opening_book_header(max_moves, policy, records.size(), fnv1a_64(octets.data(), octets.size()), header);
+
+    const OutputFile out_book_file(out_book_filename);
+
+    ostream & out_book = out_book_file.get_ostream_reference();
+
+    out_book.write(reinterpret_cast<const char *>(header), OPENING_BOOK_HEADER_SIZE);
+    out_book.write(reinterpret_cast<const char *>(octets.data()), octets.size());
+
+    if (!out_book)
+    {
+        throw runtime_error("extract_book: error while writing book.");
+    }
+
+    cout << "boards " << num_walked << " records " << records.size() << " book-bytes " << (OPENING_BOOK_HEADER_SIZE + octets.size()) << endl;
+}
+
+static void export_training(const string & in_table_filename,
+                            const string & out_training_filename,
+                            const double   sample_rate,
+                            const uint64_t seed,
+                            const string & sampling_name)
+{
+    // Export a sample of the records of a table as training data (see training_data.h).
+    //
+    // Whether a record is sampled only depends on its key and the seed: the key is hashed with the seed into a
+    // number in [0, 1), and the record is sampled if that number is below the sample rate of its stratum. So the
+    // sample is the same for any number of threads, and a sample with a higher rate contains one with a lower rate.
+    //
+    // With 'uniform' sampling, all records have the given sample rate. With 'stratified' sampling, the records
+    // are first counted per stratum (number of moves and outcome for the mover), and each stratum is given the
+    // rate that yields the same expected number of records, (sample_rate * num_records / num_strata), or all
+    // of its records if it has fewer.
+    //
+    // The table is processed in chunks, in parallel. The chunks are written in order, so the records of the
+    // output are sorted by key within each generation, like those of the table.
+
+    TrainingSampling sampling;
+
+    if (sampling_name == "uniform")
+    {
+        sampling = TRAINING_SAMPLING_UNIFORM;
+    }
+    else if (sampling_name == "stratified")
+    {
+        sampling = TRAINING_SAMPLING_STRATIFIED;
+    }
+    else
+    {
+        throw runtime_error("export_training: unknown sampling.");
+    }
+
+    if (!(sample_rate > 0.0))
+    {
+        throw runtime_error("export_training: the sample rate must be positive.");
+    }
+
+    constexpr unsigned NUM_STRATA    = (MAX_PLY + 1) * 3;
+    constexpr uint64_t CHUNK_RECORDS = 1 << 20;
+
+    const LookupTable table(in_table_filename);
+
+    const uint64_t num_records = table.num_records();
+    const uint64_t num_chunks  = (num_records + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+    const uint64_t seed_hash   = mix64(seed);
+
+    const TrainingRecordEncoder encoder;
+
+    auto sample_position = [seed_hash](BoardKey key)
+    {
+        // A number in [0, 1), from the 53 most significant bits of the hash.
+        return (mix64(fold_key(key) ^ seed_hash) >> 11) / double(uint64_t(1) << 53);
+    };
+
+    vector<double> stratum_rate(NUM_STRATA, sample_rate);
+
+    if (sampling == TRAINING_SAMPLING_STRATIFIED)
+    {
+        vector<vector<uint64_t>> thread_counts(max(1u, thread::hardware_concurrency()), vector<uint64_t>(NUM_STRATA, 0));
+
+        run_in_parallel(num_records, [&](unsigned t, uint64_t begin, uint64_t end)
+        {
+            uint8_t record[TRAINING_RECORD_SIZE];
+
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                const unsigned moves = encoder.encode(table.key_at(i), table.score_at(i), record);
+                ++thread_counts[t][moves * 3 + record[TRAINING_OUTCOME_OFFSET]];
+            }
+        });
+
+        vector<uint64_t> counts(NUM_STRATA, 0);
+        unsigned num_nonempty_strata = 0;
+
+        for (unsigned stratum = 0; stratum < NUM_STRATA; ++stratum)
+        {
+            for (const vector<uint64_t> & thread_count: thread_counts)
+            {
+                counts[stratum] += thread_count[stratum];
+            }
+            num_nonempty_strata += (counts[stratum] != 0);
+        }
+
+        const double records_per_stratum = sample_rate * num_records / max(1u, num_nonempty_strata);
+
+        for (unsigned stratum = 0; stratum < NUM_STRATA; ++stratum)
+        {
+            stratum_rate[stratum] = (counts[stratum] != 0) ? records_per_stratum / counts[stratum] : 0.0;
+        }
+    }
+
+    const OutputFile out_training_file(out_training_filename);
+
+    ostream & out_training = out_training_file.get_ostream_reference();
+
+    // Write a provisional header; the record count is filled in at the end.
+
+    uint8_t header[TRAINING_DATA_HEADER_SIZE];
+    encode_training_data_header(sampling, seed, 0, header);
+    out_training.write(reinterpret_cast<const char *>(header), TRAINING_DATA_HEADER_SIZE);
+
+    // Worker threads claim chunks in order, but will not claim a chunk while there are already 'max_pending'
+    // chunks processed or being processed that have not yet been written.
+
+    const unsigned num_threads = max(1u, thread::hardware_concurrency());
+    const unsigned max_pending = 2 * num_threads;
+
+    vector<vector<uint8_t>> chunk_output(num_chunks);
+    vector<bool>            chunk_done(num_chunks, false);
+
+    uint64_t next_chunk    = 0; // The next chunk to be claimed by a worker thread.
+    uint64_t written_chunk = 0; // The next chunk to be written to the output.
+    bool     worker_failed = false;
+
+    mutex              state_mutex;
+    condition_variable state_changed;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            uint64_t chunk;
+
+            {
+                unique_lock<mutex> lock(state_mutex);
+                state_changed.wait(lock, [&]{ return worker_failed || next_chunk == num_chunks || next_chunk < written_chunk + max_pending; });
+                if (worker_failed || next_chunk == num_chunks)
+                {
+                    return;
+                }
+                chunk = next_chunk++;
+            }
+
+            try
+            {
+                const uint64_t begin = chunk * CHUNK_RECORDS;
+                const uint64_t end   = min(begin + CHUNK_RECORDS, num_records);
+
+                vector<uint8_t> output;
+                uint8_t record[TRAINING_RECORD_SIZE];
+
+                for (uint64_t i = begin; i < end; ++i)
+                {
+                    const BoardKey key = table.key_at(i);
+                    const double position = sample_position(key);
+
+                    // For uniform sampling, most records are rejected before they are decoded.
+                    if (sampling == TRAINING_SAMPLING_UNIFORM && position >= sample_rate)
+                    {
+                        continue;
+                    }
+
+                    const unsigned moves = encoder.encode(key, table.score_at(i), record);
+
+                    if (position < stratum_rate[moves * 3 + record[TRAINING_OUTCOME_OFFSET]])
+                    {
+                        output.insert(output.end(), record, record + TRAINING_RECORD_SIZE);
+                    }
+                }
+
+                lock_guard<mutex> lock(state_mutex);
+                chunk_output[chunk].swap(output);
+                chunk_done[chunk] = true;
+                state_changed.notify_all();
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(state_mutex);
+                worker_failed = true;
+                state_changed.notify_all();
+                return;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    uint64_t num_samples = 0;
+
+    {
+        unique_lock<mutex> lock(state_mutex);
+        while (written_chunk < num_chunks)
+        {
+            state_changed.wait(lock, [&]{ return worker_failed || chunk_done[written_chunk]; });
+            if (worker_failed)
+            {
+                break;
+            }
+
+            // Write the chunk without holding the lock, so workers can continue.
+            vector<uint8_t> output;
+            output.swap(chunk_output[written_chunk]);
+            lock.unlock();
+            out_training.write(reinterpret_cast<const char *>(output.data()), output.size());
+            num_samples += output.size() / TRAINING_RECORD_SIZE;
+            lock.lock();
+
+            ++written_chunk;
+            state_changed.notify_all();
+        }
+    }
+
+    for (thread & t: workers)
+    {
+        t.join();
+    }
+
+    if (worker_failed)
+    {
+        throw runtime_error("export_training: failed to process a chunk.");
+    }
+
+    // Fill in the record count, if the output is seekable.
+
+    encode_training_data_header(sampling, seed, num_samples, header);
+
+    if (!out_training.seekp(0) || !out_training.write(reinterpret_cast<const char *>(header), TRAINING_DATA_HEADER_SIZE))
+    {
+        throw runtime_error("export_training: the training data file must be seekable.");
+    }
+
+    cout << "records " << num_records << " samples " << num_samples << " bytes " << (TRAINING_DATA_HEADER_SIZE + num_samples * TRAINING_RECORD_SIZE) << endl;
+}
+
+// A manifest describes a file as a sequence of chunks of a fixed size (the last chunk may be shorter), with the XXH64
+// hash of each chunk, and a Merkle root over the chunk hashes. It is a text file:
+//
+//     size <file size in bytes>
+//     chunk-size <chunk size in bytes>
+//     chunk <index> <offset> <size> <XXH64 hash, 16 hex digits>     (one line per chunk)
+//     merkle-root <SHA-256 digest, 64 hex digits>
+//
+// The leaves of the Merkle tree are SHA-256(0x00, h) for each chunk hash h, as 8 big-endian bytes. An inner node is
+// SHA-256(0x01, left, right); a node without a sibling at the end of a level is carried up unchanged. The root of
+// an empty file is SHA-256 of no bytes. So the root can be recomputed from the chunk lines with standard tools.
+
+constexpr uint64_t DEFAULT_MANIFEST_CHUNK_SIZE = uint64_t(64) << 20;
+
+static string hex_string(const uint8_t * data, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    string s;
+    for (size_t i = 0; i < size; ++i)
+    {
+        s += digits[data[i] >> 4];
+        s += digits[data[i] & 15];
+    }
+    return s;
+}
+
+static string manifest_merkle_root(const vector<uint64_t> & chunk_hashes)
+{
+    vector<vector<uint8_t>> level;
+
+    for (const uint64_t chunk_hash: chunk_hashes)
+    {
+        uint8_t leaf[9] = {0};
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            leaf[1 + i] = (chunk_hash >> (8 * (7 - i))) & 255;
+        }
+        level.emplace_back(SHA256_DIGEST_SIZE);
+        sha256(leaf, sizeof(leaf), level.back().data());
+    }
+
+    if (level.empty())
+    {
+        level.emplace_back(SHA256_DIGEST_SIZE);
+        sha256(nullptr, 0, level.back().data());
+    }
+
+    while (level.size() > 1)
+    {
+        vector<vector<uint8_t>> next_level;
+
+        for (size_t i = 0; i < level.size(); i += 2)
+        {
+            if (i + 1 == level.size())
+            {
+                next_level.push_back(level[i]);
+                continue;
+            }
+
+            uint8_t node[1 + 2 * SHA256_DIGEST_SIZE];
+            node[0] = 1;
+            copy(level[i].begin(), level[i].end(), node + 1);
+            copy(level[i + 1].begin(), level[i + 1].end(), node + 1 + SHA256_DIGEST_SIZE);
+
+            next_level.emplace_back(SHA256_DIGEST_SIZE);
+            sha256(node, sizeof(node), next_level.back().data());
+        }
+
+        level.swap(next_level);
+    }
+
+    return hex_string(level[0].data(), SHA256_DIGEST_SIZE);
+}
+
+static vector<uint64_t> hash_chunks(const string & in_filename, const uint64_t chunk_size, uint64_t & file_size)
+{
+    // Hash the chunks of a file in parallel. Each thread claims the next chunk, reads it into its own buffer,
+    // and hashes it; XXH64 is fast enough that this runs at the speed of the disk.
+
+    const int fd = open(in_filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        throw runtime_error("hash_chunks: unable to open file.");
+    }
 
-                        if (node_mover_has_win)
-                        {
-                            if (win_ply < node_mover_min_win)
-                            {
-                                node_mover_min_win = win_ply;
-                            }
-                        }
-                        else
-                        {
-                            node_mover_has_win = true;
-                            node_mover_min_win = win_ply;
-                        }
-                    }
-                    else // The mover loses
-                    {
-                        const unsigned loss_ply = edge_score.ply + 1;
+    struct stat statbuf;
 
-                        if (node_mover_has_loss)
-                        {
-                            if (loss_ply > node_mover_max_loss)
-                            {
-                                node_mover_max_loss = loss_ply;
-                            }
-                        }
-                        else
-                        {
-                            node_mover_has_loss = true;
-                            node_mover_max_loss = loss_ply;
-                        }
-                    }
-                    edge_score_valid = false; // Invalidate current score; we used it.
-                }
-                else
+    if (fstat(fd, &statbuf) != 0)
+    {
+        close(fd);
+        throw runtime_error("hash_chunks: unable to stat file.");
+    }
+
+    file_size = statbuf.st_size;
+
+    const uint64_t num_chunks = (file_size + chunk_size - 1) / chunk_size;
+
+    vector<uint64_t> chunk_hashes(num_chunks);
+
+    atomic<uint64_t> next_chunk(0);
+
+    try
+    {
+        run_in_parallel(max(1u, thread::hardware_concurrency()), [&](unsigned, uint64_t, uint64_t)
+        {
+            vector<uint8_t> buffer;
+
+            uint64_t chunk;
+            while ((chunk = next_chunk++) < num_chunks)
+            {
+                const uint64_t offset = chunk * chunk_size;
+                const uint64_t size   = min(chunk_size, file_size - offset);
+
+                buffer.resize(size);
+
+                uint64_t done = 0;
+                while (done < size)
                 {
-                    // Either we reached the end of the 'in_edges_with_score' stream, or the edge just read from it is not
-                    // relevant to the currently processed node (board). In either case, we can now calculate the evaluation
-                    // for the current node.
+                    const ssize_t result = pread(fd, buffer.data() + done, size - done, offset + done);
 
-                    if (node_mover_has_win)
-                    {
-                        // The mover's best move is a win.
-                        const Score score = Score(node_mover == Player::A ? Outcome::A_WINS : Outcome::B_WINS, node_mover_min_win);
-                        out_nodes_with_score << node_board_string << score << '\n';
-                    }
-                    else if (node_mover_has_draw)
-                    {
-                        // The mover's best move is a draw.
-                        const Score score = Score(Outcome::DRAW, node_mover_any_draw);
-                        out_nodes_with_score << node_board_string << score << '\n';
-                    }
-                    else if (node_mover_has_loss)
+                    if (result < 0 && errno == EINTR)
                     {
-                        // The mover's best move is a loss.
-                        const Score score = Score(node_mover == Player::A ? Outcome::B_WINS : Outcome::A_WINS, node_mover_max_loss);
-                        out_nodes_with_score << node_board_string << score << '\n';
+                        continue;
                     }
-                    else
+
+                    if (result <= 0)
                     {
-                        throw runtime_error("we should have a win, draw, or loss.");
+                        throw runtime_error("hash_chunks: read error.");
                     }
 
-                    break; // Proceed to the next board.
+                    done += result;
                 }
-            } // While loop for reading edges for the current node (board).
-        } // Visiting a node that has no trivial winner. Determine win/lose/draw state for the node.
-    } // Walk the nodes.
+
+                chunk_hashes[chunk] = xxh64(buffer.data(), size);
+            }
+        });
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+
+    return chunk_hashes;
 }
 
-static void make_binary_file(const string & in_nodes_filename,
-                             const string & out_nodes_filename)
+static void make_manifest(const string & in_filename,
+                          const string & out_manifest_filename,
+                          const uint64_t chunk_size)
 {
-    const InputFile  in_nodes_file(in_nodes_filename);
-    const OutputFile out_nodes_file(out_nodes_filename);
+    // Write the manifest of a file (see above).
 
-    istream & in_nodes  = in_nodes_file.get_istream_reference();
-    ostream & out_nodes = out_nodes_file.get_ostream_reference();
+    if (chunk_size == 0)
+    {
+        throw runtime_error("make_manifest: the chunk size must be positive.");
+    }
 
-    Board board;
-    Score score;
+    uint64_t file_size;
 
-    while (in_nodes >> board >> score)
-    {
-        uint8_t octets[NUM_BASE256_BOARD_DIGITS + 1];
-        uint64_t n = board.to_uint64();
+    const vector<uint64_t> chunk_hashes = hash_chunks(in_filename, chunk_size, file_size);
 
-        // Insert the Board's unsigned int value in big-endian order.
-        // We write using big-endian rather than little-endian order because it results in a
-        // file that can be compressed to a significantly smaller size.
+    const OutputFile out_manifest_file(out_manifest_filename);
 
-        for (unsigned i = 0; i < NUM_BASE256_BOARD_DIGITS; ++i)
-        {
-             octets[NUM_BASE256_BOARD_DIGITS - 1 - i] = n & 255;
-             n >>= 8;
-        }
+    ostream & out_manifest = out_manifest_file.get_ostream_reference();
 
-        if (n != 0)
-        {
-            throw runtime_error("make_binary_file: unable to write board in NUM_BASE256_BOARD_DIGITS bytes.");
-        }
+    out_manifest << "size " << file_size << '\n';
+    out_manifest << "chunk-size " << chunk_size << '\n';
 
-        if (score.outcome == Outcome::INDETERMINATE)
-        {
-            throw runtime_error("make_binary_file: unexpected indeterminate score.");
-        }
+    for (uint64_t chunk = 0; chunk < chunk_hashes.size(); ++chunk)
+    {
+        const uint64_t offset = chunk * chunk_size;
+        out_manifest << "chunk " << chunk << ' ' << offset << ' ' << min(chunk_size, file_size - offset) << ' '
+                     << hex << setw(16) << setfill('0') << chunk_hashes[chunk] << dec << setfill(' ') << '\n';
+    }
 
-        octets[NUM_BASE256_BOARD_DIGITS] = score.to_uint8();
+    out_manifest << "merkle-root " << manifest_merkle_root(chunk_hashes) << endl;
 
-        out_nodes.write(reinterpret_cast<char *>(octets), NUM_BASE256_BOARD_DIGITS + 1);
+    if (!out_manifest)
+    {
+        throw runtime_error("make_manifest: error while writing manifest.");
     }
 }
 
-static void print_info(const string & in_nodes_filename)
+static void check_manifest(const string & in_filename,
+                           const string & in_manifest_filename)
 {
-    const InputFile in_nodes_file(in_nodes_filename);
+    // Check a file against its manifest, and report every chunk that does not match, so that only
+    // those chunks need to be repaired or fetched again.
 
-    istream & in_nodes = in_nodes_file.get_istream_reference();
+    const InputFile in_manifest_file(in_manifest_filename);
 
-    vector<uint64_t> occurrences;
+    istream & in_manifest = in_manifest_file.get_istream_reference();
+
+    uint64_t expected_size = 0;
+    uint64_t chunk_size = 0;
+    string   merkle_root;
 
-    uint8_t octets[NUM_BASE256_BOARD_DIGITS + 1];
+    vector<uint64_t> expected_hashes;
 
-    while (in_nodes.read(reinterpret_cast<char *>(octets), NUM_BASE256_BOARD_DIGITS + 1))
+    string line;
+    while (getline(in_manifest, line))
     {
-        uint64_t n = 0;
-        for (unsigned i = 0; i < NUM_BASE256_BOARD_DIGITS; ++i)
+        istringstream fields(line);
+        string tag;
+        fields >> tag;
+
+        if (tag == "size")
         {
-            n *= 256;
-            n += octets[i];
+            fields >> expected_size;
+        }
+        else if (tag == "chunk-size")
+        {
+            fields >> chunk_size;
         }
+        else if (tag == "chunk")
+        {
+            uint64_t index, offset, size;
+            string   hash_string;
 
-        const Board board = Board::from_uint64(n);
+            fields >> index >> offset >> size >> hash_string;
 
-        const bool is_symmetric = board.is_symmetric();
+            if (!fields || index != expected_hashes.size() || hash_string.size() != 16)
+            {
+                throw runtime_error("check_manifest: bad chunk line.");
+            }
 
-        const unsigned index = board.count() * 512 + (is_symmetric ? 256 : 0) + octets[NUM_BASE256_BOARD_DIGITS];
-        if (index >= occurrences.size())
+            expected_hashes.push_back(stoull(hash_string, nullptr, 16));
+        }
+        else if (tag == "merkle-root")
         {
-            occurrences.resize(index + 1);
+            fields >> merkle_root;
+        }
+        else
+        {
+            throw runtime_error("check_manifest: bad manifest line.");
         }
-        ++occurrences[index];
     }
 
-    for (unsigned index = 0; index < occurrences.size(); ++index)
+    if (chunk_size == 0 || merkle_root.empty())
     {
-        if (occurrences[index] != 0)
+        throw runtime_error("check_manifest: incomplete manifest.");
+    }
+
+    if (manifest_merkle_root(expected_hashes) != merkle_root)
+    {
+        throw runtime_error("check_manifest: the chunk hashes of the manifest do not match its Merkle root.");
+    }
+
+    uint64_t file_size;
+
+    const vector<uint64_t> chunk_hashes = hash_chunks(in_filename, chunk_size, file_size);
+
+    if (file_size != expected_size)
+    {
+        cout << "size " << file_size << " expected " << expected_size << endl;
+    }
+
+    uint64_t num_bad_chunks = 0;
+
+    for (uint64_t chunk = 0; chunk < max(chunk_hashes.size(), expected_hashes.size()); ++chunk)
+    {
+        const bool present  = chunk < chunk_hashes.size();
+        const bool expected = chunk < expected_hashes.size();
+
+        if (present && expected && chunk_hashes[chunk] == expected_hashes[chunk] &&
+            (chunk + 1 < expected_hashes.size() || file_size == expected_size))
         {
-            const Score score = Score::from_uint8(index % 256);
-            const bool is_symmetric = (index & 256) != 0;
-            cout << "moves " << setw(2) << (index / 512) << " symmetric " << is_symmetric << " outcome " << score.outcome << " ply " << setw(2) << score.ply << " count " << setw(12) << occurrences[index] << endl;
+            continue;
         }
+
+        ++num_bad_chunks;
+        cout << "bad-chunk " << chunk << " offset " << chunk * chunk_size << (present ? "" : " missing") << (expected ? "" : " unexpected") << endl;
+    }
+
+    // The Merkle root is recomputed from the chunks of the file, so that it can be cross-checked independently.
+
+    const string file_merkle_root = manifest_merkle_root(chunk_hashes);
+
+    cout << "chunks " << expected_hashes.size() << " bad " << num_bad_chunks << " merkle-root " << file_merkle_root;
+
+    if (file_merkle_root != merkle_root)
+    {
+        cout << " expected-merkle-root " << merkle_root;
+    }
+
+    cout << endl;
+
+    if (num_bad_chunks != 0 || file_size != expected_size)
+    {
+        throw runtime_error("check_manifest: the file does not match its manifest.");
     }
 }
 
@@ -396,30 +4854,89 @@ static void print_constants()
     cout << "V_SIZE=" << V_SIZE << endl;
     cout << "CONNECT_Q=" << CONNECT_Q << endl;
     cout << "NUMBER_OF_POSSIBLE_COLUMNS=" << NUMBER_OF_POSSIBLE_COLUMNS << endl;
-    cout << "NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION=" << NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION << endl;
+    cout << "NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION=" << key_to_decimal_string(NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION) << endl;
     cout << "NUM_BASE62_BOARD_DIGITS=" << NUM_BASE62_BOARD_DIGITS << endl;
     cout << "NUM_BASE256_BOARD_DIGITS=" << NUM_BASE256_BOARD_DIGITS << endl;
+    cout << "NUM_SCORE_OCTETS=" << NUM_SCORE_OCTETS << endl;
 }
 
 static void print_usage()
 {
     cerr                                                                                                                                     << endl;
-    cerr << "Usage: connect4 --MODE <filename> [<filename>...]"                                                                              << endl;
+    cerr << "Usage: connect4 [--wdl-only] [--table-OPTION=<n> ...] --MODE <filename> [<filename>...]"                                        << endl;
     cerr                                                                                                                                     << endl;
     cerr << "The following file-processing modes are available:"                                                                             << endl;
     cerr                                                                                                                                     << endl;
     cerr << "    connect4 --make-initial-node                                                            <out:nodes-without-score(0)>"       << endl;
-    cerr << "    connect4 --make-nodes            <in:nodes-without-score(n)>                            <out:nodes-without-score(n+1)>"     << endl;
+    cerr << "    connect4 --make-nodes            <in:nodes-without-score(n)>                            <out:runs(n+1)> [<out:run-index> [<buffer-mib>]]" << endl;
+    cerr << "    connect4 --merge-runs            <in:runs(n+1)> <in:run-index>                          <out:nodes-without-score(n+1)>"     << endl;
+    cerr << "    connect4 --make-nodes-partitioned <in:nodes-without-score(n)> <out:nodes-without-score(n+1)> <partitions>"                  << endl;
+    cerr << "    connect4 --coordinator           <in:nodes-without-score(n)> <out:nodes-without-score(n+1)> <shards> <workers>"             << endl;
+    cerr << "    connect4 --plan                  <in:log>                                               <generation>"                       << endl;
     cerr << "    connect4 --make-edges            <in:nodes-without-score(n)>                            <out:edges-without-score(n)>"       << endl;
+    cerr << "    connect4 --make-compact-edges    <in:nodes-without-score(n)>                            <out:edges-without-score(n)>"       << endl;
     cerr << "    connect4 --make-edges-with-score <in:edges-without-score(n)> <in:nodes-with-score(n+1)> <out:edges-with-score(n)>"          << endl;
+    cerr << "    connect4 --make-parent-edges-with-score <in:nodes-with-score(n+1)>                      <out:edges-with-score(n)>"          << endl;
     cerr << "    connect4 --make-nodes-with-score <in:nodes-without-score(n)> <in:edges-with-score(n)>   <out:nodes-with-score(n)>"          << endl;
+    cerr << "    connect4 --make-profile-nodes    <in:nodes-without-score(n)>                            <out:profile-nodes-without-score(n)>" << endl;
+    cerr << "    connect4 --make-nodes-by-profile <in:profile-nodes-without-score(n)>                    <out:profile-nodes-without-score(n+1)>" << endl;
+    cerr << "    connect4 --make-nodes-with-score-by-profile <in:profile-nodes-without-score(n)> <in:profile-nodes-with-score(n+1)> <out:profile-nodes-with-score(n)>" << endl;
+    cerr << "    connect4 --profile-nodes-to-nodes <in:profile-nodes>                                    <out:nodes-file>"                   << endl;
     cerr << "    connect4 --make-binary-file      <in:nodes-file>                                        <out:nodes-file-binary>"            << endl;
+    cerr << "    connect4 --make-wdl-file         <in:nodes-file-binary>               <out:keys-file-binary> <out:wdl-file>"                << endl;
+    cerr << "    connect4 --combine               <out:nodes-file-binary> <out:summary> <in:nodes-with-score(0)> [...]"                      << endl;
+    cerr << "    connect4 --solve-in-memory       <out:nodes-file-binary> <out:summary>"                                                     << endl;
+    cerr << "    connect4 --make-partitioned-db   <out:partitioned-db> <in:nodes-with-score(0)> [<in:nodes-with-score(1)> ...]"              << endl;
+    cerr << "    connect4 --make-even-db          <in:nodes-file-binary>                                 <out:partitioned-db> [even|odd]"    << endl;
     cerr << "    connect4 --print-info            <in:nodes-file-binary>"                                                                    << endl;
+    cerr << "    connect4 --search                <in:positions>                                         <out:scores> [<in:table> <max-gen>]" << endl;
+    cerr << "    connect4 --build-filter          <in:nodes-file-binary> <out:filter> <false-positive-rate>"                                 << endl;
+    cerr << "    connect4 --lookup                <in:nodes-file-binary> <in:positions>                  <out:scores>"                       << endl;
+    cerr << "    connect4 --best-moves            <in:nodes-file-binary> <in:positions>                  <out:moves>"                        << endl;
+    cerr << "    connect4 --pv                    <in:nodes-file-binary> <in:positions>                  <out:principal-variations>"         << endl;
+    cerr << "    connect4 --extract-book          <in:nodes-file-binary> <out:book> <max-moves> optimal|any"                                 << endl;
+    cerr << "    connect4 --export-training       <in:nodes-file-binary> <out:training> <sample-rate> <seed> [uniform|stratified]"           << endl;
+    cerr << "    connect4 --compress              <in:nodes-file-binary>                                 <out:compressed> [<preset>]"        << endl;
+    cerr << "    connect4 --decompress            <in:compressed>                                        <out:nodes-file-binary> [<first-block> <blocks>]" << endl;
+    cerr << "    connect4 --print-blocks          <in:compressed>"                                                                           << endl;
+    cerr << "    connect4 --make-manifest         <in:file>                                              <out:manifest> [<chunk-mib>]"       << endl;
+    cerr << "    connect4 --check-manifest        <in:file>                                              <in:manifest>"                      << endl;
+    cerr << "    connect4 --pack-nodes            <in:nodes-file>                                        <out:nodes-file-packed>"            << endl;
+    cerr << "    connect4 --unpack-nodes          <in:nodes-file>                                        <out:nodes-file>"                   << endl;
+    cerr << "    connect4 --count-nodes           <in:nodes-file>"                                                                           << endl;
     cerr                                                                                                                                     << endl;
     cerr << "    Note: "                                                                                                                     << endl;
     cerr                                                                                                                                     << endl;
     cerr << "       If an input filename is given as '"  << InputFile::stdin_name   << "', the program reads from stdin instead of a file."  << endl;
     cerr << "       If an output filename is given as '" << OutputFile::stdout_name << "', the program writes to stdout instead of a file."  << endl;
+    cerr << "       If the mode is preceded by --wdl-only, only the outcome (win/draw/loss) is tracked; all plies are set to zero."          << endl;
+    cerr << "       Input node files can be in either the text or the packed format."                                                        << endl;
+    cerr << "       The --print-info, --search, --lookup, --best-moves, and --pv modes also accept a partitioned database as their table."   << endl;
+    cerr << "       The --make-even-db mode keeps one parity of generations; lookups derive the other parity from the children of a board."  << endl;
+    cerr << "       The --make-compact-edges mode writes each edge as its destination and a move; --make-edges-with-score accepts both forms." << endl;
+    cerr << "       The --make-manifest mode hashes chunks (default 64 MiB) in parallel; --check-manifest reports each chunk that differs."  << endl;
+    cerr << "       The --pv mode writes the line of optimal moves from each position to the end of the game, with the score at each ply."   << endl;
+    cerr << "       By default, tables are memory-mapped. With --table-cache-mib, they are read through a block cache of the given size,"    << endl;
+    cerr << "       in which the first binary search levels (--table-pin-levels) and the sections of the first generations of a"             << endl;
+    cerr << "       partitioned database (--table-pin-generations) can be pinned. Cache statistics are written to stderr."                   << endl;
+    cerr << "       With --table-filter=<filter>, a filter made by --build-filter is consulted before the table."                            << endl;
+    cerr << "       Positions are given as move sequences, e.g. 4453, with columns numbered from 1; '-' is the empty board."                 << endl;
+    cerr << "       The --make-nodes mode writes sorted runs without duplicates, of the children of parents that fit in a buffer of"         << endl;
+    cerr << "       <buffer-mib> MiB (default 256). The --merge-runs mode merges them, given the run index; the runs must be a regular file." << endl;
+    cerr << "       If there are more runs than files that can be open, it first merges groups of runs through temporary files in TMPDIR."  << endl;
+    cerr << "       The --make-nodes-partitioned mode writes its temporary spill files to the directory given by TMPDIR."                    << endl;
+    cerr << "       With --memory-limit-mib=<n>, it only processes partitions in parallel while their estimated memory fits in n MiB."       << endl;
+    cerr << "       The --coordinator mode runs connect4 --worker processes, that exchange the shards through files in TMPDIR."              << endl;
+    cerr << "       The --plan mode plans a generation from the board counts in the script's log file, and the memory, threads, and"         << endl;
+    cerr << "       free space in TMPDIR and DATADIR. It writes bash assignments to stdout. --memory-limit-mib overrides the memory."        << endl;
+    cerr << "       The --extract-book mode walks the game tree up to boards with <max-moves> chips, following optimal or all moves."        << endl;
+    cerr << "       The --export-training mode writes a deterministic sample of the table as bit-plane records (see training_data.h)."       << endl;
+    cerr << "       The --compress mode compresses independent blocks in parallel; the preset (0-9, default 6) is as for xz."                << endl;
+    cerr << "       The --decompress mode can decompress a range of blocks; --print-blocks shows the first key of each block."               << endl;
+    cerr << "       The --solve-in-memory mode solves the game in memory, and writes the number of boards per generation to stdout."         << endl;
+    cerr << "       The --combine mode requires its inputs and its binary output to be regular files, rather than stdin/stdout."             << endl;
+    cerr << "       The profile-nodes files hold a generation in buckets by column-height profile (see height_profile.h); the"               << endl;
+    cerr << "       --make-nodes-by-profile and --make-nodes-with-score-by-profile modes process one bucket at a time, in parallel."         << endl;
     cerr                                                                                                                                     << endl;
     cerr << "Compile-time constant can be printed as follows:"                                                                               << endl;
     cerr                                                                                                                                     << endl;
@@ -427,11 +4944,68 @@ static void print_usage()
     cerr                                                                                                                                     << endl;
 }
 
+static bool option_value(const string & arg, const string & name, string & value)
+{
+    // Check if a command line argument has the form <name>=<value>; if so, extract the value.
+
+    if (arg.size() > name.size() && arg.compare(0, name.size(), name) == 0 && arg[name.size()] == '=')
+    {
+        value = arg.substr(name.size() + 1);
+        return true;
+    }
+
+    return false;
+}
+
 int main(int argc, char **argv)
 {
     // Copy command-line arguments into a string vector.
 
-    const vector<string> args(argv + 1, argv + argc);
+    vector<string> args(argv + 1, argv + argc);
+
+    // Options may precede the operation.
+
+    bool wdl_only = false;
+
+    TableOptions table_options{0, 0, -1, ""};
+
+    uint64_t memory_limit = 0;
+
+    while (!args.empty())
+    {
+        string value;
+
+        if (args[0] == "--wdl-only")
+        {
+            wdl_only = true;
+        }
+        else if (option_value(args[0], "--table-cache-mib", value))
+        {
+            table_options.cache_size = stoull(value) << 20;
+        }
+        else if (option_value(args[0], "--table-pin-levels", value))
+        {
+            table_options.pin_levels = stoul(value);
+        }
+        else if (option_value(args[0], "--table-pin-generations", value))
+        {
+            table_options.pin_generations = stoi(value);
+        }
+        else if (option_value(args[0], "--table-filter", value))
+        {
+            table_options.filter_filename = value;
+        }
+        else if (option_value(args[0], "--memory-limit-mib", value))
+        {
+            memory_limit = stoull(value) << 20;
+        }
+        else
+        {
+            break;
+        }
+
+        args.erase(args.begin());
+    }
 
     // The first command line argument should be the desired operation, and will be followed
     // by one or more arguments indicating filenames to use for input and/or output.
@@ -442,28 +5016,188 @@ int main(int argc, char **argv)
     }
     else if (args.size() == 3 && args[0] == "--make-nodes")
     {
-        make_nodes(args[1], args[2]);
+        make_nodes(args[1], args[2], "", DEFAULT_MAKE_NODES_BUFFER_SIZE);
+    }
+    else if (args.size() == 4 && args[0] == "--make-nodes")
+    {
+        make_nodes(args[1], args[2], args[3], DEFAULT_MAKE_NODES_BUFFER_SIZE);
+    }
+    else if (args.size() == 5 && args[0] == "--make-nodes")
+    {
+        make_nodes(args[1], args[2], args[3], stoull(args[4]) << 20);
+    }
+    else if (args.size() == 4 && args[0] == "--merge-runs")
+    {
+        merge_runs(args[1], args[2], args[3]);
+    }
+    else if (args.size() == 4 && args[0] == "--make-nodes-partitioned")
+    {
+        make_nodes_partitioned(args[1], args[2], unsigned_argument(args[3]), memory_limit);
+    }
+    else if (args.size() == 5 && args[0] == "--coordinator")
+    {
+        coordinator(args[1], args[2], stoul(args[3]), stoul(args[4]));
+    }
+    else if (args.size() == 8 && args[0] == "--worker" && args[1] == "expand")
+    {
+        worker_expand(args[2], decimal_string_to_key(args[3]), decimal_string_to_key(args[4]), args[5], stoul(args[6]), stoul(args[7]));
+    }
+    else if (args.size() == 5 && args[0] == "--worker" && args[1] == "dedup")
+    {
+        worker_dedup(args[2], stoul(args[3]), stoul(args[4]));
+    }
+    else if (args.size() == 3 && args[0] == "--plan")
+    {
+        plan(args[1], stoul(args[2]), memory_limit);
     }
     else if (args.size() == 3 && args[0] == "--make-edges")
     {
         make_edges(args[1], args[2]);
     }
+    else if (args.size() == 3 && args[0] == "--make-compact-edges")
+    {
+        make_compact_edges(args[1], args[2]);
+    }
     else if (args.size() == 4 && args[0] == "--make-edges-with-score")
     {
         make_edges_with_score(args[1], args[2], args[3]);
     }
+    else if (args.size() == 3 && args[0] == "--make-parent-edges-with-score")
+    {
+        make_parent_edges_with_score(args[1], args[2]);
+    }
     else if (args.size() == 4 && args[0] == "--make-nodes-with-score")
     {
-        make_nodes_with_score(args[1], args[2], args[3]);
+        make_nodes_with_score(args[1], args[2], args[3], wdl_only);
     }
     else if (args.size() == 3 && args[0] == "--make-binary-file")
     {
         make_binary_file(args[1], args[2]);
     }
+    else if (args.size() == 4 && args[0] == "--make-wdl-file")
+    {
+        make_wdl_file(args[1], args[2], args[3]);
+    }
+    else if (args.size() >= 4 && args[0] == "--combine")
+    {
+        combine(args[1], args[2], vector<string>(args.begin() + 3, args.end()));
+    }
+    else if (args.size() == 3 && args[0] == "--solve-in-memory")
+    {
+        solve_in_memory(args[1], args[2], wdl_only);
+    }
+    else if (args.size() >= 3 && args[0] == "--make-partitioned-db")
+    {
+        make_partitioned_db(args[1], vector<string>(args.begin() + 2, args.end()));
+    }
+    else if (args.size() == 3 && args[0] == "--make-even-db")
+    {
+        make_even_db(args[1], args[2], "even");
+    }
+    else if (args.size() == 4 && args[0] == "--make-even-db")
+    {
+        make_even_db(args[1], args[2], args[3]);
+    }
     else if (args.size() == 2 && args[0] == "--print-info")
     {
         print_info(args[1]);
     }
+    else if (args.size() == 3 && args[0] == "--search")
+    {
+        search(args[1], args[2], "", 0, table_options);
+    }
+    else if (args.size() == 5 && args[0] == "--search")
+    {
+        search(args[1], args[2], args[3], stoul(args[4]), table_options);
+    }
+    else if (args.size() == 4 && args[0] == "--build-filter")
+    {
+        build_filter(args[1], args[2], stod(args[3]));
+    }
+    else if (args.size() == 4 && args[0] == "--lookup")
+    {
+        lookup(args[1], args[2], args[3], table_options);
+    }
+    else if (args.size() == 4 && args[0] == "--best-moves")
+    {
+        best_moves(args[1], args[2], args[3], table_options);
+    }
+    else if (args.size() == 4 && args[0] == "--pv")
+    {
+        principal_variations(args[1], args[2], args[3], table_options);
+    }
+    else if (args.size() == 5 && args[0] == "--extract-book")
+    {
+        extract_book(args[1], args[2], stoul(args[3]), args[4], table_options);
+    }
+    else if (args.size() == 5 && args[0] == "--export-training")
+    {
+        export_training(args[1], args[2], stod(args[3]), stoull(args[4]), "uniform");
+    }
+    else if (args.size() == 6 && args[0] == "--export-training")
+    {
+        export_training(args[1], args[2], stod(args[3]), stoull(args[4]), args[5]);
+    }
+    else if (args.size() == 3 && args[0] == "--make-profile-nodes")
+    {
+        make_profile_nodes(args[1], args[2]);
+    }
+    else if (args.size() == 3 && args[0] == "--make-nodes-by-profile")
+    {
+        make_nodes_by_profile(args[1], args[2]);
+    }
+    else if (args.size() == 4 && args[0] == "--make-nodes-with-score-by-profile")
+    {
+        make_nodes_with_score_by_profile(args[1], args[2], args[3], wdl_only);
+    }
+    else if (args.size() == 3 && args[0] == "--profile-nodes-to-nodes")
+    {
+        profile_nodes_to_nodes(args[1], args[2]);
+    }
+    else if (args.size() == 3 && args[0] == "--make-manifest")
+    {
+        make_manifest(args[1], args[2], DEFAULT_MANIFEST_CHUNK_SIZE);
+    }
+    else if (args.size() == 4 && args[0] == "--make-manifest")
+    {
+        make_manifest(args[1], args[2], stoull(args[3]) << 20);
+    }
+    else if (args.size() == 3 && args[0] == "--check-manifest")
+    {
+        check_manifest(args[1], args[2]);
+    }
+    else if (args.size() == 3 && args[0] == "--compress")
+    {
+        compress_table(args[1], args[2], COMPRESSED_TABLE_PRESET);
+    }
+    else if (args.size() == 4 && args[0] == "--compress")
+    {
+        compress_table(args[1], args[2], stoul(args[3]));
+    }
+    else if (args.size() == 3 && args[0] == "--decompress")
+    {
+        decompress_table(args[1], args[2], 0, UINT64_MAX);
+    }
+    else if (args.size() == 5 && args[0] == "--decompress")
+    {
+        decompress_table(args[1], args[2], stoull(args[3]), stoull(args[4]));
+    }
+    else if (args.size() == 2 && args[0] == "--print-blocks")
+    {
+        print_blocks(args[1]);
+    }
+    else if (args.size() == 3 && args[0] == "--pack-nodes")
+    {
+        pack_nodes(args[1], args[2]);
+    }
+    else if (args.size() == 3 && args[0] == "--unpack-nodes")
+    {
+        unpack_nodes(args[1], args[2]);
+    }
+    else if (args.size() == 2 && args[0] == "--count-nodes")
+    {
+        count_nodes(args[1]);
+    }
     else if (args.size() == 1 && args[0] == "--print-constants")
     {
         print_constants();
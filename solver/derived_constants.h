@@ -6,6 +6,9 @@
 #ifndef DERIVED_CONSTANTS_H
 #define DERIVED_CONSTANTS_H
 
+#include <cstdint>
+#include <type_traits>
+
 #include "board_size.h"
 #include "number_of_possible_columns.h"
 
@@ -14,29 +17,57 @@
 // * A constant that holds the number of possible distinct columns, and the number
 //   of possible representable boards in a representation based on those;
 //
+// * The BoardKey type, that holds a board in that representation: a 64-bit unsigned integer if
+//   all boards fit in 64 bits (as is the case up to the 8x7 board), and a 128-bit unsigned
+//   integer otherwise;
+//
 // * Constants that define the storage size of a Board when representing it in the base-62
-//   ASCII representation (see base62.h) and the base-256 binary representation.
+//   ASCII representation (see base62.h) and the base-256 binary representation;
+//
+// * Constants that define the storage size of a Score: the largest ply is the number of board
+//   entries, and the Score is stored in one octet if that fits in its 6-bit ply field, and in two
+//   octets (with a 14-bit ply field) otherwise (see score.h);
+//
+// * The size of a record in a binary nodes file: a board key, followed by a score.
 //
 // To calculate those, we need the `number_of_possible_columns` constexpr function that we
 // include from "number_of_possible_columns.h", and two additional constexpr functions
-// `power` and `num_digits_required`.
+// `power` and `num_digits_required`. These compute in 128 bits, so that they can determine
+// whether 64 bits suffice.
+
+using uint128_t = unsigned __int128;
 
-constexpr uint64_t power(unsigned a, unsigned b)
+constexpr uint128_t power(unsigned a, unsigned b)
 {
     return (b == 0) ? 1 : a * power(a, b - 1);
 }
 
-constexpr unsigned number_of_digits_required(unsigned base, uint64_t count)
+constexpr unsigned number_of_digits_required(unsigned base, uint128_t count)
 {
     // Find the smallest value 'digits' such that power(base, digits) >= count.
 
     return (count <= 1) ? 0 : 1 + number_of_digits_required(base, (count + base - 1) / base);
 }
 
-const unsigned NUMBER_OF_POSSIBLE_COLUMNS = number_of_possible_columns(CONNECT_Q, V_SIZE);
-const uint64_t NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION = power(NUMBER_OF_POSSIBLE_COLUMNS, H_SIZE);
+const unsigned  NUMBER_OF_POSSIBLE_COLUMNS = number_of_possible_columns(CONNECT_Q, V_SIZE);
+const uint128_t NUMBER_OF_BOARDS_WIDE      = power(NUMBER_OF_POSSIBLE_COLUMNS, H_SIZE);
+
+static_assert(number_of_digits_required(2, NUMBER_OF_BOARDS_WIDE) < 128, "The board keys must fit in 128 bits.");
+
+using BoardKey = std::conditional<NUMBER_OF_BOARDS_WIDE <= UINT64_MAX, uint64_t, uint128_t>::type;
+
+const BoardKey NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION = NUMBER_OF_BOARDS_WIDE;
 
 const unsigned NUM_BASE62_BOARD_DIGITS  = number_of_digits_required( 62, NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION);
 const unsigned NUM_BASE256_BOARD_DIGITS = number_of_digits_required(256, NUMBER_OF_BOARDS_IN_COLUMN_REPRESENTATION);
 
+const unsigned MAX_PLY = H_SIZE * V_SIZE;
+
+const unsigned NUM_SCORE_OCTETS       = (MAX_PLY <= 0x3f) ? 1 : 2;
+const unsigned NUM_BASE62_PLY_DIGITS  = (MAX_PLY < 62) ? 1 : 2;
+
+using ScoreCode = std::conditional<NUM_SCORE_OCTETS == 1, uint8_t, uint16_t>::type;
+
+const unsigned BINARY_RECORD_SIZE = NUM_BASE256_BOARD_DIGITS + NUM_SCORE_OCTETS;
+
 #endif // DERIVED_CONSTANTS_H
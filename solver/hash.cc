@@ -0,0 +1,244 @@
+
+/////////////
+// hash.cc //
+/////////////
+
+#include <cstring>
+
+#include "hash.h"
+
+uint64_t fnv1a_64(const uint8_t * data, size_t size, uint64_t state)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        state ^= data[i];
+        state *= 0x100000001b3ULL;
+    }
+    return state;
+}
+
+uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t fold_key(BoardKey key)
+{
+    uint64_t folded = static_cast<uint64_t>(key);
+
+    for (unsigned i = sizeof(uint64_t); i < sizeof(BoardKey); i += sizeof(uint64_t))
+    {
+        // Shift in two steps, since a single 64-bit shift is undefined for 64-bit keys.
+        key = (key >> 32) >> 32;
+        folded = mix64(folded) ^ static_cast<uint64_t>(key);
+    }
+
+    return folded;
+}
+
+static inline uint64_t rotl64(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t load_u64_le(const uint8_t * p)
+{
+    uint64_t x = 0;
+    for (unsigned i = 8; i != 0; --i)
+    {
+        x = (x << 8) | p[i - 1];
+    }
+    return x;
+}
+
+static inline uint32_t load_u32_le(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+constexpr uint64_t XXH_PRIME64_1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t XXH_PRIME64_2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667b19e3779f9ULL;
+constexpr uint64_t XXH_PRIME64_4 = 0x85ebca77c2b2ae63ULL;
+constexpr uint64_t XXH_PRIME64_5 = 0x27d4eb2f165667c5ULL;
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t value)
+{
+    acc ^= xxh64_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t xxh64(const uint8_t * data, size_t size)
+{
+    const uint8_t * p   = data;
+    const uint8_t * end = data + size;
+
+    uint64_t h;
+
+    if (size >= 32)
+    {
+        uint64_t v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = XXH_PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = -XXH_PRIME64_1;
+
+        do
+        {
+            v1 = xxh64_round(v1, load_u64_le(p));
+            v2 = xxh64_round(v2, load_u64_le(p + 8));
+            v3 = xxh64_round(v3, load_u64_le(p + 16));
+            v4 = xxh64_round(v4, load_u64_le(p + 24));
+            p += 32;
+        }
+        while (end - p >= 32);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    }
+    else
+    {
+        h = XXH_PRIME64_5;
+    }
+
+    h += size;
+
+    while (end - p >= 8)
+    {
+        h ^= xxh64_round(0, load_u64_le(p));
+        h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4)
+    {
+        h ^= load_u32_le(p) * XXH_PRIME64_1;
+        h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        h ^= *p * XXH_PRIME64_5;
+        h = rotl64(h, 11) * XXH_PRIME64_1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+static inline uint32_t rotr32(uint32_t x, unsigned r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256_block(uint32_t * state, const uint8_t * block)
+{
+    uint32_t w[64];
+
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        w[i] = (uint32_t(block[4 * i]) << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+
+    for (unsigned i = 16; i < 64; ++i)
+    {
+        const uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        const uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        const uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256(const uint8_t * data, size_t size, uint8_t * digest)
+{
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    size_t offset = 0;
+
+    for (; offset + 64 <= size; offset += 64)
+    {
+        sha256_block(state, data + offset);
+    }
+
+    // Pad the remaining bytes with a one bit, zeros, and the message length in bits (big-endian),
+    // into one or two final blocks.
+
+    uint8_t tail[128] = {};
+
+    const size_t remaining = size - offset;
+
+    memcpy(tail, data + offset, remaining);
+    tail[remaining] = 0x80;
+
+    const size_t tail_size = (remaining < 56) ? 64 : 128;
+    const uint64_t bit_length = static_cast<uint64_t>(size) * 8;
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        tail[tail_size - 1 - i] = (bit_length >> (8 * i)) & 255;
+    }
+
+    for (size_t block = 0; block < tail_size; block += 64)
+    {
+        sha256_block(state, tail + block);
+    }
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        digest[4 * i + 0] = (state[i] >> 24) & 255;
+        digest[4 * i + 1] = (state[i] >> 16) & 255;
+        digest[4 * i + 2] = (state[i] >>  8) & 255;
+        digest[4 * i + 3] = (state[i] >>  0) & 255;
+    }
+}
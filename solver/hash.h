@@ -0,0 +1,59 @@
+
+////////////
+// hash.h //
+////////////
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "derived_constants.h"
+
+// The initial state of the 64-bit FNV-1a hash.
+constexpr uint64_t FNV1A_64_INITIAL_STATE = 0xcbf29ce484222325ULL;
+
+// Update a 64-bit FNV-1a hash state with a number of bytes, and return the new state.
+// The hash of a sequence of bytes can be computed incrementally, by feeding it in pieces.
+//
+// FNV-1a is not a cryptographic hash; it is used to detect accidental corruption of data files.
+
+uint64_t fnv1a_64(const uint8_t * data, size_t size, uint64_t state = FNV1A_64_INITIAL_STATE);
+
+// Mix the bits of a 64-bit value, such that every input bit affects every output bit (the SplitMix64 finalizer).
+// This turns board keys, which are highly structured, into well-distributed hash values.
+
+uint64_t mix64(uint64_t x);
+
+// Fold a BoardKey into 64 bits. A key that fits in 64 bits is returned unchanged; otherwise, the high bits
+// are mixed into the low bits.
+
+uint64_t fold_key(BoardKey key);
+
+// A hash function object for BoardKeys, for use in unordered containers. The standard library has no hash for
+// 128-bit integers, and hashing the key modulo 2**64 would make keys that differ by a multiple of 2**64 collide.
+
+struct BoardKeyHash {
+    size_t operator () (BoardKey key) const
+    {
+        return mix64(fold_key(key));
+    }
+};
+
+// The 64-bit xxHash (XXH64) of a number of bytes, with a seed of zero. Unlike FNV-1a, it processes 32 bytes per
+// step in four independent lanes, so it runs at memory speed. It is used to hash the chunks of a manifest.
+//
+// XXH64 is not a cryptographic hash either; it is used to detect accidental corruption of data files.
+
+uint64_t xxh64(const uint8_t * data, size_t size);
+
+// The size of a SHA-256 digest, in bytes.
+constexpr unsigned SHA256_DIGEST_SIZE = 32;
+
+// The SHA-256 digest of a number of bytes. This is used for the Merkle root of a manifest, so that the root can be
+// recomputed with standard tools.
+
+void sha256(const uint8_t * data, size_t size, uint8_t * digest);
+
+#endif // HASH_H
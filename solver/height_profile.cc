@@ -0,0 +1,374 @@
+
+///////////////////////
+// height_profile.cc //
+///////////////////////
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "little_endian.h"
+#include "hash.h"
+#include "height_profile.h"
+
+using namespace std;
+
+constexpr unsigned HEADER_FIXED_SIZE = 48;
+constexpr unsigned HEADER_BUCKET_SIZE = 32;
+
+uint64_t height_profile(const unsigned * heights)
+{
+    uint64_t profile = 0;
+
+    for (unsigned x = 0; x < H_SIZE; ++x)
+    {
+        profile = profile * (V_SIZE + 1) + heights[x];
+    }
+
+    return profile;
+}
+
+uint64_t normalized_height_profile(const unsigned * heights)
+{
+    uint64_t profile = 0;
+    uint64_t mirrored_profile = 0;
+
+    for (unsigned x = 0; x < H_SIZE; ++x)
+    {
+        profile          = profile          * (V_SIZE + 1) + heights[x];
+        mirrored_profile = mirrored_profile * (V_SIZE + 1) + heights[H_SIZE - 1 - x];
+    }
+
+    return min(profile, mirrored_profile);
+}
+
+void height_profile_heights(uint64_t profile, unsigned * heights)
+{
+    for (int x = H_SIZE - 1; x >= 0; --x)
+    {
+        heights[x] = profile % (V_SIZE + 1);
+        profile /= (V_SIZE + 1);
+    }
+}
+
+static vector<uint64_t> adjacent_height_profiles(uint64_t profile, int delta)
+{
+    unsigned heights[H_SIZE];
+    height_profile_heights(profile, heights);
+
+    vector<uint64_t> profiles;
+
+    for (unsigned x = 0; x < H_SIZE; ++x)
+    {
+        if ((delta > 0 && heights[x] < V_SIZE) || (delta < 0 && heights[x] > 0))
+        {
+            heights[x] += delta;
+            profiles.push_back(normalized_height_profile(heights));
+            heights[x] -= delta;
+        }
+    }
+
+    sort(profiles.begin(), profiles.end());
+    profiles.erase(unique(profiles.begin(), profiles.end()), profiles.end());
+
+    return profiles;
+}
+
+vector<uint64_t> child_height_profiles(uint64_t profile)
+{
+    return adjacent_height_profiles(profile, +1);
+}
+
+vector<uint64_t> parent_height_profiles(uint64_t profile)
+{
+    return adjacent_height_profiles(profile, -1);
+}
+
+void HeightProfiler::heights(BoardKey key, unsigned * heights) const
+{
+    for (int x = H_SIZE - 1; x >= 0; --x)
+    {
+        heights[x] = column_chips.height(key % NUMBER_OF_POSSIBLE_COLUMNS);
+        key /= NUMBER_OF_POSSIBLE_COLUMNS;
+    }
+}
+
+uint64_t HeightProfiler::normalized_profile(BoardKey key) const
+{
+    unsigned key_heights[H_SIZE];
+    heights(key, key_heights);
+    return normalized_height_profile(key_heights);
+}
+
+uint64_t height_profile_file_header_size(uint64_t num_buckets)
+{
+    return HEADER_FIXED_SIZE + HEADER_BUCKET_SIZE * num_buckets + 8;
+}
+
+vector<uint8_t> encode_height_profile_file_header(unsigned generation, const vector<HeightProfileBucket> & buckets)
+{
+    vector<uint8_t> header(height_profile_file_header_size(buckets.size()), 0);
+
+    memcpy(header.data(), HEIGHT_PROFILE_FILE_MAGIC, HEIGHT_PROFILE_FILE_MAGIC_SIZE);
+
+    store_le(header.data() +  8, HEIGHT_PROFILE_FILE_VERSION, 4);
+    store_le(header.data() + 12, H_SIZE                     , 4);
+    store_le(header.data() + 16, V_SIZE                     , 4);
+    store_le(header.data() + 20, CONNECT_Q                  , 4);
+    store_le(header.data() + 24, NUM_BASE256_BOARD_DIGITS   , 4);
+    store_le(header.data() + 28, BINARY_RECORD_SIZE         , 4);
+    store_le(header.data() + 32, generation                 , 4);
+    store_le(header.data() + 40, buckets.size()             , 8);
+
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        uint8_t * entry = header.data() + HEADER_FIXED_SIZE + HEADER_BUCKET_SIZE * i;
+
+        store_le(entry +  0, buckets[i].profile , 8);
+        store_le(entry +  8, buckets[i].offset  , 8);
+        store_le(entry + 16, buckets[i].count   , 8);
+        store_le(entry + 24, buckets[i].checksum, 8);
+    }
+
+    store_le(header.data() + header.size() - 8, fnv1a_64(header.data(), header.size() - 8), 8);
+
+    return header;
+}
+
+uint64_t encode_height_profile_records(const vector<BoardKey> & keys, const vector<ScoreCode> & scores, vector<uint8_t> & data)
+{
+    data.resize(keys.size() * BINARY_RECORD_SIZE);
+
+    uint8_t * record = data.data();
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        BoardKey key = keys[i];
+        for (unsigned j = 0; j < NUM_BASE256_BOARD_DIGITS; ++j)
+        {
+            record[NUM_BASE256_BOARD_DIGITS - 1 - j] = key & 255;
+            key >>= 8;
+        }
+
+        // The score is stored in big-endian order, as by Score::store.
+        ScoreCode code = scores[i];
+        for (unsigned j = 0; j < NUM_SCORE_OCTETS; ++j)
+        {
+            record[BINARY_RECORD_SIZE - 1 - j] = code & 255;
+            code >>= 8;
+        }
+
+        record += BINARY_RECORD_SIZE;
+    }
+
+    return fnv1a_64(data.data(), data.size());
+}
+
+static void read_fully(int fd, uint8_t * data, uint64_t size, uint64_t offset)
+{
+    uint64_t done = 0;
+
+    while (done < size)
+    {
+        const ssize_t result = pread(fd, data + done, size - done, offset + done);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw runtime_error("HeightProfileFile: read error.");
+        }
+
+        if (result == 0)
+        {
+            throw runtime_error("HeightProfileFile: unexpected end of file.");
+        }
+
+        done += result;
+    }
+}
+
+HeightProfileFile::HeightProfileFile(const string & filename) :
+    fd(-1), generation(0)
+{
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("HeightProfileFile: unable to open file.");
+    }
+
+    try
+    {
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) != 0)
+        {
+            throw runtime_error("HeightProfileFile: unable to stat file.");
+        }
+
+        const uint64_t file_size = statbuf.st_size;
+
+        vector<uint8_t> header(HEADER_FIXED_SIZE);
+
+        if (file_size < height_profile_file_header_size(0))
+        {
+            throw runtime_error("HeightProfileFile: file too small.");
+        }
+
+        read_fully(fd, header.data(), HEADER_FIXED_SIZE, 0);
+
+        if (memcmp(header.data(), HEIGHT_PROFILE_FILE_MAGIC, HEIGHT_PROFILE_FILE_MAGIC_SIZE) != 0)
+        {
+            throw runtime_error("HeightProfileFile: bad magic.");
+        }
+
+        const uint64_t num_buckets = load_le(header.data() + 40, 8);
+
+        if (num_buckets > (file_size - height_profile_file_header_size(0)) / HEADER_BUCKET_SIZE)
+        {
+            throw runtime_error("HeightProfileFile: bad number of buckets.");
+        }
+
+        header.resize(height_profile_file_header_size(num_buckets));
+
+        read_fully(fd, header.data() + HEADER_FIXED_SIZE, header.size() - HEADER_FIXED_SIZE, HEADER_FIXED_SIZE);
+
+        if (load_le(header.data() + header.size() - 8, 8) != fnv1a_64(header.data(), header.size() - 8))
+        {
+            throw runtime_error("HeightProfileFile: bad header checksum.");
+        }
+
+        if (load_le(header.data() + 8, 4) != HEIGHT_PROFILE_FILE_VERSION)
+        {
+            throw runtime_error("HeightProfileFile: unsupported version.");
+        }
+
+        if (load_le(header.data() + 12, 4) != H_SIZE || load_le(header.data() + 16, 4) != V_SIZE || load_le(header.data() + 20, 4) != CONNECT_Q)
+        {
+            throw runtime_error("HeightProfileFile: file is for a different board geometry.");
+        }
+
+        if (load_le(header.data() + 24, 4) != NUM_BASE256_BOARD_DIGITS || load_le(header.data() + 28, 4) != BINARY_RECORD_SIZE)
+        {
+            throw runtime_error("HeightProfileFile: unexpected record layout.");
+        }
+
+        generation = load_le(header.data() + 32, 4);
+
+        if (generation > H_SIZE * V_SIZE)
+        {
+            throw runtime_error("HeightProfileFile: bad generation.");
+        }
+
+        buckets.resize(num_buckets);
+
+        uint64_t expected_offset = header.size();
+
+        for (uint64_t i = 0; i < num_buckets; ++i)
+        {
+            const uint8_t * entry = header.data() + HEADER_FIXED_SIZE + HEADER_BUCKET_SIZE * i;
+
+            buckets[i].profile  = load_le(entry +  0, 8);
+            buckets[i].offset   = load_le(entry +  8, 8);
+            buckets[i].count    = load_le(entry + 16, 8);
+            buckets[i].checksum = load_le(entry + 24, 8);
+
+            if (i != 0 && buckets[i].profile <= buckets[i - 1].profile)
+            {
+                throw runtime_error("HeightProfileFile: buckets are not in order of profile.");
+            }
+
+            if (buckets[i].offset != expected_offset)
+            {
+                throw runtime_error("HeightProfileFile: buckets are not contiguous.");
+            }
+
+            expected_offset += buckets[i].count * BINARY_RECORD_SIZE;
+        }
+
+        if (expected_offset != file_size)
+        {
+            throw runtime_error("HeightProfileFile: file size does not match the header.");
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+HeightProfileFile::~HeightProfileFile()
+{
+    close(fd);
+}
+
+uint64_t HeightProfileFile::num_records() const
+{
+    uint64_t count = 0;
+
+    for (const HeightProfileBucket & bucket: buckets)
+    {
+        count += bucket.count;
+    }
+
+    return count;
+}
+
+const HeightProfileBucket * HeightProfileFile::find(uint64_t profile) const
+{
+    const auto it = lower_bound(buckets.begin(), buckets.end(), profile, [](const HeightProfileBucket & bucket, uint64_t p) { return bucket.profile < p; });
+
+    return (it != buckets.end() && it->profile == profile) ? &*it : nullptr;
+}
+
+void HeightProfileFile::read_bucket(const HeightProfileBucket & bucket, vector<BoardKey> & keys, vector<ScoreCode> & scores,
+                                    uint64_t first, uint64_t count) const
+{
+    if (first > bucket.count)
+    {
+        throw runtime_error("HeightProfileFile: bad record range.");
+    }
+
+    count = min(count, bucket.count - first);
+
+    vector<uint8_t> data(count * BINARY_RECORD_SIZE);
+
+    read_fully(fd, data.data(), data.size(), bucket.offset + first * BINARY_RECORD_SIZE);
+
+    if (first == 0 && count == bucket.count && fnv1a_64(data.data(), data.size()) != bucket.checksum)
+    {
+        throw runtime_error("HeightProfileFile: bad bucket checksum.");
+    }
+
+    keys.resize(count);
+    scores.resize(count);
+
+    const uint8_t * record = data.data();
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        BoardKey key = 0;
+        for (unsigned j = 0; j < NUM_BASE256_BOARD_DIGITS; ++j)
+        {
+            key = (key << 8) | record[j];
+        }
+
+        ScoreCode code = 0;
+        for (unsigned j = NUM_BASE256_BOARD_DIGITS; j < BINARY_RECORD_SIZE; ++j)
+        {
+            code = (code << 8) | record[j];
+        }
+
+        keys[i]   = key;
+        scores[i] = code;
+
+        record += BINARY_RECORD_SIZE;
+    }
+}
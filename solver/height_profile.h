@@ -0,0 +1,143 @@
+
+//////////////////////
+// height_profile.h //
+//////////////////////
+
+#ifndef HEIGHT_PROFILE_H
+#define HEIGHT_PROFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board_size.h"
+#include "column_encoder.h"
+#include "derived_constants.h"
+
+// The height profile of a board is the vector of its column heights, encoded as a number in base (V_SIZE + 1), with
+// the height of column 0 as its most significant digit. The normalized height profile is the smaller of the profile
+// and the profile of the mirrored board, so a board and its mirror image have the same normalized profile.
+//
+// Since a move adds a chip to a single column, the children of the boards with a given normalized profile all have
+// one of at most H_SIZE normalized profiles, and the same holds for their parents. This allows a generation to be
+// processed one profile at a time, in memory, looking only at a few profiles of the adjacent generation.
+//
+// A height-profile file holds the boards of a single generation, with a score (possibly indeterminate), divided
+// into buckets by normalized profile. Each bucket is a key-sorted array of records, each holding a big-endian board
+// key followed by a score (see Score::store), as in binary nodes files.
+//
+// The file starts with a self-describing header. All numbers in the header are stored in little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   HEIGHT_PROFILE_FILE_MAGIC
+//          8      4   format version (HEIGHT_PROFILE_FILE_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   key size in bytes (NUM_BASE256_BOARD_DIGITS)
+//         28      4   record size in bytes (BINARY_RECORD_SIZE: key size + score size)
+//         32      4   generation (the number of chips on each board)
+//         36      4   reserved (zero)
+//         40      8   number of buckets N
+//         48   32*N   for each bucket: its normalized profile, its file offset, its number of records, and the
+//                     FNV-1a hash of its records
+//    48+32*N      8   FNV-1a hash of the preceding header bytes
+//
+// The buckets follow the header, in order of increasing profile.
+
+constexpr const char * HEIGHT_PROFILE_FILE_MAGIC = "#C4HPF\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned HEIGHT_PROFILE_FILE_MAGIC_SIZE = 8;
+constexpr unsigned HEIGHT_PROFILE_FILE_VERSION    = 1;
+
+struct HeightProfileBucket {
+    uint64_t profile;
+    uint64_t offset;
+    uint64_t count;
+    uint64_t checksum;
+};
+
+// Get the height profile of a vector of H_SIZE column heights.
+uint64_t height_profile(const unsigned * heights);
+
+// Get the normalized height profile of a vector of H_SIZE column heights.
+uint64_t normalized_height_profile(const unsigned * heights);
+
+// Get the H_SIZE column heights of a height profile.
+void height_profile_heights(uint64_t profile, unsigned * heights);
+
+// Get the distinct normalized profiles of the children (parents) of the boards with a given profile, in increasing order.
+std::vector<uint64_t> child_height_profiles(uint64_t profile);
+std::vector<uint64_t> parent_height_profiles(uint64_t profile);
+
+class HeightProfiler
+{
+    // Determines the column heights of board keys, reading them directly from the key (see ColumnChips).
+
+    public:
+
+        // Get the H_SIZE column heights of a board key.
+        void heights(BoardKey key, unsigned * heights) const;
+
+        // Get the normalized height profile of a board key.
+        uint64_t normalized_profile(BoardKey key) const;
+
+    private: // Member variables.
+
+        ColumnChips column_chips;
+};
+
+// The size of the header of a file with the given number of buckets.
+uint64_t height_profile_file_header_size(uint64_t num_buckets);
+
+// Encode a header. The buckets must be in order of increasing profile, and contiguous from the end of the header.
+std::vector<uint8_t> encode_height_profile_file_header(unsigned generation, const std::vector<HeightProfileBucket> & buckets);
+
+// Encode records into 'data', replacing its contents. Returns the FNV-1a hash of the records.
+uint64_t encode_height_profile_records(const std::vector<BoardKey> & keys, const std::vector<ScoreCode> & scores, std::vector<uint8_t> & data);
+
+class HeightProfileFile
+{
+    // Read access to the buckets of a height-profile file. Buckets can be read by multiple threads concurrently.
+
+    public:
+
+        // Open a file and decode its header. Throws an exception if the header is damaged, or if it describes
+        // a file for a different board geometry than the one we are compiled for.
+        explicit HeightProfileFile(const std::string & filename);
+
+        ~HeightProfileFile();
+
+        HeightProfileFile(const HeightProfileFile &) = delete;
+        HeightProfileFile & operator = (const HeightProfileFile &) = delete;
+
+        unsigned get_generation() const
+        {
+            return generation;
+        }
+
+        const std::vector<HeightProfileBucket> & get_buckets() const
+        {
+            return buckets;
+        }
+
+        // The total number of records in all buckets.
+        uint64_t num_records() const;
+
+        // Find the bucket of a normalized profile. Returns nullptr if the file has no such bucket.
+        const HeightProfileBucket * find(uint64_t profile) const;
+
+        // Read the records of a bucket, starting at a given record, and verify their hash if the entire bucket is read.
+        void read_bucket(const HeightProfileBucket & bucket, std::vector<BoardKey> & keys, std::vector<ScoreCode> & scores,
+                         uint64_t first = 0, uint64_t count = UINT64_MAX) const;
+
+    private: // Member variables.
+
+        int fd;
+
+        unsigned                         generation;
+        std::vector<HeightProfileBucket> buckets;
+};
+
+#endif // HEIGHT_PROFILE_H
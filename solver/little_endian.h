@@ -0,0 +1,59 @@
+
+/////////////////////
+// little_endian.h //
+/////////////////////
+
+#ifndef LITTLE_ENDIAN_H
+#define LITTLE_ENDIAN_H
+
+#include <cstdint>
+
+#include "derived_constants.h"
+
+// Store the least significant 'num_bytes' bytes of a value in little-endian order.
+
+inline void store_le(uint8_t * p, uint64_t value, unsigned num_bytes)
+{
+    for (unsigned i = 0; i < num_bytes; ++i)
+    {
+        p[i] = value & 255;
+        value >>= 8;
+    }
+}
+
+// Load a value of 'num_bytes' bytes stored in little-endian order.
+
+inline uint64_t load_le(const uint8_t * p, unsigned num_bytes)
+{
+    uint64_t value = 0;
+    for (unsigned i = num_bytes; i != 0; --i)
+    {
+        value = (value << 8) | p[i - 1];
+    }
+    return value;
+}
+
+// Store the least significant 'num_bytes' bytes of a BoardKey in little-endian order.
+
+inline void store_key_le(uint8_t * p, BoardKey key, unsigned num_bytes)
+{
+    for (unsigned i = 0; i < num_bytes; ++i)
+    {
+        p[i] = key & 255;
+        key >>= 8;
+    }
+}
+
+// Load a BoardKey of 'num_bytes' bytes stored in little-endian order.
+
+inline BoardKey load_key_le(const uint8_t * p, unsigned num_bytes)
+{
+    BoardKey key = 0;
+    for (unsigned i = num_bytes; i != 0; --i)
+    {
+        key = (key << 8) | p[i - 1];
+    }
+    return key;
+}
+
+#endif // LITTLE_ENDIAN_H
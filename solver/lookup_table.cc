@@ -0,0 +1,657 @@
+
+/////////////////////
+// lookup_table.cc //
+/////////////////////
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "derived_constants.h"
+#include "partitioned_db.h"
+#include "optimal_moves.h"
+#include "wdl_file.h"
+#include "lookup_table.h"
+
+using namespace std;
+
+LookupTable::LookupTable(const string & filename, uint64_t cache_size) :
+    fd(-1), data(nullptr), size(0), number_of_records(0), record_size(BINARY_RECORD_SIZE), partitioned(false),
+    wdl(false), outcome_fd(-1), outcome_data(nullptr), outcome_size(0), generations(PARTITIONED_DB_ALL_GENERATIONS), records_offset(0)
+{
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("LookupTable: unable to open file.");
+    }
+
+    try
+    {
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) != 0)
+        {
+            throw runtime_error("LookupTable: unable to stat file.");
+        }
+
+        size = statbuf.st_size;
+
+        // The outcome file of a win/draw/loss table is mapped as a whole; the keys file is then opened in its place.
+
+        uint8_t  wdl_header[WDL_FILE_HEADER_SIZE];
+        uint64_t wdl_records = 0;
+
+        wdl = (size >= WDL_FILE_HEADER_SIZE && pread(fd, wdl_header, WDL_FILE_HEADER_SIZE, 0) == WDL_FILE_HEADER_SIZE && is_wdl_file_header(wdl_header));
+
+        if (wdl)
+        {
+            wdl_records = decode_wdl_file_header(wdl_header);
+
+            if (size != wdl_file_size(wdl_records))
+            {
+                throw runtime_error("LookupTable: bad outcome file size.");
+            }
+
+            outcome_fd   = fd;
+            outcome_size = size;
+            fd = -1;
+
+            void * mapping = mmap(nullptr, outcome_size, PROT_READ, MAP_SHARED, outcome_fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                throw runtime_error("LookupTable: unable to map outcome file.");
+            }
+            outcome_data = static_cast<const uint8_t *>(mapping);
+
+            fd = open(wdl_keys_filename(filename).c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw runtime_error("LookupTable: unable to open keys file.");
+            }
+
+            if (fstat(fd, &statbuf) != 0)
+            {
+                throw runtime_error("LookupTable: unable to stat keys file.");
+            }
+
+            size = statbuf.st_size;
+
+            record_size = NUM_BASE256_BOARD_DIGITS;
+        }
+
+        if (cache_size != 0)
+        {
+            cache = make_unique<BlockCache>(fd, size, cache_size);
+        }
+        else if (size != 0)
+        {
+            void * mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                throw runtime_error("LookupTable: unable to map file.");
+            }
+            data = static_cast<const uint8_t *>(mapping);
+        }
+
+        uint8_t first_octet = 0;
+        if (size != 0)
+        {
+            read_bytes(0, 1, &first_octet);
+        }
+
+        partitioned = (!wdl && size >= PARTITIONED_DB_HEADER_SIZE && first_octet == PARTITIONED_DB_MAGIC[0]);
+
+        if (partitioned)
+        {
+            vector<uint8_t> header(PARTITIONED_DB_HEADER_SIZE);
+            read_bytes(0, PARTITIONED_DB_HEADER_SIZE, header.data());
+
+            records_offset = PARTITIONED_DB_HEADER_SIZE;
+
+            for (const PartitionedDbSection & section: decode_partitioned_db_header(header.data()))
+            {
+                section_begin.push_back(number_of_records);
+                number_of_records += section.count;
+            }
+
+            generations = decode_partitioned_db_generations(header.data());
+        }
+        else
+        {
+            number_of_records = size / record_size;
+            section_begin.push_back(0);
+        }
+
+        section_begin.push_back(number_of_records);
+
+        if (records_offset + number_of_records * record_size != size)
+        {
+            throw runtime_error("LookupTable: bad file size.");
+        }
+
+        if (wdl && number_of_records != wdl_records)
+        {
+            throw runtime_error("LookupTable: the keys file does not match the outcome file.");
+        }
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+LookupTable::~LookupTable()
+{
+    release();
+}
+
+void LookupTable::release()
+{
+    cache.reset();
+
+    if (data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(data), size);
+        data = nullptr;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if (outcome_data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(outcome_data), outcome_size);
+        outcome_data = nullptr;
+    }
+
+    if (outcome_fd >= 0)
+    {
+        close(outcome_fd);
+        outcome_fd = -1;
+    }
+}
+
+void LookupTable::read_bytes(uint64_t offset, unsigned count, uint8_t * buffer) const
+{
+    if (cache)
+    {
+        cache->read(offset, count, buffer);
+    }
+    else
+    {
+        memcpy(buffer, data + offset, count);
+    }
+}
+
+const uint8_t * LookupTable::record_at(uint64_t index, uint8_t * buffer) const
+{
+    const uint64_t offset = records_offset + index * record_size;
+
+    if (cache)
+    {
+        cache->read(offset, record_size, buffer);
+        return buffer;
+    }
+
+    return data + offset;
+}
+
+BoardKey LookupTable::key_at(uint64_t index) const
+{
+    uint8_t buffer[BINARY_RECORD_SIZE];
+    const uint8_t * record = record_at(index, buffer);
+
+    BoardKey key = 0;
+    for (unsigned i = 0; i < NUM_BASE256_BOARD_DIGITS; ++i)
+    {
+        key = (key << 8) | record[i];
+    }
+    return key;
+}
+
+Score LookupTable::score_at(uint64_t index) const
+{
+    if (wdl)
+    {
+        return wdl_score((outcome_data[WDL_FILE_HEADER_SIZE + index / 4] >> (2 * (index % 4))) & 3);
+    }
+
+    uint8_t buffer[BINARY_RECORD_SIZE];
+    return Score::load(record_at(index, buffer) + NUM_BASE256_BOARD_DIGITS);
+}
+
+unsigned LookupTable::section_of(BoardKey key) const
+{
+    // In a partitioned database, the section of a key is the number of chips on its board.
+
+    return partitioned ? Board::from_key(key).count() : 0;
+}
+
+bool LookupTable::is_derived(BoardKey key) const
+{
+    return generations != PARTITIONED_DB_ALL_GENERATIONS && !partitioned_db_holds_generation(generations, section_of(key));
+}
+
+uint64_t LookupTable::lower_bound(BoardKey key, uint64_t first, uint64_t last) const
+{
+    while (first < last)
+    {
+        const uint64_t mid = first + (last - first) / 2;
+
+        if (key_at(mid) < key)
+        {
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid;
+        }
+    }
+    return first;
+}
+
+bool LookupTable::lookup(BoardKey key, Score & score) const
+{
+    if (is_derived(key))
+    {
+        vector<Score> scores;
+        vector<bool>  found;
+
+        lookup_batch(vector<BoardKey>{key}, scores, found);
+
+        score = scores[0];
+        return found[0];
+    }
+
+    if (filter && !filter->may_contain(key))
+    {
+        return false;
+    }
+
+    const unsigned section = section_of(key);
+
+    const uint64_t index = lower_bound(key, section_begin[section], section_begin[section + 1]);
+
+    if (index == section_begin[section + 1] || key_at(index) != key)
+    {
+        return false;
+    }
+
+    score = score_at(index);
+    return true;
+}
+
+bool LookupTable::lookup(const Board & board, Score & score) const
+{
+    return lookup(board.normalize().to_key(), score);
+}
+
+void LookupTable::lookup_sorted_batch(const vector<BoardKey> & keys, vector<Score> & scores, vector<bool> & found) const
+{
+    // Since the keys are sorted, each key is searched for starting at the position of the previous key
+    // in the same section. We use galloping search: double the step size until we pass the key, then
+    // use binary search in the last step. For keys that are close together, this only touches nearby records.
+
+    if (generations != PARTITIONED_DB_ALL_GENERATIONS)
+    {
+        // The children of derived keys are not sorted along with the other keys.
+        lookup_batch(keys, scores, found);
+        return;
+    }
+
+    scores.resize(keys.size());
+    found.assign(keys.size(), false);
+
+    vector<uint64_t> cursors(section_begin.begin(), section_begin.end() - 1);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const BoardKey key = keys[i];
+
+        if (filter && !filter->may_contain(key))
+        {
+            continue;
+        }
+
+        const unsigned section = section_of(key);
+        const uint64_t section_end = section_begin[section + 1];
+
+        uint64_t & cursor = cursors[section];
+
+        uint64_t step = 1;
+        uint64_t first = cursor;
+        uint64_t last  = cursor;
+
+        while (last < section_end && key_at(last) < key)
+        {
+            first = last + 1;
+            last = min(last + step, section_end);
+            step *= 2;
+        }
+
+        cursor = lower_bound(key, first, last);
+
+        if (cursor < section_end && key_at(cursor) == key)
+        {
+            scores[i] = score_at(cursor);
+            found[i] = true;
+        }
+    }
+}
+
+void LookupTable::prefetch_records(const vector<uint64_t> & indices) const
+{
+    if (cache)
+    {
+        vector<uint64_t> offsets;
+        offsets.reserve(indices.size());
+
+        for (const uint64_t index: indices)
+        {
+            offsets.push_back(records_offset + index * record_size);
+        }
+
+        cache->prefetch(offsets, record_size);
+    }
+    else
+    {
+        for (const uint64_t index: indices)
+        {
+            __builtin_prefetch(data + records_offset + index * record_size);
+        }
+    }
+}
+
+void LookupTable::lookup_batch(const vector<BoardKey> & keys, vector<Score> & scores, vector<bool> & found) const
+{
+    if (generations == PARTITIONED_DB_ALL_GENERATIONS)
+    {
+        lookup_stored_batch(keys, scores, found);
+        return;
+    }
+
+    // Replace each derived key by the children of its board that are not terminal, and look up all of these
+    // together with the other keys in a single batch. The children are in the next generation, which is held.
+
+    constexpr size_t NO_PROBE = SIZE_MAX;
+
+    struct Child {
+        int    column;
+        Score  score;
+        size_t probe;
+    };
+
+    const size_t num_keys = keys.size();
+
+    vector<BoardKey> probe_keys;
+    vector<size_t>   key_probe(num_keys, NO_PROBE);
+    vector<Child>    children;
+    vector<size_t>   children_begin(num_keys + 1, 0);
+
+    scores.resize(num_keys);
+    found.assign(num_keys, false);
+
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        children_begin[i] = children.size();
+
+        if (!is_derived(keys[i]))
+        {
+            key_probe[i] = probe_keys.size();
+            probe_keys.push_back(keys[i]);
+            continue;
+        }
+
+        const Board board = Board::from_key(keys[i]);
+
+        const Outcome outcome = board.trivial_outcome();
+
+        if (outcome != Outcome::INDETERMINATE)
+        {
+            scores[i] = Score(outcome, 0);
+            found[i] = true;
+            continue;
+        }
+
+        for (int x = 0; x < H_SIZE; ++x)
+        {
+            if (board.can_play(x))
+            {
+                const Board child = board.play(x);
+
+                const Outcome child_outcome = child.trivial_outcome();
+
+                if (child_outcome != Outcome::INDETERMINATE)
+                {
+                    children.push_back(Child{x, Score(child_outcome, 0), NO_PROBE});
+                }
+                else
+                {
+                    children.push_back(Child{x, Score(), probe_keys.size()});
+                    probe_keys.push_back(child.normalize().to_key());
+                }
+            }
+        }
+    }
+
+    children_begin[num_keys] = children.size();
+
+    vector<Score> probe_scores;
+    vector<bool>  probe_found;
+
+    lookup_stored_batch(probe_keys, probe_scores, probe_found);
+
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        if (key_probe[i] != NO_PROBE)
+        {
+            scores[i] = probe_scores[key_probe[i]];
+            found[i] = probe_found[key_probe[i]];
+        }
+        else if (children_begin[i] != children_begin[i + 1])
+        {
+            vector<MoveScore> moves;
+
+            bool all_found = true;
+
+            for (size_t c = children_begin[i]; c < children_begin[i + 1]; ++c)
+            {
+                const Child & child = children[c];
+
+                if (child.probe == NO_PROBE)
+                {
+                    moves.push_back(MoveScore{child.column, child.score});
+                }
+                else if (probe_found[child.probe])
+                {
+                    moves.push_back(MoveScore{child.column, probe_scores[child.probe]});
+                }
+                else
+                {
+                    all_found = false;
+                }
+            }
+
+            if (all_found)
+            {
+                select_optimal_moves(Board::from_key(keys[i]).mover(), moves, scores[i]);
+                found[i] = true;
+            }
+        }
+    }
+}
+
+void LookupTable::lookup_stored_batch(const vector<BoardKey> & keys, vector<Score> & scores, vector<bool> & found) const
+{
+    // Each key has its own binary search state: the index range [first, last) that holds its lower bound.
+    // In each step, the next record to be probed by every unfinished search is prefetched first, and only
+    // then are the searches advanced. So the latencies of the reads of one step overlap, and a batch of
+    // searches takes about as many round trips to memory or disk as a single search.
+
+    const size_t num_keys = keys.size();
+
+    vector<uint64_t> first(num_keys);
+    vector<uint64_t> last(num_keys);
+    vector<uint64_t> section_end(num_keys);
+
+    vector<size_t> active;
+
+    // Keys rejected by the filter get an empty search range.
+
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        if (filter && !filter->may_contain(keys[i]))
+        {
+            first[i] = last[i] = section_end[i] = 0;
+            continue;
+        }
+
+        const unsigned section = section_of(keys[i]);
+
+        first[i] = section_begin[section];
+        last[i] = section_end[i] = section_begin[section + 1];
+
+        if (first[i] < last[i])
+        {
+            active.push_back(i);
+        }
+    }
+
+    vector<uint64_t> probes;
+
+    while (!active.empty())
+    {
+        probes.clear();
+        for (const size_t i: active)
+        {
+            probes.push_back(first[i] + (last[i] - first[i]) / 2);
+        }
+
+        prefetch_records(probes);
+
+        size_t num_active = 0;
+
+        for (size_t k = 0; k < active.size(); ++k)
+        {
+            const size_t i = active[k];
+
+            if (key_at(probes[k]) < keys[i])
+            {
+                first[i] = probes[k] + 1;
+            }
+            else
+            {
+                last[i] = probes[k];
+            }
+
+            if (first[i] < last[i])
+            {
+                active[num_active++] = i;
+            }
+        }
+
+        active.resize(num_active);
+    }
+
+    // Each search has now found its lower bound; check if it holds the key.
+
+    probes.clear();
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        if (first[i] < section_end[i])
+        {
+            probes.push_back(first[i]);
+        }
+    }
+
+    prefetch_records(probes);
+
+    scores.resize(num_keys);
+    found.assign(num_keys, false);
+
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        if (first[i] < section_end[i] && key_at(first[i]) == keys[i])
+        {
+            scores[i] = score_at(first[i]);
+            found[i] = true;
+        }
+    }
+}
+
+void LookupTable::set_filter(unique_ptr<BloomFilter> bloom_filter)
+{
+    filter = move(bloom_filter);
+}
+
+static void collect_search_indices(uint64_t first, uint64_t last, unsigned levels, vector<uint64_t> & indices)
+{
+    // Collect the indices probed by the first 'levels' steps of LookupTable::lower_bound, for any key.
+
+    if (levels == 0 || first >= last)
+    {
+        return;
+    }
+
+    const uint64_t mid = first + (last - first) / 2;
+
+    indices.push_back(mid);
+
+    collect_search_indices(first, mid, levels - 1, indices);
+    collect_search_indices(mid + 1, last, levels - 1, indices);
+}
+
+void LookupTable::pin_search_levels(unsigned levels)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    vector<uint64_t> indices;
+
+    for (unsigned section = 0; section + 1 < section_begin.size(); ++section)
+    {
+        collect_search_indices(section_begin[section], section_begin[section + 1], levels, indices);
+    }
+
+    for (const uint64_t index: indices)
+    {
+        cache->pin(records_offset + index * record_size, record_size);
+    }
+}
+
+void LookupTable::pin_generations(unsigned max_generation)
+{
+    if (!cache || !partitioned)
+    {
+        return;
+    }
+
+    for (unsigned section = 0; section <= max_generation && section + 1 < section_begin.size(); ++section)
+    {
+        const uint64_t first = section_begin[section];
+        const uint64_t last  = section_begin[section + 1];
+
+        cache->pin(records_offset + first * record_size, (last - first) * record_size);
+    }
+}
+
+bool LookupTable::cache_statistics(BlockCache::Statistics & statistics) const
+{
+    if (!cache)
+    {
+        return false;
+    }
+
+    statistics = cache->statistics();
+    return true;
+}
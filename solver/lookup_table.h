@@ -0,0 +1,166 @@
+
+////////////////////
+// lookup_table.h //
+////////////////////
+
+#ifndef LOOKUP_TABLE_H
+#define LOOKUP_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "score.h"
+#include "board.h"
+#include "block_cache.h"
+#include "bloom_filter.h"
+#include "partitioned_db.h"
+
+class LookupTable
+{
+    // The LookupTable class provides read-only access to a binary nodes file, as produced by the
+    // --make-binary-file mode. Such a file consists of fixed-size records, each holding a normalized
+    // board key in big-endian order followed by a score (see Score::store), sorted by key.
+    //
+    // Alternatively, the file can be a partitioned database, as produced by the --make-partitioned-db mode
+    // (see partitioned_db.h). In that case, lookups are confined to the section of the board's generation.
+    // If the database holds the generations of one parity only, a board of the other parity is resolved from
+    // its children: terminal boards by their trivial outcome, and other boards by looking up their children
+    // (in a single batch) and selecting the optimal move, as the backward stage of the solver does.
+    //
+    // By default, the file is memory-mapped, leaving caching to the kernel. Alternatively, a BlockCache of
+    // a given size can be used, which allows parts of the table to be pinned in memory, and provides
+    // statistics on the effectiveness of the cache. Lookups are performed using binary search.
+    //
+    // The file can also be the outcome file of a win/draw/loss table, as produced by the --make-wdl-file mode (see
+    // wdl_file.h). In that case, the records are read from the keys file, and their outcomes from the memory-mapped
+    // outcome file; all scores have a ply of zero.
+    //
+    // If a BloomFilter of the table's keys is given, it is consulted before the table itself, so that
+    // most lookups of boards that are not in the table do not need to access the table at all.
+
+    public:
+
+        // Open the binary nodes file. If 'cache_size' is zero, the file is memory-mapped;
+        // otherwise, it is read through a BlockCache of 'cache_size' bytes. For a win/draw/loss
+        // table, this applies to the keys file.
+        explicit LookupTable(const std::string & filename, uint64_t cache_size = 0);
+
+        // Unmap and close the files.
+        ~LookupTable();
+
+        LookupTable(const LookupTable &) = delete;
+        LookupTable & operator = (const LookupTable &) = delete;
+
+        // The number of records in the table.
+        uint64_t num_records() const
+        {
+            return number_of_records;
+        }
+
+        // Check if the file is a partitioned database.
+        bool is_partitioned() const
+        {
+            return partitioned;
+        }
+
+        // The generations held by the table.
+        PartitionedDbGenerations held_generations() const
+        {
+            return generations;
+        }
+
+        // Get the key of the record at the given index. Only records of the held generations are present.
+        BoardKey key_at(uint64_t index) const;
+
+        // Get the score of the record at the given index.
+        Score score_at(uint64_t index) const;
+
+        // Find the index of the first record with a key that is not less than the given key,
+        // considering only records in the index range [first, last), which must be sorted.
+        uint64_t lower_bound(BoardKey key, uint64_t first, uint64_t last) const;
+
+        // Look up the score of a normalized board key. Returns false if the key is not present.
+        bool lookup(BoardKey key, Score & score) const;
+
+        // Look up the score of a board, that need not be normalized. Returns false if the board is not present.
+        bool lookup(const Board & board, Score & score) const;
+
+        // Look up the scores of a batch of normalized board keys, sorted in increasing order, in a single
+        // merged pass over the table. For keys that are not present, 'found' is set to false.
+        void lookup_sorted_batch(const std::vector<BoardKey> & keys, std::vector<Score> & scores, std::vector<bool> & found) const;
+
+        // Look up the scores of a batch of normalized board keys, in any order. The binary searches for all keys
+        // proceed in lock-step, so that the reads of each step can be issued together. For keys that are not
+        // present, 'found' is set to false.
+        void lookup_batch(const std::vector<BoardKey> & keys, std::vector<Score> & scores, std::vector<bool> & found) const;
+
+        // Use a BloomFilter to reject keys that are not in the table.
+        void set_filter(std::unique_ptr<BloomFilter> bloom_filter);
+
+        // Pin the records that are visited in the first 'levels' steps of a binary search in each section,
+        // so that the top of the search is always resident. This only has an effect when using a BlockCache.
+        void pin_search_levels(unsigned levels);
+
+        // Pin the sections of all generations up to and including 'max_generation', i.e., the boards close to
+        // the start of the game that are looked up most often. This only has an effect for a partitioned
+        // database read through a BlockCache.
+        void pin_generations(unsigned max_generation);
+
+        // Get the statistics of the BlockCache. Returns false if no BlockCache is used.
+        bool cache_statistics(BlockCache::Statistics & statistics) const;
+
+    private: // Member functions.
+
+        // Unmap and close the files.
+        void release();
+
+        // Copy bytes at the given file offset to the buffer.
+        void read_bytes(uint64_t offset, unsigned count, uint8_t * buffer) const;
+
+        // Prepare for access to the records at the given indices, by issuing prefetch instructions for a
+        // memory-mapped file, or by asking the kernel to start reading them otherwise.
+        void prefetch_records(const std::vector<uint64_t> & indices) const;
+
+        // Get a pointer to the record at the given index; the buffer is used if the file is not memory-mapped.
+        const uint8_t * record_at(uint64_t index, uint8_t * buffer) const;
+
+        // Determine the section that holds a key. A plain binary nodes file has a single section.
+        unsigned section_of(BoardKey key) const;
+
+        // Check if a key belongs to a generation that is not held, so that its score must be derived.
+        bool is_derived(BoardKey key) const;
+
+        // Look up the scores of a batch of keys of held generations, as lookup_batch does.
+        void lookup_stored_batch(const std::vector<BoardKey> & keys, std::vector<Score> & scores, std::vector<bool> & found) const;
+
+    private: // Member variables.
+
+        int             fd;
+        const uint8_t * data;
+        uint64_t        size;
+        uint64_t        number_of_records;
+        unsigned        record_size;
+
+        std::unique_ptr<BlockCache>  cache;
+        std::unique_ptr<BloomFilter> filter;
+
+        bool partitioned;
+
+        // For a win/draw/loss table: the outcome file, memory-mapped in its entirety.
+        bool            wdl;
+        int             outcome_fd;
+        const uint8_t * outcome_data;
+        uint64_t        outcome_size;
+
+        PartitionedDbGenerations generations;
+
+        // File offset of the records, just beyond the header (if any).
+        uint64_t records_offset;
+
+        // Section i spans the record index range [section_begin[i], section_begin[i + 1]).
+        std::vector<uint64_t> section_begin;
+};
+
+#endif // LOOKUP_TABLE_H
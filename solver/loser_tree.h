@@ -0,0 +1,128 @@
+
+//////////////////
+// loser_tree.h //
+//////////////////
+
+#ifndef LOSER_TREE_H
+#define LOSER_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "derived_constants.h"
+
+class LoserTree
+{
+    // A tree of losers, for merging k sorted sequences of keys. The tree has k leaves, one per sequence,
+    // holding the current key of that sequence. Each internal node holds the sequence that lost the
+    // comparison at that node; the overall winner (the smallest key) is kept separately.
+    //
+    // After the winner's sequence advances to its next key, only the comparisons on the path from its
+    // leaf to the root need to be replayed: log2(k) comparisons per key, each against a single node,
+    // which is cheaper than the two comparisons per level needed to restore a binary heap.
+    //
+    // Exhausted sequences compare greater than all keys. Equal keys are ordered by sequence index.
+
+    public:
+
+        // Make a tree for k sequences, given the first key of each sequence; 'valid' is false for empty sequences.
+        LoserTree(const std::vector<BoardKey> & first_keys, const std::vector<bool> & first_valid) :
+            k(first_keys.size()),
+            keys(first_keys),
+            valid(first_valid),
+            tree(k, EMPTY)
+        {
+            // The internal nodes are 1 .. k-1, and the leaves k .. 2k-1 (implicitly). Each leaf is played
+            // upward; a node that has not yet seen a contender keeps the current one and ends that play.
+
+            winner_index = 0;
+
+            for (unsigned i = 0; i < k; ++i)
+            {
+                unsigned winner = i;
+                unsigned node = (i + k) / 2;
+
+                while (node > 0)
+                {
+                    if (tree[node] == EMPTY)
+                    {
+                        tree[node] = winner;
+                        break;
+                    }
+
+                    if (less(tree[node], winner))
+                    {
+                        std::swap(tree[node], winner);
+                    }
+
+                    node /= 2;
+                }
+
+                if (node == 0)
+                {
+                    winner_index = winner;
+                }
+            }
+        }
+
+        // Check if all sequences are exhausted.
+        bool empty() const
+        {
+            return k == 0 || !valid[winner_index];
+        }
+
+        // The sequence that holds the smallest current key.
+        unsigned winner() const
+        {
+            return winner_index;
+        }
+
+        // The smallest current key.
+        BoardKey winner_key() const
+        {
+            return keys[winner_index];
+        }
+
+        // Replace the winner's key by the next key of its sequence, or mark the sequence as exhausted.
+        void replace_winner(bool next_valid, BoardKey next_key)
+        {
+            unsigned winner = winner_index;
+
+            keys[winner] = next_key;
+            valid[winner] = next_valid;
+
+            for (unsigned node = (winner + k) / 2; node > 0; node /= 2)
+            {
+                if (less(tree[node], winner))
+                {
+                    std::swap(tree[node], winner);
+                }
+            }
+
+            winner_index = winner;
+        }
+
+    private: // Member functions.
+
+        bool less(unsigned a, unsigned b) const
+        {
+            if (!valid[a] || !valid[b])
+            {
+                return valid[a] && !valid[b];
+            }
+            return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+        }
+
+    private: // Member variables.
+
+        // Marks an internal node that has not yet seen a contender while building the tree.
+        enum : unsigned { EMPTY = ~0u };
+
+        unsigned              k;
+        std::vector<BoardKey> keys;
+        std::vector<bool>     valid;
+        std::vector<unsigned> tree;
+        unsigned              winner_index;
+};
+
+#endif // LOSER_TREE_H
@@ -0,0 +1,478 @@
+
+//////////////////
+// node_file.cc //
+//////////////////
+
+#include <string>
+#include <iomanip>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#include "base62.h"
+#include "derived_constants.h"
+#include "little_endian.h"
+#include "node_file.h"
+
+using namespace std;
+
+// Byte lengths and value masks corresponding to the 2-bit length codes of the group-varint encoding.
+static const unsigned group_varint_lengths[4] = {1, 2, 4, sizeof(BoardKey)};
+static const BoardKey group_varint_masks[4] = {0xff, 0xffff, 0xffffffff, ~BoardKey(0)};
+
+static unsigned group_varint_length_code(BoardKey delta)
+{
+    return (delta < (1ULL << 8)) ? 0 : (delta < (1ULL << 16)) ? 1 : (delta < (1ULL << 32)) ? 2 : 3;
+}
+
+NodeReader::NodeReader(istream & in) : in(in), packed(false), block_index(0)
+{
+    // A packed file starts with a character that cannot be the first character of a text node file.
+
+    if (in.peek() == PACKED_NODE_FILE_MAGIC[0])
+    {
+        char magic[PACKED_NODE_FILE_MAGIC_SIZE];
+        if (!in.read(magic, PACKED_NODE_FILE_MAGIC_SIZE) || memcmp(magic, PACKED_NODE_FILE_MAGIC, PACKED_NODE_FILE_MAGIC_SIZE) != 0)
+        {
+            throw runtime_error("NodeReader: bad packed node file header.");
+        }
+        packed = true;
+    }
+}
+
+NodeReader::NodeReader(istream & in, bool packed) : in(in), packed(packed), block_index(0)
+{
+    // Empty body.
+}
+
+bool NodeReader::read_block()
+{
+    uint8_t header[PACKED_NODE_FILE_BLOCK_HEADER_SIZE];
+
+    if (!in.read(reinterpret_cast<char *>(header), PACKED_NODE_FILE_BLOCK_HEADER_SIZE))
+    {
+        if (in.gcount() != 0)
+        {
+            throw runtime_error("NodeReader: truncated block header.");
+        }
+        return false;
+    }
+
+    const unsigned num_records = load_le(header + 0, 4);
+    const unsigned delta_bytes = load_le(header + 4, 4);
+    BoardKey       key         = load_key_le(header + 8, sizeof(BoardKey));
+
+    if (num_records == 0 || num_records > PACKED_NODE_FILE_BLOCK_RECORDS)
+    {
+        throw runtime_error("NodeReader: bad block record count.");
+    }
+
+    // Read the delta section and score plane. We reserve the size of a BoardKey as padding, so the
+    // group-varint decoder can always load a full BoardKey.
+
+    block_data.resize(delta_bytes + num_records * NUM_SCORE_OCTETS + sizeof(BoardKey));
+
+    if (!in.read(reinterpret_cast<char *>(block_data.data()), delta_bytes + num_records * NUM_SCORE_OCTETS))
+    {
+        throw runtime_error("NodeReader: truncated block.");
+    }
+
+    block_keys.resize(num_records);
+    block_scores.resize(num_records);
+
+    for (unsigned i = 0; i < num_records; ++i)
+    {
+        block_scores[i] = Score::load(&block_data[delta_bytes + i * NUM_SCORE_OCTETS]);
+    }
+
+    block_keys[0] = key;
+
+    const uint8_t * p = block_data.data();
+    const uint8_t * p_end = p + delta_bytes;
+
+    for (unsigned i = 1; i < num_records; i += 4)
+    {
+        if (p >= p_end)
+        {
+            throw runtime_error("NodeReader: corrupt key-delta section.");
+        }
+
+        unsigned control = *p++;
+
+        for (unsigned j = i; j < i + 4 && j < num_records; ++j)
+        {
+            // Load a full BoardKey and mask off the bytes that belong to the next delta(s).
+
+            key += load_key_le(p, sizeof(BoardKey)) & group_varint_masks[control & 3];
+            block_keys[j] = key;
+
+            p += group_varint_lengths[control & 3];
+            control >>= 2;
+        }
+    }
+
+    if (p != p_end)
+    {
+        throw runtime_error("NodeReader: corrupt key-delta section.");
+    }
+
+    block_index = 0;
+    return true;
+}
+
+bool NodeReader::read(BoardKey & key, Score & score)
+{
+    if (packed)
+    {
+        if (block_index == block_keys.size() && !read_block())
+        {
+            return false;
+        }
+        key   = block_keys[block_index];
+        score = block_scores[block_index];
+        ++block_index;
+        return true;
+    }
+
+    string board_string;
+
+    if (!(in >> setw(NUM_BASE62_BOARD_DIGITS) >> board_string >> score))
+    {
+        return false;
+    }
+
+    key = base62_string_to_key(board_string);
+    return true;
+}
+
+PackedNodeWriter::PackedNodeWriter(ostream & out) : out(out), have_previous_key(false), previous_key(0)
+{
+    out.write(PACKED_NODE_FILE_MAGIC, PACKED_NODE_FILE_MAGIC_SIZE);
+}
+
+PackedNodeWriter::~PackedNodeWriter()
+{
+    flush();
+}
+
+void PackedNodeWriter::write(BoardKey key, const Score & score)
+{
+    if (have_previous_key && key <= previous_key)
+    {
+        throw runtime_error("PackedNodeWriter::write: keys must be strictly increasing.");
+    }
+
+    block_keys.push_back(key);
+    block_scores.push_back(score);
+
+    have_previous_key = true;
+    previous_key = key;
+
+    if (block_keys.size() == PACKED_NODE_FILE_BLOCK_RECORDS)
+    {
+        flush();
+    }
+}
+
+void PackedNodeWriter::flush()
+{
+    if (block_keys.empty())
+    {
+        return;
+    }
+
+    const unsigned num_records = block_keys.size();
+
+    // Encode the key deltas. Each group of four deltas takes at most 1 + 4 * sizeof(BoardKey) bytes.
+
+    vector<uint8_t> deltas(((num_records + 2) / 4) * (1 + 4 * sizeof(BoardKey)));
+
+    uint8_t * p = deltas.data();
+
+    for (unsigned i = 1; i < num_records; i += 4)
+    {
+        uint8_t * control = p++;
+
+        *control = 0;
+
+        for (unsigned j = i; j < i + 4 && j < num_records; ++j)
+        {
+            const BoardKey delta = block_keys[j] - block_keys[j - 1];
+            const unsigned code = group_varint_length_code(delta);
+
+            *control |= code << (2 * (j - i));
+
+            store_key_le(p, delta, group_varint_lengths[code]);
+            p += group_varint_lengths[code];
+        }
+    }
+
+    const unsigned delta_bytes = p - deltas.data();
+
+    vector<uint8_t> score_plane(num_records * NUM_SCORE_OCTETS);
+
+    for (unsigned i = 0; i < num_records; ++i)
+    {
+        block_scores[i].store(&score_plane[i * NUM_SCORE_OCTETS]);
+    }
+
+    uint8_t header[PACKED_NODE_FILE_BLOCK_HEADER_SIZE];
+
+    store_le(header + 0, num_records, 4);
+    store_le(header + 4, delta_bytes, 4);
+    store_key_le(header + 8, block_keys[0], sizeof(BoardKey));
+
+    out.write(reinterpret_cast<const char *>(header), PACKED_NODE_FILE_BLOCK_HEADER_SIZE);
+    out.write(reinterpret_cast<const char *>(deltas.data()), delta_bytes);
+    out.write(reinterpret_cast<const char *>(score_plane.data()), score_plane.size());
+
+    block_keys.clear();
+    block_scores.clear();
+}
+
+uint64_t count_node_records(istream & in)
+{
+    NodeReader reader(in);
+
+    uint64_t count = 0;
+
+    if (reader.is_packed())
+    {
+        // Walk the block headers, skipping the block contents.
+
+        uint8_t header[PACKED_NODE_FILE_BLOCK_HEADER_SIZE];
+
+        while (in.read(reinterpret_cast<char *>(header), PACKED_NODE_FILE_BLOCK_HEADER_SIZE))
+        {
+            const unsigned num_records = load_le(header + 0, 4);
+            const unsigned delta_bytes = load_le(header + 4, 4);
+
+            count += num_records;
+
+            const unsigned block_bytes = delta_bytes + num_records * NUM_SCORE_OCTETS;
+
+            if (!in.ignore(block_bytes) || in.gcount() != block_bytes)
+            {
+                throw runtime_error("count_node_records: truncated block.");
+            }
+        }
+    }
+    else
+    {
+        BoardKey key;
+        Score    score;
+
+        while (reader.read(key, score))
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+SortedNodeFile::SortedNodeFile(const string & filename) : filename(filename), packed(false), file_size(0), number_of_records(0)
+{
+    ifstream in(filename, ios::binary);
+
+    if (!in)
+    {
+        throw runtime_error("SortedNodeFile: unable to open file.");
+    }
+
+    in.seekg(0, ios::end);
+    file_size = in.tellg();
+    in.seekg(0);
+
+    packed = (in.peek() == PACKED_NODE_FILE_MAGIC[0]);
+
+    if (packed)
+    {
+        // Walk the block headers to make the block index.
+
+        uint64_t offset = PACKED_NODE_FILE_MAGIC_SIZE;
+
+        in.seekg(offset);
+
+        uint8_t header[PACKED_NODE_FILE_BLOCK_HEADER_SIZE];
+
+        while (offset < file_size)
+        {
+            if (!in.read(reinterpret_cast<char *>(header), PACKED_NODE_FILE_BLOCK_HEADER_SIZE))
+            {
+                throw runtime_error("SortedNodeFile: truncated block header.");
+            }
+
+            Block block;
+
+            block.count     = load_le(header + 0, 4);
+            block.first_key = load_key_le(header + 8, sizeof(BoardKey));
+            block.offset    = offset;
+            block.rank      = number_of_records;
+
+            blocks.push_back(block);
+
+            const unsigned delta_bytes = load_le(header + 4, 4);
+
+            number_of_records += block.count;
+            offset += PACKED_NODE_FILE_BLOCK_HEADER_SIZE + delta_bytes + block.count * NUM_SCORE_OCTETS;
+
+            in.seekg(offset);
+        }
+    }
+    else
+    {
+        if (file_size % TEXT_NODE_FILE_LINE_SIZE != 0)
+        {
+            throw runtime_error("SortedNodeFile: text node file does not have fixed-size lines.");
+        }
+
+        number_of_records = file_size / TEXT_NODE_FILE_LINE_SIZE;
+    }
+}
+
+BoardKey SortedNodeFile::text_key_at(ifstream & in, uint64_t index) const
+{
+    char line[TEXT_NODE_FILE_LINE_SIZE];
+
+    in.seekg(index * TEXT_NODE_FILE_LINE_SIZE);
+
+    if (!in.read(line, TEXT_NODE_FILE_LINE_SIZE) || line[TEXT_NODE_FILE_LINE_SIZE - 1] != '\n')
+    {
+        throw runtime_error("SortedNodeFile: bad line in text node file.");
+    }
+
+    return base62_string_to_key(string(line, NUM_BASE62_BOARD_DIGITS));
+}
+
+SortedNodeFile::Position SortedNodeFile::lower_bound(BoardKey key) const
+{
+    ifstream in(filename, ios::binary);
+
+    if (!packed)
+    {
+        uint64_t first = 0;
+        uint64_t last  = number_of_records;
+
+        while (first < last)
+        {
+            const uint64_t mid = first + (last - first) / 2;
+
+            if (text_key_at(in, mid) < key)
+            {
+                first = mid + 1;
+            }
+            else
+            {
+                last = mid;
+            }
+        }
+
+        return Position{first * TEXT_NODE_FILE_LINE_SIZE, 0, first};
+    }
+
+    // Find the last block that starts with a key not greater than the given key.
+
+    const auto after = upper_bound(blocks.begin(), blocks.end(), key, [](BoardKey k, const Block & block) { return k < block.first_key; });
+
+    if (after == blocks.begin())
+    {
+        return Position{blocks.empty() ? file_size : blocks.front().offset, 0, 0};
+    }
+
+    const Block & block = *(after - 1);
+
+    // Count the records in the block with a key less than the given key.
+
+    in.seekg(block.offset);
+
+    NodeReader reader(in, true);
+
+    BoardKey record_key;
+    Score    record_score;
+    unsigned skip = 0;
+
+    while (skip < block.count && reader.read(record_key, record_score) && record_key < key)
+    {
+        ++skip;
+    }
+
+    if (skip == block.count)
+    {
+        return (after == blocks.end()) ? Position{file_size, 0, number_of_records} : Position{after->offset, 0, after->rank};
+    }
+
+    return Position{block.offset, skip, block.rank + skip};
+}
+
+vector<BoardKey> SortedNodeFile::sample_keys(uint64_t spacing) const
+{
+    vector<BoardKey> samples;
+
+    if (packed)
+    {
+        // Samples are taken at block granularity.
+
+        uint64_t next_rank = 0;
+
+        for (const Block & block: blocks)
+        {
+            if (block.rank >= next_rank)
+            {
+                samples.push_back(block.first_key);
+                next_rank = block.rank + spacing;
+            }
+        }
+    }
+    else
+    {
+        ifstream in(filename, ios::binary);
+
+        for (uint64_t index = 0; index < number_of_records; index += spacing)
+        {
+            samples.push_back(text_key_at(in, index));
+        }
+    }
+
+    return samples;
+}
+
+NodeRangeReader::NodeRangeReader(const SortedNodeFile & file, const SortedNodeFile::Position & position, uint64_t count) :
+    in(file.get_filename(), ios::binary),
+    reader(in, file.is_packed()),
+    remaining(count)
+{
+    if (!in.is_open())
+    {
+        throw runtime_error("NodeRangeReader: unable to open file.");
+    }
+
+    in.seekg(position.offset);
+
+    BoardKey key;
+    Score    score;
+
+    for (uint64_t i = 0; i < position.skip; ++i)
+    {
+        if (!reader.read(key, score))
+        {
+            throw runtime_error("NodeRangeReader: unexpected end of file.");
+        }
+    }
+}
+
+bool NodeRangeReader::read(BoardKey & key, Score & score)
+{
+    if (remaining == 0)
+    {
+        return false;
+    }
+
+    if (!reader.read(key, score))
+    {
+        throw runtime_error("NodeRangeReader: unexpected end of file.");
+    }
+
+    --remaining;
+    return true;
+}
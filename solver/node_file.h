@@ -0,0 +1,211 @@
+
+/////////////////
+// node_file.h //
+/////////////////
+
+#ifndef NODE_FILE_H
+#define NODE_FILE_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <fstream>
+
+#include "score.h"
+#include "derived_constants.h"
+
+// Node files hold a sequence of (board, score) records. They come in two formats:
+//
+// * The text format, where each record is a line consisting of the board in base-62 representation,
+//   followed by the score. This is the format that the 'sort' tool can handle.
+//
+// * The packed format, that can only hold records sorted by strictly increasing board key.
+//   It consists of a file header (the PACKED_NODE_FILE_MAGIC string), followed by blocks of up
+//   to PACKED_NODE_FILE_BLOCK_RECORDS records each. A block is laid out as follows:
+//
+//     (1) A block header: the number of records in the block (32 bits), the size of the key-delta
+//         section in bytes (32 bits), and the key of the first record (the size of a BoardKey, i.e.
+//         64 bits unless the board keys need 128 bits). These are all stored in little-endian order.
+//
+//     (2) The key-delta section, holding the differences between consecutive keys in the block,
+//         in group-varint encoding: each group of four deltas is preceded by a control byte that
+//         holds the byte-length of each of the four deltas as a 2-bit code (1, 2, 4, or the size
+//         of a BoardKey). This encoding can be decoded without data-dependent branches per byte.
+//
+//     (3) The score plane: one ScoreCode per record, as stored by Score::store().
+//
+// Since keys in sorted node files are close together, a packed file is several times smaller than
+// its text equivalent. Its header starts with a character that cannot occur in a text node file,
+// which allows the NodeReader to handle both formats transparently.
+
+constexpr const char * PACKED_NODE_FILE_MAGIC = "#C4PACK\n";
+
+constexpr unsigned PACKED_NODE_FILE_MAGIC_SIZE = 8;
+constexpr unsigned PACKED_NODE_FILE_BLOCK_HEADER_SIZE = 8 + sizeof(BoardKey);
+constexpr unsigned PACKED_NODE_FILE_BLOCK_RECORDS = 4096;
+
+class NodeReader
+{
+    // Read (key, score) records from a node file in either the text or the packed format.
+
+    public:
+
+        // Prepare to read from the given stream; the format is determined from the first character.
+        explicit NodeReader(std::istream & in);
+
+        // Prepare to read from the given stream in the given format. The stream must be positioned at the start
+        // of a line (text format) or a block (packed format), rather than at the start of the file.
+        NodeReader(std::istream & in, bool packed);
+
+        // Read the next record. Returns false at the end of the stream.
+        bool read(BoardKey & key, Score & score);
+
+        // Check if the input is in the packed format.
+        bool is_packed() const
+        {
+            return packed;
+        }
+
+    private: // Member functions.
+
+        // Read and decode the next block of a packed file. Returns false at the end of the stream.
+        bool read_block();
+
+    private: // Member variables.
+
+        std::istream & in;
+
+        bool packed;
+
+        // Decoded records of the current block (packed format only).
+        std::vector<BoardKey> block_keys;
+        std::vector<Score>    block_scores;
+        unsigned              block_index;
+
+        // Raw bytes of the current block (packed format only).
+        std::vector<uint8_t> block_data;
+};
+
+class PackedNodeWriter
+{
+    // Write (key, score) records to a stream in the packed format.
+    // Keys must be written in strictly increasing order.
+
+    public:
+
+        // Prepare to write to the given stream; this writes the file header.
+        explicit PackedNodeWriter(std::ostream & out);
+
+        // The destructor writes the last, possibly incomplete block.
+        ~PackedNodeWriter();
+
+        // Add a record.
+        void write(BoardKey key, const Score & score);
+
+        // Write the records collected so far as a (possibly incomplete) block.
+        void flush();
+
+    private: // Member variables.
+
+        std::ostream & out;
+
+        std::vector<BoardKey> block_keys;
+        std::vector<Score>    block_scores;
+
+        bool     have_previous_key;
+        BoardKey previous_key;
+};
+
+// Count the number of records in a node file. For packed files, only the block headers are inspected.
+uint64_t count_node_records(std::istream & in);
+
+// The size of a line in a text node file: the base-62 board, the score (the outcome character and the
+// base-62 ply), and a newline.
+const unsigned TEXT_NODE_FILE_LINE_SIZE = NUM_BASE62_BOARD_DIGITS + 1 + NUM_BASE62_PLY_DIGITS + 1;
+
+class SortedNodeFile
+{
+    // Random access to a node file on disk, in either format, with strictly increasing keys. This allows such
+    // a file to be split into key ranges that can be processed independently, e.g. by different threads.
+    //
+    // Since lines in text node files have a fixed size, record i of a text node file is found at offset
+    // (i * TEXT_NODE_FILE_LINE_SIZE). For a packed node file, an index of the blocks is made when the file
+    // is opened, by walking the block headers.
+
+    public:
+
+        // A position in the file: the offset of a line or block, the number of records to skip from there,
+        // and the number of records before the position.
+        struct Position {
+            uint64_t offset;
+            uint64_t skip;
+            uint64_t rank;
+        };
+
+        explicit SortedNodeFile(const std::string & filename);
+
+        const std::string & get_filename() const
+        {
+            return filename;
+        }
+
+        bool is_packed() const
+        {
+            return packed;
+        }
+
+        uint64_t num_records() const
+        {
+            return number_of_records;
+        }
+
+        // Find the position of the first record with a key that is not less than the given key.
+        Position lower_bound(BoardKey key) const;
+
+        // Get the keys of (approximately) every 'spacing'-th record, for choosing split points.
+        std::vector<BoardKey> sample_keys(uint64_t spacing) const;
+
+    private: // Member types.
+
+        struct Block {
+            BoardKey first_key;
+            uint64_t offset;
+            uint64_t rank;
+            unsigned count;
+        };
+
+    private: // Member functions.
+
+        // Read the key of a record of a text node file.
+        BoardKey text_key_at(std::ifstream & in, uint64_t index) const;
+
+    private: // Member variables.
+
+        std::string        filename;
+        bool               packed;
+        uint64_t           file_size;
+        uint64_t           number_of_records;
+        std::vector<Block> blocks;
+};
+
+class NodeRangeReader
+{
+    // Read a given number of records from a SortedNodeFile, starting at a given position.
+
+    public:
+
+        NodeRangeReader(const SortedNodeFile & file, const SortedNodeFile::Position & position, uint64_t count);
+
+        // Read the next record. Returns false after 'count' records.
+        bool read(BoardKey & key, Score & score);
+
+    private: // Member variables.
+
+        std::ifstream in;
+        NodeReader    reader;
+        uint64_t      remaining;
+};
+
+#endif // NODE_FILE_H
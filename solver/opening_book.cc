@@ -0,0 +1,33 @@
+
+/////////////////////
+// opening_book.cc //
+/////////////////////
+
+#include <algorithm>
+#include <cstring>
+
+#include "little_endian.h"
+#include "hash.h"
+#include "opening_book.h"
+
+using namespace std;
+
+void encode_opening_book_header(unsigned max_moves, OpeningBookPolicy policy, uint64_t num_records, uint64_t records_checksum, uint8_t * header)
+{
+    fill(header, header + OPENING_BOOK_HEADER_SIZE, 0);
+
+    memcpy(header, OPENING_BOOK_MAGIC, OPENING_BOOK_MAGIC_SIZE);
+
+    store_le(header +  8, OPENING_BOOK_VERSION     , 4);
+    store_le(header + 12, H_SIZE                   , 4);
+    store_le(header + 16, V_SIZE                   , 4);
+    store_le(header + 20, CONNECT_Q                , 4);
+    store_le(header + 24, NUM_BASE256_BOARD_DIGITS , 4);
+    store_le(header + 28, OPENING_BOOK_RECORD_SIZE , 4);
+    store_le(header + 32, max_moves                , 4);
+    store_le(header + 36, policy                   , 4);
+    store_le(header + 40, num_records              , 8);
+    store_le(header + 48, records_checksum         , 8);
+
+    store_le(header + 56, fnv1a_64(header, 56), 8);
+}
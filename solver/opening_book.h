@@ -0,0 +1,63 @@
+
+////////////////////
+// opening_book.h //
+////////////////////
+
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include <cstdint>
+
+#include "board_size.h"
+#include "derived_constants.h"
+
+// An opening book holds the scores and the optimal moves of the boards that can be reached in the first moves
+// of a game, as extracted from a full table by the --extract-book mode. It is small enough for game clients to
+// load into memory entirely.
+//
+// The book holds one record per board, sorted by key. A record consists of the normalized board key in
+// big-endian order, the score (NUM_SCORE_OCTETS bytes), and the optimal moves (OPENING_BOOK_MOVES_SIZE bytes, in
+// little-endian order; one octet for boards up to 8 columns wide): bit x is set if a move in column x
+// (numbered from 0) of the normalized board is optimal. The optimal moves are zero for boards that are in the
+// book only to provide the scores of the children of the boards before them, and for boards where the game
+// has ended.
+//
+// The file starts with a header. All numbers in the header are stored in little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   OPENING_BOOK_MAGIC
+//          8      4   format version (OPENING_BOOK_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   key size in bytes (NUM_BASE256_BOARD_DIGITS)
+//         28      4   record size in bytes (key size + score size + moves size)
+//         32      4   maximum number of moves (chips on the board) of the boards with optimal moves
+//         36      4   policy (OPENING_BOOK_POLICY_OPTIMAL or OPENING_BOOK_POLICY_ANY)
+//         40      8   number of records
+//         48      8   FNV-1a hash of the records
+//         56      8   FNV-1a hash of the preceding header bytes
+//
+// The records follow the header.
+
+constexpr const char * OPENING_BOOK_MAGIC = "#C4OBK\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned OPENING_BOOK_MAGIC_SIZE  = 8;
+constexpr unsigned OPENING_BOOK_VERSION     = 1;
+constexpr unsigned OPENING_BOOK_HEADER_SIZE = 64;
+constexpr unsigned OPENING_BOOK_MOVES_SIZE  = (H_SIZE + 7) / 8;
+constexpr unsigned OPENING_BOOK_RECORD_SIZE = BINARY_RECORD_SIZE + OPENING_BOOK_MOVES_SIZE;
+
+static_assert(H_SIZE <= 64, "The optimal moves of a board must fit in 64 bits.");
+
+// The policy that determines which boards are followed when walking the game tree from the empty board.
+enum OpeningBookPolicy : unsigned {
+    OPENING_BOOK_POLICY_OPTIMAL = 0, // Follow only the optimal moves, for both players.
+    OPENING_BOOK_POLICY_ANY     = 1  // Follow all moves.
+};
+
+// Encode a header into a buffer of OPENING_BOOK_HEADER_SIZE bytes.
+void encode_opening_book_header(unsigned max_moves, OpeningBookPolicy policy, uint64_t num_records, uint64_t records_checksum, uint8_t * header);
+
+#endif // OPENING_BOOK_H
@@ -0,0 +1,60 @@
+
+//////////////////////
+// optimal_moves.cc //
+//////////////////////
+
+#include <stdexcept>
+
+#include "optimal_moves.h"
+
+using namespace std;
+
+static int preference(Player mover, const Score & score)
+{
+    // Express how much the mover prefers a score; higher is better.
+    // Wins are better than draws, which are better than losses; fast wins, long draws, and slow losses are preferred.
+
+    const int ply = static_cast<int>(score.ply);
+
+    switch (score.outcome)
+    {
+        case Outcome::A_WINS : return (mover == Player::A) ? (2000 - ply) : ply;
+        case Outcome::B_WINS : return (mover == Player::B) ? (2000 - ply) : ply;
+        case Outcome::DRAW   : return 1000 + ply;
+        default              : throw runtime_error("select_optimal_moves: unexpected indeterminate score.");
+    }
+}
+
+vector<int> select_optimal_moves(Player mover, const vector<MoveScore> & moves, Score & board_score)
+{
+    if (moves.empty())
+    {
+        throw runtime_error("select_optimal_moves: no moves available.");
+    }
+
+    vector<int> optimal_columns;
+    int optimal_preference = 0;
+
+    for (const MoveScore & move: moves)
+    {
+        const int move_preference = preference(mover, move.score);
+
+        if (optimal_columns.empty() || move_preference > optimal_preference)
+        {
+            optimal_columns.clear();
+            optimal_preference = move_preference;
+            board_score = move.score;
+        }
+
+        if (move_preference == optimal_preference)
+        {
+            optimal_columns.push_back(move.column);
+        }
+    }
+
+    // The board itself is one ply further from the end of the game than the board after the optimal move.
+
+    board_score.ply += 1;
+
+    return optimal_columns;
+}
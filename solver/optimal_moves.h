@@ -0,0 +1,31 @@
+
+/////////////////////
+// optimal_moves.h //
+/////////////////////
+
+#ifndef OPTIMAL_MOVES_H
+#define OPTIMAL_MOVES_H
+
+#include <vector>
+
+#include "player.h"
+#include "score.h"
+
+// The score of the board that results from a move in a given column.
+
+struct MoveScore {
+    int   column;
+    Score score;
+};
+
+// Select the optimal moves for the mover, given the scores of the boards that result from each available move.
+//
+// The tie-breaking rules are the same as in the Python clients: if the mover can win, the fastest win is preferred;
+// if the mover can draw, the longest draw is preferred; and if the mover will lose, the slowest loss is preferred.
+//
+// Returns the columns of all equally good optimal moves, in the order given, and sets 'board_score' to the score of
+// the board itself. The moves must not be empty.
+
+std::vector<int> select_optimal_moves(Player mover, const std::vector<MoveScore> & moves, Score & board_score);
+
+#endif // OPTIMAL_MOVES_H
@@ -0,0 +1,129 @@
+
+///////////////////////
+// partitioned_db.cc //
+///////////////////////
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "derived_constants.h"
+#include "little_endian.h"
+#include "hash.h"
+#include "partitioned_db.h"
+
+using namespace std;
+
+void encode_partitioned_db_header(const vector<PartitionedDbSection> & sections, uint8_t * header, PartitionedDbGenerations generations)
+{
+    if (sections.size() != PARTITIONED_DB_NUM_SECTIONS)
+    {
+        throw runtime_error("encode_partitioned_db_header: bad number of sections.");
+    }
+
+    fill(header, header + PARTITIONED_DB_HEADER_SIZE, 0);
+
+    memcpy(header, PARTITIONED_DB_MAGIC, PARTITIONED_DB_MAGIC_SIZE);
+
+    store_le(header +  8, PARTITIONED_DB_VERSION        , 4);
+    store_le(header + 12, H_SIZE                        , 4);
+    store_le(header + 16, V_SIZE                        , 4);
+    store_le(header + 20, CONNECT_Q                     , 4);
+    store_le(header + 24, NUM_BASE256_BOARD_DIGITS      , 4);
+    store_le(header + 28, BINARY_RECORD_SIZE            , 4);
+    store_le(header + 32, PARTITIONED_DB_NUM_SECTIONS   , 4);
+    store_le(header + 36, generations                   , 4);
+
+    for (unsigned i = 0; i < PARTITIONED_DB_NUM_SECTIONS; ++i)
+    {
+        store_le(header + 40 + 24 * i +  0, sections[i].offset  , 8);
+        store_le(header + 40 + 24 * i +  8, sections[i].count   , 8);
+        store_le(header + 40 + 24 * i + 16, sections[i].checksum, 8);
+    }
+
+    store_le(header + PARTITIONED_DB_HEADER_SIZE - 8, fnv1a_64(header, PARTITIONED_DB_HEADER_SIZE - 8), 8);
+}
+
+vector<PartitionedDbSection> decode_partitioned_db_header(const uint8_t * header)
+{
+    if (memcmp(header, PARTITIONED_DB_MAGIC, PARTITIONED_DB_MAGIC_SIZE) != 0)
+    {
+        throw runtime_error("decode_partitioned_db_header: bad magic.");
+    }
+
+    if (load_le(header + PARTITIONED_DB_HEADER_SIZE - 8, 8) != fnv1a_64(header, PARTITIONED_DB_HEADER_SIZE - 8))
+    {
+        throw runtime_error("decode_partitioned_db_header: bad header checksum.");
+    }
+
+    if (load_le(header + 8, 4) != PARTITIONED_DB_VERSION)
+    {
+        throw runtime_error("decode_partitioned_db_header: unsupported version.");
+    }
+
+    if (load_le(header + 12, 4) != H_SIZE || load_le(header + 16, 4) != V_SIZE || load_le(header + 20, 4) != CONNECT_Q)
+    {
+        throw runtime_error("decode_partitioned_db_header: database is for a different board geometry.");
+    }
+
+    if (load_le(header + 24, 4) != NUM_BASE256_BOARD_DIGITS || load_le(header + 28, 4) != BINARY_RECORD_SIZE ||
+        load_le(header + 32, 4) != PARTITIONED_DB_NUM_SECTIONS)
+    {
+        throw runtime_error("decode_partitioned_db_header: unexpected record layout.");
+    }
+
+    if (load_le(header + 36, 4) > PARTITIONED_DB_ODD_GENERATIONS)
+    {
+        throw runtime_error("decode_partitioned_db_header: unknown generations.");
+    }
+
+    const PartitionedDbGenerations generations = decode_partitioned_db_generations(header);
+
+    vector<PartitionedDbSection> sections(PARTITIONED_DB_NUM_SECTIONS);
+
+    uint64_t expected_offset = PARTITIONED_DB_HEADER_SIZE;
+
+    for (unsigned i = 0; i < PARTITIONED_DB_NUM_SECTIONS; ++i)
+    {
+        sections[i].offset   = load_le(header + 40 + 24 * i +  0, 8);
+        sections[i].count    = load_le(header + 40 + 24 * i +  8, 8);
+        sections[i].checksum = load_le(header + 40 + 24 * i + 16, 8);
+
+        if (sections[i].offset != expected_offset)
+        {
+            throw runtime_error("decode_partitioned_db_header: sections are not contiguous.");
+        }
+
+        if (sections[i].count != 0 && !partitioned_db_holds_generation(generations, i))
+        {
+            throw runtime_error("decode_partitioned_db_header: section of a generation that is not held.");
+        }
+
+        expected_offset += sections[i].count * BINARY_RECORD_SIZE;
+    }
+
+    return sections;
+}
+
+PartitionedDbGenerations decode_partitioned_db_generations(const uint8_t * header)
+{
+    return static_cast<PartitionedDbGenerations>(load_le(header + 36, 4));
+}
+
+bool partitioned_db_holds_generation(PartitionedDbGenerations generations, unsigned generation)
+{
+    switch (generations)
+    {
+        case PARTITIONED_DB_EVEN_GENERATIONS : return generation % 2 == 0;
+        case PARTITIONED_DB_ODD_GENERATIONS  : return generation % 2 == 1;
+        default                              : return true;
+    }
+}
+
+bool is_partitioned_db(istream & in)
+{
+    // Binary nodes files start with the key of the empty board, which is zero. So a binary nodes file
+    // can never start with the '#' character that the partitioned database magic starts with.
+
+    return in.peek() == PARTITIONED_DB_MAGIC[0];
+}
@@ -0,0 +1,79 @@
+
+//////////////////////
+// partitioned_db.h //
+//////////////////////
+
+#ifndef PARTITIONED_DB_H
+#define PARTITIONED_DB_H
+
+#include <cstdint>
+#include <vector>
+#include <istream>
+
+#include "board_size.h"
+
+// A partitioned database file holds the same records as a binary nodes file (a big-endian board key followed
+// by a score octet), but rather than sorting all records by key, it holds one key-sorted section per generation,
+// i.e., per number of chips on the board. Since all children of a board are in the same generation, they are
+// found in a single section that is much smaller than the entire database.
+//
+// A database can also hold only the generations of one parity, as made by the --make-even-db mode; the sections
+// of the other parity are then empty. Since the children of a board are in the next generation, the score of a
+// board of the other parity follows from the scores of its children (see LookupTable).
+//
+// The file starts with a self-describing header. All numbers in the header are stored in little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   PARTITIONED_DB_MAGIC
+//          8      4   format version (PARTITIONED_DB_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   key size in bytes (NUM_BASE256_BOARD_DIGITS)
+//         28      4   record size in bytes (BINARY_RECORD_SIZE: key size + score size)
+//         32      4   number of sections (H_SIZE * V_SIZE + 1)
+//         36      4   generations held (PartitionedDbGenerations)
+//         40   24*N   for each section: its file offset, its number of records, and the FNV-1a hash of its records
+//    40+24*N      8   FNV-1a hash of the preceding header bytes
+//
+// The sections follow the header, in order of generation.
+
+constexpr const char * PARTITIONED_DB_MAGIC = "#C4PDB\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned PARTITIONED_DB_MAGIC_SIZE   = 8;
+constexpr unsigned PARTITIONED_DB_VERSION      = 1;
+constexpr unsigned PARTITIONED_DB_NUM_SECTIONS = H_SIZE * V_SIZE + 1;
+constexpr unsigned PARTITIONED_DB_HEADER_SIZE  = 40 + 24 * PARTITIONED_DB_NUM_SECTIONS + 8;
+
+// The generations held by a partitioned database.
+enum PartitionedDbGenerations : unsigned {
+    PARTITIONED_DB_ALL_GENERATIONS  = 0,
+    PARTITIONED_DB_EVEN_GENERATIONS = 1,
+    PARTITIONED_DB_ODD_GENERATIONS  = 2
+};
+
+struct PartitionedDbSection {
+    uint64_t offset;
+    uint64_t count;
+    uint64_t checksum;
+};
+
+// Encode a header into a buffer of PARTITIONED_DB_HEADER_SIZE bytes.
+void encode_partitioned_db_header(const std::vector<PartitionedDbSection> & sections, uint8_t * header,
+                                  PartitionedDbGenerations generations = PARTITIONED_DB_ALL_GENERATIONS);
+
+// Decode a header from a buffer of PARTITIONED_DB_HEADER_SIZE bytes. Throws an exception if the header is
+// damaged, or if it describes a database for a different board geometry than the one we are compiled for.
+std::vector<PartitionedDbSection> decode_partitioned_db_header(const uint8_t * header);
+
+// Decode the generations held by a database from a header that has been checked by decode_partitioned_db_header.
+PartitionedDbGenerations decode_partitioned_db_generations(const uint8_t * header);
+
+// Check if a database that holds the given generations holds the boards of a generation.
+bool partitioned_db_holds_generation(PartitionedDbGenerations generations, unsigned generation);
+
+// Check if a stream starts with a partitioned database header, without consuming any input.
+bool is_partitioned_db(std::istream & in);
+
+#endif // PARTITIONED_DB_H
@@ -0,0 +1,437 @@
+
+////////////////////////
+// connect4_native.cc //
+////////////////////////
+
+// A Python extension module that provides the board encoding and the table lookups of the solver to the
+// Python clients. See setup.py for how to build it.
+//
+// Boards are passed as sequences of H_SIZE * V_SIZE integers (0: empty, 1: player A, 2: player B), given row
+// by row, starting at the bottom row, as the Python clients store them. Scores are returned as score octets.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <exception>
+
+#include "board_size.h"
+#include "derived_constants.h"
+#include "board.h"
+#include "lookup_table.h"
+#include "optimal_moves.h"
+
+using namespace std;
+
+struct TableObject {
+    PyObject_HEAD
+    LookupTable * table;
+};
+
+static bool check_table(TableObject * self)
+{
+    // Check that the table has been opened. Returns false, with a Python exception set, if it has not; this is
+    // the case if __init__ was not called, or failed.
+
+    if (self->table == nullptr)
+    {
+        PyErr_SetString(PyExc_ValueError, "table is not open");
+        return false;
+    }
+
+    return true;
+}
+
+static void set_error(const exception & e)
+{
+    // Convert a C++ exception to a Python exception. The column encoding throws std::out_of_range for columns
+    // that cannot occur in a game; these are invalid boards. Other failures are errors of the table.
+
+    if (dynamic_cast<const out_of_range *>(&e) != nullptr)
+    {
+        PyErr_SetString(PyExc_ValueError, "board entries are not a legal position");
+    }
+    else
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+}
+
+static bool parse_board(PyObject * entries_object, Board & board)
+{
+    // Convert a sequence of entries to a Board. Returns false, with a Python exception set, on failure.
+    // Besides the entries themselves, the chips are checked to rest on each other, and to have been played
+    // alternately, starting with player A.
+
+    PyObject * entries = PySequence_Fast(entries_object, "board entries must be a sequence");
+    if (entries == nullptr)
+    {
+        return false;
+    }
+
+    if (PySequence_Fast_GET_SIZE(entries) != H_SIZE * V_SIZE)
+    {
+        Py_DECREF(entries);
+        PyErr_SetString(PyExc_ValueError, "bad number of board entries");
+        return false;
+    }
+
+    Player players[H_SIZE * V_SIZE];
+
+    for (int i = 0; i < H_SIZE * V_SIZE; ++i)
+    {
+        const long value = PyLong_AsLong(PySequence_Fast_GET_ITEM(entries, i));
+
+        if (value < 0 || value > 2)
+        {
+            Py_DECREF(entries);
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "bad board entry");
+            }
+            return false;
+        }
+
+        players[i] = static_cast<Player>(value);
+    }
+
+    Py_DECREF(entries);
+
+    int count_a = 0;
+    int count_b = 0;
+
+    for (int i = 0; i < H_SIZE * V_SIZE; ++i)
+    {
+        if (players[i] == Player::NONE)
+        {
+            continue;
+        }
+
+        // Entry i is in row (i / H_SIZE); the entry below it is (i - H_SIZE).
+
+        if (i >= H_SIZE && players[i - H_SIZE] == Player::NONE)
+        {
+            PyErr_SetString(PyExc_ValueError, "board entries are not a legal position");
+            return false;
+        }
+
+        if (players[i] == Player::A)
+        {
+            ++count_a;
+        }
+        else
+        {
+            ++count_b;
+        }
+    }
+
+    if (count_a != count_b && count_a != count_b + 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "board entries are not a legal position");
+        return false;
+    }
+
+    board = Board::from_entries(players);
+
+    return true;
+}
+
+static PyObject * Table_new(PyTypeObject * type, PyObject *, PyObject *)
+{
+    TableObject * self = reinterpret_cast<TableObject *>(type->tp_alloc(type, 0));
+
+    if (self != nullptr)
+    {
+        self->table = nullptr;
+    }
+
+    return reinterpret_cast<PyObject *>(self);
+}
+
+static int Table_init(TableObject * self, PyObject * args, PyObject *)
+{
+    const char * filename;
+
+    if (!PyArg_ParseTuple(args, "s", &filename))
+    {
+        return -1;
+    }
+
+    try
+    {
+        delete self->table;
+        self->table = new LookupTable(filename);
+    }
+    catch (const exception & e)
+    {
+        self->table = nullptr;
+        PyErr_SetString(PyExc_OSError, e.what());
+        return -1;
+    }
+
+    return 0;
+}
+
+static void Table_dealloc(TableObject * self)
+{
+    delete self->table;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+static PyObject * Table_lookup(TableObject * self, PyObject * entries)
+{
+    // Look up the score octet of a board; raises KeyError if it is not in the table.
+
+    Board board;
+
+    if (!check_table(self) || !parse_board(entries, board))
+    {
+        return nullptr;
+    }
+
+    Score score;
+
+    try
+    {
+        if (!self->table->lookup(board, score))
+        {
+            PyErr_SetString(PyExc_KeyError, "board not found in lookup table");
+            return nullptr;
+        }
+    }
+    catch (const exception & e)
+    {
+        set_error(e);
+        return nullptr;
+    }
+
+    return PyLong_FromLong(score.to_code());
+}
+
+static PyObject * Table_lookup_many(TableObject * self, PyObject * boards_object)
+{
+    // Look up the score octets of a sequence of boards, in a single batch. Boards that are not in the
+    // table get None.
+
+    if (!check_table(self))
+    {
+        return nullptr;
+    }
+
+    PyObject * boards = PySequence_Fast(boards_object, "boards must be a sequence");
+    if (boards == nullptr)
+    {
+        return nullptr;
+    }
+
+    const Py_ssize_t num_boards = PySequence_Fast_GET_SIZE(boards);
+
+    vector<BoardKey> keys(num_boards);
+
+    for (Py_ssize_t i = 0; i < num_boards; ++i)
+    {
+        Board board;
+
+        if (!parse_board(PySequence_Fast_GET_ITEM(boards, i), board))
+        {
+            Py_DECREF(boards);
+            return nullptr;
+        }
+
+        try
+        {
+            keys[i] = board.normalize().to_key();
+        }
+        catch (const exception & e)
+        {
+            Py_DECREF(boards);
+            set_error(e);
+            return nullptr;
+        }
+    }
+
+    Py_DECREF(boards);
+
+    vector<Score> scores;
+    vector<bool>  found;
+
+    // The batch is looked up without holding the GIL, so an exception is only converted once the thread state is restored.
+
+    exception_ptr failure;
+
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        self->table->lookup_batch(keys, scores, found);
+    }
+    catch (...)
+    {
+        failure = current_exception();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (failure)
+    {
+        try
+        {
+            rethrow_exception(failure);
+        }
+        catch (const exception & e)
+        {
+            set_error(e);
+        }
+        catch (...)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "unknown error in lookup_batch");
+        }
+        return nullptr;
+    }
+
+    PyObject * result = PyList_New(num_boards);
+    if (result == nullptr)
+    {
+        return nullptr;
+    }
+
+    for (Py_ssize_t i = 0; i < num_boards; ++i)
+    {
+        PyObject * item;
+
+        if (found[i])
+        {
+            item = PyLong_FromLong(scores[i].to_code());
+        }
+        else
+        {
+            Py_INCREF(Py_None);
+            item = Py_None;
+        }
+
+        PyList_SET_ITEM(result, i, item);
+    }
+
+    return result;
+}
+
+static PyObject * Table_optimal_moves(TableObject * self, PyObject * entries)
+{
+    // Determine the optimal moves of a board, as a list of columns (numbered from 0), using the same tie-breaking
+    // rules as the Python clients. The list is empty if the game has ended.
+
+    Board board;
+
+    if (!check_table(self) || !parse_board(entries, board))
+    {
+        return nullptr;
+    }
+
+    vector<int> optimal_columns;
+
+    try
+    {
+        vector<MoveScore> moves;
+
+        if (board.trivial_outcome() == Outcome::INDETERMINATE)
+        {
+            for (int x = 0; x < H_SIZE; ++x)
+            {
+                if (board.can_play(x))
+                {
+                    Score score;
+
+                    if (!self->table->lookup(board.play(x), score))
+                    {
+                        PyErr_SetString(PyExc_KeyError, "board not found in lookup table");
+                        return nullptr;
+                    }
+
+                    moves.push_back(MoveScore{x, score});
+                }
+            }
+        }
+
+        if (!moves.empty())
+        {
+            Score board_score;
+            optimal_columns = select_optimal_moves(board.mover(), moves, board_score);
+        }
+    }
+    catch (const exception & e)
+    {
+        set_error(e);
+        return nullptr;
+    }
+
+    PyObject * result = PyList_New(optimal_columns.size());
+    if (result == nullptr)
+    {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < optimal_columns.size(); ++i)
+    {
+        PyList_SET_ITEM(result, i, PyLong_FromLong(optimal_columns[i]));
+    }
+
+    return result;
+}
+
+static PyMethodDef Table_methods[] = {
+    {"lookup"       , reinterpret_cast<PyCFunction>(Table_lookup)       , METH_O, "Look up the score octet of a board."},
+    {"lookup_many"  , reinterpret_cast<PyCFunction>(Table_lookup_many)  , METH_O, "Look up the score octets of a sequence of boards."},
+    {"optimal_moves", reinterpret_cast<PyCFunction>(Table_optimal_moves), METH_O, "Determine the optimal moves of a board."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyTypeObject TableType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+static PyModuleDef connect4_native_module = {
+    PyModuleDef_HEAD_INIT,
+    "connect4_native",
+    "Native board encoding and table lookups for the connect-4 clients.",
+    -1,
+    nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC PyInit_connect4_native()
+{
+    TableType.tp_name      = "connect4_native.Table";
+    TableType.tp_doc       = "A memory-mapped binary nodes file or partitioned database.";
+    TableType.tp_basicsize = sizeof(TableObject);
+    TableType.tp_flags     = Py_TPFLAGS_DEFAULT;
+    TableType.tp_new       = Table_new;
+    TableType.tp_init      = reinterpret_cast<initproc>(Table_init);
+    TableType.tp_dealloc   = reinterpret_cast<destructor>(Table_dealloc);
+    TableType.tp_methods   = Table_methods;
+
+    if (PyType_Ready(&TableType) < 0)
+    {
+        return nullptr;
+    }
+
+    PyObject * module = PyModule_Create(&connect4_native_module);
+    if (module == nullptr)
+    {
+        return nullptr;
+    }
+
+    // The board geometry is fixed at compile time; clients must check that it matches their table.
+
+    PyModule_AddIntConstant(module, "H_SIZE"   , H_SIZE);
+    PyModule_AddIntConstant(module, "V_SIZE"   , V_SIZE);
+    PyModule_AddIntConstant(module, "CONNECT_Q", CONNECT_Q);
+
+    Py_INCREF(&TableType);
+    if (PyModule_AddObject(module, "Table", reinterpret_cast<PyObject *>(&TableType)) < 0)
+    {
+        Py_DECREF(&TableType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+
+    return module;
+}
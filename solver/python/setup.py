@@ -0,0 +1,35 @@
+"""Build the 'connect4_native' Python extension module from the solver sources.
+
+The board geometry is fixed at compile time by "board_size.h", so the module must be built for the same
+geometry as the table that the clients use. To build the module in this directory:
+
+    python3 setup.py build_ext --inplace
+
+The clients use the module if it can be imported, e.g. by adding this directory to PYTHONPATH.
+"""
+
+import os
+from setuptools import setup, Extension
+
+SOLVER_DIR = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+SOLVER_SOURCES = [
+    "board.cc", "column_encoder.cc", "base62.cc", "score.cc", "outcome.cc", "lookup_table.cc",
+    "optimal_moves.cc", "hash.cc", "partitioned_db.cc", "block_cache.cc", "bloom_filter.cc", "wdl_file.cc"
+]
+
+connect4_native = Extension(
+    "connect4_native",
+    sources=["connect4_native.cc"] + [os.path.join(SOLVER_DIR, source) for source in SOLVER_SOURCES],
+    include_dirs=[SOLVER_DIR],
+    extra_compile_args=["-std=c++14", "-O3", "-pthread"],
+    extra_link_args=["-pthread"],
+    language="c++"
+)
+
+setup(
+    name="connect4_native",
+    version="1.0",
+    description="Native board encoding and table lookups for the connect-4 clients.",
+    ext_modules=[connect4_native]
+)
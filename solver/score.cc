@@ -12,53 +12,77 @@
 
 using namespace std;
 
-constexpr unsigned BASE62_PLY_DIGITS = 1; // Number of base-62 digits to use for the "ply" field.
-
 istream & operator >> (istream & in, Score & score)
 {
     if (in)
     {
         string ply_string;
 
-        in >> score.outcome >> setw(BASE62_PLY_DIGITS) >> ply_string;
-        score.ply = base62_string_to_uint64(ply_string);
+        in >> score.outcome >> setw(NUM_BASE62_PLY_DIGITS) >> ply_string;
+        score.ply = base62_string_to_key(ply_string);
     }
     return in;
 }
 
 ostream & operator << (ostream & out, const Score & score)
 {
-    out << score.outcome << uint64_to_base62_string(score.ply, BASE62_PLY_DIGITS);
+    out << score.outcome << key_to_base62_string(score.ply, NUM_BASE62_PLY_DIGITS);
     return out;
 }
 
-uint8_t Score::to_uint8() const
+constexpr ScoreCode PLY_MASK = (1u << SCORE_OUTCOME_SHIFT) - 1;
+
+ScoreCode Score::to_code() const
 {
-    uint8_t outcome_bits = 0;
+    ScoreCode outcome_bits = 0;
 
     switch (outcome)
     {
-        case Outcome::A_WINS       : outcome_bits = 0x40; break;
-        case Outcome::B_WINS       : outcome_bits = 0x80; break;
-        case Outcome::DRAW         : outcome_bits = 0x00; break;
-        case Outcome::INDETERMINATE: outcome_bits = 0xc0; break;
+        case Outcome::A_WINS       : outcome_bits = 1; break;
+        case Outcome::B_WINS       : outcome_bits = 2; break;
+        case Outcome::DRAW         : outcome_bits = 0; break;
+        case Outcome::INDETERMINATE: outcome_bits = 3; break;
     }
 
-    return outcome_bits | ply;
+    return (outcome_bits << SCORE_OUTCOME_SHIFT) | ply;
 }
 
 // static method
-Score Score::from_uint8(uint8_t score_octet)
+Score Score::from_code(ScoreCode code)
 {
     Outcome outcome = Outcome::INDETERMINATE;
 
-    switch (score_octet & 0xc0)
+    switch (code >> SCORE_OUTCOME_SHIFT)
+    {
+        case 1: outcome = Outcome::A_WINS; break;
+        case 2: outcome = Outcome::B_WINS; break;
+        case 0: outcome = Outcome::DRAW; break;
+        case 3: outcome = Outcome::INDETERMINATE; break;
+    }
+
+    return Score(outcome, code & PLY_MASK);
+}
+
+void Score::store(uint8_t * octets) const
+{
+    ScoreCode code = to_code();
+
+    for (unsigned i = 0; i < NUM_SCORE_OCTETS; ++i)
+    {
+        octets[NUM_SCORE_OCTETS - 1 - i] = code & 255;
+        code >>= 8;
+    }
+}
+
+// static method
+Score Score::load(const uint8_t * octets)
+{
+    ScoreCode code = 0;
+
+    for (unsigned i = 0; i < NUM_SCORE_OCTETS; ++i)
     {
-        case 0x40: outcome = Outcome::A_WINS; break;
-        case 0x80: outcome = Outcome::B_WINS; break;
-        case 0x00: outcome = Outcome::DRAW; break;
-        case 0xc0: outcome = Outcome::INDETERMINATE; break;
+        code = (code << 8) | octets[i];
     }
 
-    return Score(outcome, score_octet & 0x3f);
+    return from_code(code);
 }
@@ -11,9 +11,16 @@
 #include <cstdint>
 
 #include "outcome.h"
+#include "derived_constants.h"
 
 // A Score is a game-theoretical Outcome (A_WINS / B_WINS / DRAW / INDETERMINATE),
 // plus a number of optimal moves to be made before the game ends in that outcome.
+//
+// In binary files, a Score is stored as a ScoreCode of NUM_SCORE_OCTETS octets (see derived_constants.h):
+// the outcome in the two most significant bits, and the ply in the remaining 6 or 14 bits.
+// The outcome bits are 0 for DRAW, 1 for A_WINS, 2 for B_WINS, and 3 for INDETERMINATE.
+
+constexpr unsigned SCORE_OUTCOME_SHIFT = 8 * NUM_SCORE_OCTETS - 2;
 
 struct Score {
 
@@ -25,11 +32,17 @@ struct Score {
         // Empty body.
     }
 
-    // Encode a Score as an 8-bit unsigned integer.
-    uint8_t to_uint8() const;
+    // Encode a Score as a ScoreCode.
+    ScoreCode to_code() const;
+
+    // Decode a Score from a ScoreCode.
+    static Score from_code(ScoreCode code);
+
+    // Store the ScoreCode of a Score as NUM_SCORE_OCTETS octets, in big-endian order.
+    void store(uint8_t * octets) const;
 
-    // Decode a Score from an 8-bit unsigned integer.
-    static Score from_uint8(uint8_t score_octet);
+    // Load a Score from NUM_SCORE_OCTETS octets, in big-endian order.
+    static Score load(const uint8_t * octets);
 
     // The game-theoretical outcome for a position, assuming optimal play by both sides.
     Outcome outcome;
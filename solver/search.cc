@@ -0,0 +1,328 @@
+
+///////////////
+// search.cc //
+///////////////
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "board_size.h"
+#include "hash.h"
+#include "search.h"
+
+using namespace std;
+
+// The search value of a win at the very start of the game; see the description of the Searcher class.
+constexpr int WIN_VALUE_BASE = H_SIZE * V_SIZE + 1;
+
+// Values stored in the transposition table are limited to this range.
+constexpr int VALUE_INFINITY = WIN_VALUE_BASE + 1;
+
+// A bit in the transposition table data word that distinguishes written entries from empty ones.
+constexpr uint64_t ENTRY_VALID_BIT = 1 << 16;
+
+TranspositionTable::TranspositionTable(unsigned log2_num_entries) :
+    log2_num_entries(log2_num_entries),
+    entries(uint64_t(1) << log2_num_entries)
+{
+    for (Entry & entry: entries)
+    {
+        entry.check.store(0, memory_order_relaxed);
+        entry.data.store(0, memory_order_relaxed);
+    }
+}
+
+const TranspositionTable::Entry & TranspositionTable::entry_for(BoardKey key) const
+{
+    // Multiplicative hashing; take the most significant bits of the product.
+    const uint64_t index = (fold_key(key) * 0x9e3779b97f4a7c15ULL) >> (64 - log2_num_entries);
+    return entries[index];
+}
+
+bool TranspositionTable::probe(BoardKey key, int & lower, int & upper) const
+{
+    const Entry & entry = entry_for(key);
+
+    const uint64_t data  = entry.data.load(memory_order_relaxed);
+    const uint64_t check = entry.check.load(memory_order_relaxed);
+
+    if ((data & ENTRY_VALID_BIT) == 0 || (check ^ data) != fold_key(key))
+    {
+        return false;
+    }
+
+    lower = static_cast<int>(data & 255) - 128;
+    upper = static_cast<int>((data >> 8) & 255) - 128;
+    return true;
+}
+
+void TranspositionTable::store(BoardKey key, int lower, int upper)
+{
+    Entry & entry = const_cast<Entry &>(entry_for(key));
+
+    const uint64_t data = ENTRY_VALID_BIT | (static_cast<uint64_t>(upper + 128) << 8) | static_cast<uint64_t>(lower + 128);
+
+    entry.data.store(data, memory_order_relaxed);
+    entry.check.store(fold_key(key) ^ data, memory_order_relaxed);
+}
+
+Searcher::Searcher(TranspositionTable & transposition_table, const LookupTable * table, unsigned table_max_generation) :
+    transposition_table(transposition_table),
+    table(table),
+    table_max_generation(table_max_generation),
+    nodes(0)
+{
+    // Order the columns from the center outward, e.g. 3, 2, 4, 1, 5, 0, 6 for H_SIZE == 7.
+
+    for (int x = 0; x < H_SIZE; ++x)
+    {
+        column_order.push_back(x);
+    }
+
+    stable_sort(column_order.begin(), column_order.end(), [](int x1, int x2) { return abs(2 * x1 - (H_SIZE - 1)) < abs(2 * x2 - (H_SIZE - 1)); });
+}
+
+static int score_to_value(const Score & score, int count, Player mover)
+{
+    const int end = count + score.ply;
+
+    switch (score.outcome)
+    {
+        case Outcome::A_WINS : return (mover == Player::A) ? (WIN_VALUE_BASE - end) : -(WIN_VALUE_BASE - end);
+        case Outcome::B_WINS : return (mover == Player::B) ? (WIN_VALUE_BASE - end) : -(WIN_VALUE_BASE - end);
+        case Outcome::DRAW   : return 0;
+        default              : throw runtime_error("score_to_value: unexpected indeterminate score.");
+    }
+}
+
+static Score value_to_score(int value, int count, Player mover)
+{
+    const Player opponent = (mover == Player::A) ? Player::B : Player::A;
+
+    if (value > 0)
+    {
+        return Score((mover == Player::A) ? Outcome::A_WINS : Outcome::B_WINS, (WIN_VALUE_BASE - value) - count);
+    }
+
+    if (value < 0)
+    {
+        return Score((opponent == Player::A) ? Outcome::A_WINS : Outcome::B_WINS, (WIN_VALUE_BASE + value) - count);
+    }
+
+    return Score(Outcome::DRAW, H_SIZE * V_SIZE - count);
+}
+
+int Searcher::negamax(const Board & board, int count, int alpha, int beta)
+{
+    // Determine the value of a board that has no connect-Q, from the perspective of the mover.
+    // The result is exact if it is in the range (alpha, beta). Otherwise, it is an upper bound
+    // (if <= alpha) or a lower bound (if >= beta) of the exact value.
+
+    ++nodes;
+
+    if (count == H_SIZE * V_SIZE)
+    {
+        return 0; // The board is full; the game is a draw.
+    }
+
+    // If the mover can complete a connect-Q, that is the best possible move.
+
+    for (int x = 0; x < H_SIZE; ++x)
+    {
+        if (board.can_play(x) && board.is_winning_move(x))
+        {
+            return WIN_VALUE_BASE - (count + 1);
+        }
+    }
+
+    // Otherwise, the mover can win at the earliest after its next move, and lose
+    // at the earliest after the opponent's next move. Tighten the window accordingly.
+
+    const int max_value = (count + 3 <= H_SIZE * V_SIZE) ? WIN_VALUE_BASE - (count + 3) : 0;
+    const int min_value = (count + 2 <= H_SIZE * V_SIZE) ? -(WIN_VALUE_BASE - (count + 2)) : 0;
+
+    if (beta > max_value)
+    {
+        beta = max_value;
+        if (alpha >= beta)
+        {
+            return beta;
+        }
+    }
+
+    if (alpha < min_value)
+    {
+        alpha = min_value;
+        if (alpha >= beta)
+        {
+            return alpha;
+        }
+    }
+
+    const Board normalized_board = board.normalize();
+    const BoardKey key = normalized_board.to_key();
+
+    if (table != nullptr && count <= static_cast<int>(table_max_generation))
+    {
+        Score score;
+        if (table->lookup(key, score))
+        {
+            return score_to_value(score, count, board.mover());
+        }
+    }
+
+    int tt_lower;
+    int tt_upper;
+
+    if (transposition_table.probe(key, tt_lower, tt_upper))
+    {
+        if (tt_lower >= beta)
+        {
+            return tt_lower;
+        }
+        if (tt_upper <= alpha)
+        {
+            return tt_upper;
+        }
+        alpha = max(alpha, tt_lower);
+        beta  = min(beta, tt_upper);
+        if (alpha >= beta)
+        {
+            return alpha;
+        }
+    }
+    else
+    {
+        tt_lower = -VALUE_INFINITY;
+        tt_upper = +VALUE_INFINITY;
+    }
+
+    const int alpha_original = alpha;
+
+    int best_value = -VALUE_INFINITY;
+
+    for (const int x: column_order)
+    {
+        if (board.can_play(x))
+        {
+            const int value = -negamax(board.play(x), count + 1, -beta, -alpha);
+
+            if (value > best_value)
+            {
+                best_value = value;
+            }
+
+            if (value >= beta)
+            {
+                break;
+            }
+
+            if (value > alpha)
+            {
+                alpha = value;
+            }
+        }
+    }
+
+    // Refine the stored bounds with the result of this search.
+
+    if (best_value <= alpha_original)
+    {
+        tt_upper = min(tt_upper, best_value);
+    }
+    else if (best_value >= beta)
+    {
+        tt_lower = max(tt_lower, best_value);
+    }
+    else
+    {
+        tt_lower = tt_upper = best_value;
+    }
+
+    transposition_table.store(key, tt_lower, tt_upper);
+
+    return best_value;
+}
+
+Score Searcher::solve(const Board & board)
+{
+    const Outcome outcome = board.trivial_outcome();
+
+    if (outcome != Outcome::INDETERMINATE)
+    {
+        return Score(outcome, 0);
+    }
+
+    const int    count = board.count();
+    const Player mover = board.mover();
+
+    // The exact value is in the range [lower, upper].
+    // Initially, the mover may win immediately, or lose after the opponent's next move.
+
+    int lower = (count + 2 <= H_SIZE * V_SIZE) ? -(WIN_VALUE_BASE - (count + 2)) : 0;
+    int upper = WIN_VALUE_BASE - (count + 1);
+
+    // Iterative deepening: check whether the game ends within 'depth' plies.
+    // A game that ends after an odd number of plies is a win for the mover, otherwise it is a loss.
+
+    for (int depth = 1; lower < upper && depth <= static_cast<int>(SEARCH_ITERATIVE_DEEPENING_PLIES) && count + depth <= H_SIZE * V_SIZE; ++depth)
+    {
+        const int end = count + depth;
+
+        if (depth % 2 == 1)
+        {
+            // Is the value at least that of a win at 'end'?
+            const int threshold = WIN_VALUE_BASE - end;
+            if (threshold > lower && threshold <= upper)
+            {
+                const int value = negamax(board, count, threshold - 1, threshold);
+                if (value >= threshold)
+                {
+                    lower = max(lower, value);
+                }
+                else
+                {
+                    upper = min(upper, value);
+                }
+            }
+        }
+        else
+        {
+            // Is the value at most that of a loss at 'end'?
+            const int threshold = -(WIN_VALUE_BASE - end);
+            if (threshold >= lower && threshold < upper)
+            {
+                const int value = negamax(board, count, threshold, threshold + 1);
+                if (value <= threshold)
+                {
+                    upper = min(upper, value);
+                }
+                else
+                {
+                    lower = max(lower, value);
+                }
+            }
+        }
+    }
+
+    // Narrow down the remaining range by bisection.
+
+    while (lower < upper)
+    {
+        const int middle = lower + (upper - lower) / 2;
+
+        const int value = negamax(board, count, middle, middle + 1);
+
+        if (value <= middle)
+        {
+            upper = value;
+        }
+        else
+        {
+            lower = value;
+        }
+    }
+
+    return value_to_score(lower, count, mover);
+}
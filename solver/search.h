@@ -0,0 +1,114 @@
+
+//////////////
+// search.h //
+//////////////
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include "board.h"
+#include "score.h"
+#include "lookup_table.h"
+
+// The number of plies for which the Searcher first looks for a quick win or loss,
+// before narrowing down the score by bisection.
+constexpr unsigned SEARCH_ITERATIVE_DEEPENING_PLIES = 12;
+
+// The default size of the transposition table: 2 ** 24 entries of 16 bytes each (256 MiB).
+constexpr unsigned DEFAULT_TRANSPOSITION_TABLE_LOG2_ENTRIES = 24;
+
+class TranspositionTable
+{
+    // A transposition table that stores lower and upper bounds on the search value of boards,
+    // keyed by the normalized board key.
+    //
+    // The table can be shared by multiple threads without locking. Each entry consists of two words:
+    // the data word, and a check word that holds the key XOR-ed with the data word. If two threads
+    // write to the same entry concurrently, a reader may see a mix of both writes; the check word
+    // will then not match, and the entry is treated as empty. Keys wider than 64 bits are folded
+    // into 64 bits (see fold_key), so for these, a false match is possible, but extremely unlikely.
+    //
+    // Since search values are expressed relative to the end of the game (see Searcher), rather
+    // than relative to the board, entries are valid regardless of the path to the board.
+
+    public:
+
+        // Make a transposition table with (2 ** log2_num_entries) entries.
+        explicit TranspositionTable(unsigned log2_num_entries);
+
+        // Look up the bounds for a key. Returns false if no entry for the key is present.
+        bool probe(BoardKey key, int & lower, int & upper) const;
+
+        // Store the bounds for a key, replacing any previous entry at the same location.
+        void store(BoardKey key, int lower, int upper);
+
+    private: // Member types.
+
+        struct Entry {
+            std::atomic<uint64_t> check;
+            std::atomic<uint64_t> data;
+        };
+
+    private: // Member functions.
+
+        const Entry & entry_for(BoardKey key) const;
+
+    private: // Member variables.
+
+        unsigned           log2_num_entries;
+        std::vector<Entry> entries;
+};
+
+class Searcher
+{
+    // The Searcher class determines the Score of a board by negamax search with alpha-beta pruning.
+    //
+    // Internally, the search value of a board is expressed from the perspective of the mover, relative
+    // to the total number of chips on the board at the end of the game, E. A win for the mover has
+    // value (H_SIZE * V_SIZE + 1 - E), a loss has value -(H_SIZE * V_SIZE + 1 - E), and a draw has
+    // value 0. So quick wins and slow losses are preferred, as in the backward stage of the solver.
+    // Since E is the same for a board and its children, the value of a board is simply the
+    // maximum of the negated values of its children.
+    //
+    // The score is determined in two phases. First, quick wins and losses are found by iterative
+    // deepening: null-window searches that ask whether the game ends within 1, 2, 3, ... plies,
+    // up to SEARCH_ITERATIVE_DEEPENING_PLIES. Next, the remaining range is narrowed down by bisection,
+    // using null-window searches.
+    //
+    // Moves are ordered from the center column outward. If a (partial) lookup table is given, boards
+    // with up to 'table_max_generation' chips are looked up in the table rather than searched.
+
+    public:
+
+        Searcher(TranspositionTable & transposition_table, const LookupTable * table, unsigned table_max_generation);
+
+        // Determine the Score of a board.
+        Score solve(const Board & board);
+
+        // The number of nodes visited so far.
+        uint64_t node_count() const
+        {
+            return nodes;
+        }
+
+    private: // Member functions.
+
+        int negamax(const Board & board, int count, int alpha, int beta);
+
+    private: // Member variables.
+
+        TranspositionTable & transposition_table;
+        const LookupTable *  table;
+        unsigned             table_max_generation;
+
+        // The order in which columns are tried.
+        std::vector<int> column_order;
+
+        uint64_t nodes;
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,81 @@
+
+//////////////////////
+// training_data.cc //
+//////////////////////
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#include "little_endian.h"
+#include "hash.h"
+#include "training_data.h"
+
+using namespace std;
+
+void encode_training_data_header(TrainingSampling sampling, uint64_t seed, uint64_t num_records, uint8_t * header)
+{
+    fill(header, header + TRAINING_DATA_HEADER_SIZE, 0);
+
+    memcpy(header, TRAINING_DATA_MAGIC, TRAINING_DATA_MAGIC_SIZE);
+
+    store_le(header +  8, TRAINING_DATA_VERSION , 4);
+    store_le(header + 12, H_SIZE                , 4);
+    store_le(header + 16, V_SIZE                , 4);
+    store_le(header + 20, CONNECT_Q             , 4);
+    store_le(header + 24, TRAINING_PLANE_SIZE   , 4);
+    store_le(header + 28, TRAINING_RECORD_SIZE  , 4);
+    store_le(header + 32, sampling              , 4);
+    store_le(header + 40, seed                  , 8);
+    store_le(header + 48, num_records           , 8);
+
+    store_le(header + 56, fnv1a_64(header, 56), 8);
+}
+
+unsigned TrainingRecordEncoder::encode(BoardKey key, const Score & score, uint8_t * record) const
+{
+    unsigned heights[H_SIZE];
+    uint32_t a_bits[H_SIZE];
+    unsigned count = 0;
+
+    for (int x = H_SIZE - 1; x >= 0; --x)
+    {
+        const unsigned encoded = key % NUMBER_OF_POSSIBLE_COLUMNS;
+        key /= NUMBER_OF_POSSIBLE_COLUMNS;
+
+        heights[x] = column_chips.height(encoded);
+        a_bits[x]  = column_chips.a_bits(encoded);
+        count += heights[x];
+    }
+
+    // Player A moves first, so player A is the mover if the number of chips is even.
+
+    const bool mover_is_a = (count % 2 == 0);
+
+    fill(record, record + TRAINING_RECORD_SIZE, 0);
+
+    uint8_t * a_plane = mover_is_a ? record : record + TRAINING_PLANE_SIZE;
+    uint8_t * b_plane = mover_is_a ? record + TRAINING_PLANE_SIZE : record;
+
+    for (unsigned x = 0; x < H_SIZE; ++x)
+    {
+        for (unsigned y = 0; y < heights[x]; ++y)
+        {
+            const unsigned bit = x * V_SIZE + y;
+            uint8_t * plane = ((a_bits[x] >> y) & 1) ? a_plane : b_plane;
+            plane[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    switch (score.outcome)
+    {
+        case Outcome::A_WINS        : record[TRAINING_OUTCOME_OFFSET] = mover_is_a ? TRAINING_OUTCOME_WIN : TRAINING_OUTCOME_LOSS; break;
+        case Outcome::B_WINS        : record[TRAINING_OUTCOME_OFFSET] = mover_is_a ? TRAINING_OUTCOME_LOSS : TRAINING_OUTCOME_WIN; break;
+        case Outcome::DRAW          : record[TRAINING_OUTCOME_OFFSET] = TRAINING_OUTCOME_DRAW; break;
+        case Outcome::INDETERMINATE : throw runtime_error("TrainingRecordEncoder: unexpected indeterminate score.");
+    }
+
+    record[TRAINING_OUTCOME_OFFSET + 1] = score.ply;
+
+    return count;
+}
@@ -0,0 +1,94 @@
+
+/////////////////////
+// training_data.h //
+/////////////////////
+
+#ifndef TRAINING_DATA_H
+#define TRAINING_DATA_H
+
+#include <cstdint>
+#include <vector>
+
+#include "board_size.h"
+#include "column_encoder.h"
+#include "derived_constants.h"
+#include "score.h"
+
+// A training data file holds boards and their scores in a fixed-size binary layout that can be loaded directly
+// as a tensor, as made by the --export-training mode from a sample of the records of a table.
+//
+// Each record consists of two bit planes of P = TRAINING_PLANE_SIZE octets each, followed by two octets:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      P   the chips of the mover
+//          P      P   the chips of the opponent
+//         2P      1   the outcome, for the mover (TRAINING_OUTCOME_DRAW, TRAINING_OUTCOME_WIN, or TRAINING_OUTCOME_LOSS)
+//     2P + 1      1   the ply (the number of moves until the game ends)
+//
+// In a plane, bit (x * V_SIZE + y) is set if there is a chip in column x (numbered from 0), at height y
+// (numbered from 0 at the bottom). Bit i is bit (i % 8) of octet (i / 8).
+//
+// The file starts with a header. All numbers in the header are stored in little-endian order:
+//
+//     offset   size   contents
+//     ------   ----   --------
+//          0      8   TRAINING_DATA_MAGIC
+//          8      4   format version (TRAINING_DATA_VERSION)
+//         12      4   H_SIZE
+//         16      4   V_SIZE
+//         20      4   CONNECT_Q
+//         24      4   plane size in bytes (TRAINING_PLANE_SIZE)
+//         28      4   record size in bytes (TRAINING_RECORD_SIZE)
+//         32      4   sampling (TRAINING_SAMPLING_UNIFORM or TRAINING_SAMPLING_STRATIFIED)
+//         36      4   reserved (zero)
+//         40      8   sampling seed
+//         48      8   number of records
+//         56      8   FNV-1a hash of the preceding header bytes
+//
+// The records follow the header.
+
+constexpr const char * TRAINING_DATA_MAGIC = "#C4TRN\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned TRAINING_DATA_MAGIC_SIZE  = 8;
+constexpr unsigned TRAINING_DATA_VERSION     = 1;
+constexpr unsigned TRAINING_DATA_HEADER_SIZE = 64;
+constexpr unsigned TRAINING_PLANE_SIZE       = (H_SIZE * V_SIZE + 7) / 8;
+constexpr unsigned TRAINING_OUTCOME_OFFSET   = 2 * TRAINING_PLANE_SIZE;
+constexpr unsigned TRAINING_RECORD_SIZE      = 2 * TRAINING_PLANE_SIZE + 2;
+
+static_assert(MAX_PLY <= 255, "The ply of a training record must fit in an octet.");
+
+// The outcome of a training record, from the perspective of the mover.
+enum TrainingOutcome : uint8_t {
+    TRAINING_OUTCOME_DRAW = 0,
+    TRAINING_OUTCOME_WIN  = 1,
+    TRAINING_OUTCOME_LOSS = 2
+};
+
+// How the records of a table are sampled.
+enum TrainingSampling : unsigned {
+    TRAINING_SAMPLING_UNIFORM    = 0, // Every record is sampled with the same probability.
+    TRAINING_SAMPLING_STRATIFIED = 1  // Every (number of moves, outcome) stratum yields the same expected number of records.
+};
+
+// Encode a header into a buffer of TRAINING_DATA_HEADER_SIZE bytes.
+void encode_training_data_header(TrainingSampling sampling, uint64_t seed, uint64_t num_records, uint8_t * header);
+
+class TrainingRecordEncoder
+{
+    // Encodes board keys and scores into training records, reading the chips of each column directly
+    // from the key (see ColumnChips).
+
+    public:
+
+        // Encode a board key and its score into a record of TRAINING_RECORD_SIZE bytes.
+        // Returns the number of chips on the board.
+        unsigned encode(BoardKey key, const Score & score, uint8_t * record) const;
+
+    private: // Member variables.
+
+        ColumnChips column_chips;
+};
+
+#endif // TRAINING_DATA_H
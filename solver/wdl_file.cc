@@ -0,0 +1,51 @@
+
+/////////////////
+// wdl_file.cc //
+/////////////////
+
+#include <stdexcept>
+#include <cstring>
+
+#include "little_endian.h"
+#include "wdl_file.h"
+
+using namespace std;
+
+void encode_wdl_file_header(uint64_t num_records, uint8_t * header)
+{
+    memcpy(header, WDL_FILE_MAGIC, WDL_FILE_MAGIC_SIZE);
+
+    store_le(header + 8, num_records, 8);
+}
+
+bool is_wdl_file_header(const uint8_t * header)
+{
+    return memcmp(header, WDL_FILE_MAGIC, WDL_FILE_MAGIC_SIZE) == 0;
+}
+
+uint64_t decode_wdl_file_header(const uint8_t * header)
+{
+    if (!is_wdl_file_header(header))
+    {
+        throw runtime_error("decode_wdl_file_header: bad magic.");
+    }
+
+    return load_le(header + 8, 8);
+}
+
+uint64_t wdl_file_size(uint64_t num_records)
+{
+    return WDL_FILE_HEADER_SIZE + (num_records + 3) / 4;
+}
+
+string wdl_keys_filename(const string & wdl_filename)
+{
+    const string extension = ".wdl";
+
+    if (wdl_filename.size() < extension.size() || wdl_filename.compare(wdl_filename.size() - extension.size(), extension.size(), extension) != 0)
+    {
+        throw runtime_error("wdl_keys_filename: the name of an outcome file must end in \".wdl\".");
+    }
+
+    return wdl_filename.substr(0, wdl_filename.size() - extension.size()) + ".keys";
+}
@@ -0,0 +1,57 @@
+
+////////////////
+// wdl_file.h //
+////////////////
+
+#ifndef WDL_FILE_H
+#define WDL_FILE_H
+
+#include <cstdint>
+#include <string>
+
+#include "score.h"
+
+// A win/draw/loss table, as made by the --make-wdl-file mode, consists of two files. The keys file holds the keys of
+// a binary nodes file, in the same order and format (big-endian, NUM_BASE256_BOARD_DIGITS bytes each), without the
+// scores. The outcome file holds the outcomes of the same records, as 2-bit values, four per octet.
+//
+// The outcome file starts with a header consisting of WDL_FILE_MAGIC, followed by the number of records as a 64-bit
+// little-endian number. The outcome of record i is stored in octet (i / 4) after the header, at bit position
+// 2 * (i % 4). The outcome is encoded as the outcome bits of the score (see SCORE_OUTCOME_SHIFT): 0 (draw),
+// 1 (A wins), or 2 (B wins).
+//
+// The keys file is named after the outcome file, with the extension ".keys" rather than ".wdl".
+
+constexpr const char * WDL_FILE_MAGIC = "#C4WDL\n"; // Including the terminating NUL character, this is 8 bytes.
+
+constexpr unsigned WDL_FILE_MAGIC_SIZE  = 8;
+constexpr unsigned WDL_FILE_HEADER_SIZE = 16;
+
+// Encode the header of an outcome file.
+void encode_wdl_file_header(uint64_t num_records, uint8_t * header);
+
+// Check if a header starts with WDL_FILE_MAGIC.
+bool is_wdl_file_header(const uint8_t * header);
+
+// Decode the number of records from the header of an outcome file.
+uint64_t decode_wdl_file_header(const uint8_t * header);
+
+// The size of an outcome file with the given number of records.
+uint64_t wdl_file_size(uint64_t num_records);
+
+// The name of the keys file that belongs to an outcome file. Throws an exception if the name does not end in ".wdl".
+std::string wdl_keys_filename(const std::string & wdl_filename);
+
+// The 2-bit outcome code of a score.
+inline unsigned wdl_outcome_code(const Score & score)
+{
+    return score.to_code() >> SCORE_OUTCOME_SHIFT;
+}
+
+// The score of a 2-bit outcome code, with a ply of zero.
+inline Score wdl_score(unsigned outcome_code)
+{
+    return Score::from_code(static_cast<ScoreCode>(outcome_code) << SCORE_OUTCOME_SHIFT);
+}
+
+#endif // WDL_FILE_H